@@ -0,0 +1,191 @@
+/*
+ * Copyright (C) 2018 Fabio D'Urso <durso@dmi.unict.it>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+#include "GzUavVehiclePlugin/FleetActuator.hh"
+
+#include "GzUavPhaseGenerator.hh"
+
+#include <algorithm>
+#include <cmath>
+
+using namespace gazebo;
+
+GzUav::FleetActuator::FleetActuator()
+{
+  this->updateConnection = GzUavPhaseGenerator::instance()->updateBegin2.Connect(
+    std::bind(&FleetActuator::OnUpdateBegin2, this, std::placeholders::_1));
+}
+
+GzUav::FleetActuator *GzUav::FleetActuator::instance()
+{
+  // init on first call
+  static FleetActuator inst;
+
+  return &inst;
+}
+
+size_t GzUav::FleetActuator::AddJoint(physics::JointPtr _joint,
+  const common::PID &_pid, double _forceScale)
+{
+  if (!this->world)
+    this->world = _joint->GetWorld();
+
+  size_t index;
+  if (!this->freeSlots.empty())
+  {
+    index = this->freeSlots.back();
+    this->freeSlots.pop_back();
+  }
+  else
+  {
+    index = this->joints.size();
+
+    const size_t n = index + 1;
+    this->joints.resize(n);
+    for (std::vector<char> *buf : { &this->tracksVelocity, &this->pending,
+        &this->primed, &this->active })
+    {
+      buf->resize(n);
+    }
+    for (std::vector<double> *buf : { &this->input, &this->error,
+        &this->pGain, &this->iGain, &this->dGain, &this->iMax, &this->iMin,
+        &this->cmdMax, &this->cmdMin, &this->pErrLast, &this->iErr,
+        &this->forceScale, &this->force })
+    {
+      buf->resize(n);
+    }
+  }
+
+  this->joints[index] = _joint;
+  this->tracksVelocity[index] = false;
+  this->pending[index] = false;
+  this->primed[index] = false;
+  this->active[index] = false;
+  this->input[index] = 0;
+  this->error[index] = 0;
+  this->pGain[index] = _pid.GetPGain();
+  this->iGain[index] = _pid.GetIGain();
+  this->dGain[index] = _pid.GetDGain();
+  this->iMax[index] = _pid.GetIMax();
+  this->iMin[index] = _pid.GetIMin();
+  this->cmdMax[index] = _pid.GetCmdMax();
+  this->cmdMin[index] = _pid.GetCmdMin();
+  this->pErrLast[index] = 0;
+  this->iErr[index] = 0;
+  this->forceScale[index] = _forceScale;
+  this->force[index] = 0;
+
+  return index;
+}
+
+void GzUav::FleetActuator::RemoveJoint(size_t _index)
+{
+  // The slot is skipped until it is reused
+  this->joints[_index].reset();
+  this->pending[_index] = false;
+  this->freeSlots.push_back(_index);
+}
+
+void GzUav::FleetActuator::SetVelocityTarget(size_t _index, double _target)
+{
+  this->tracksVelocity[_index] = true;
+  this->input[_index] = _target;
+  this->pending[_index] = true;
+}
+
+void GzUav::FleetActuator::SetError(size_t _index, double _error)
+{
+  this->tracksVelocity[_index] = false;
+  this->input[_index] = _error;
+  this->pending[_index] = true;
+}
+
+void GzUav::FleetActuator::OnUpdateBegin2(const common::UpdateInfo &/*_info*/)
+{
+  const size_t n = this->joints.size();
+  if (n == 0)
+    return;
+
+  common::Time curTime = this->world->SimTime();
+  const double dt = (curTime - this->prevTime).Double();
+  this->prevTime = curTime;
+
+  // Gather PID inputs. Like common::PID::Update, a zero time step or a
+  // non-finite error result in a zero force and leave the PID untouched
+  for (size_t i = 0; i < n; i++)
+  {
+    this->active[i] = false;
+    if (!this->pending[i] || !this->primed[i])
+      continue;
+
+    double e = this->input[i];
+    if (this->tracksVelocity[i])
+      e = this->joints[i]->GetVelocity(0) - e;
+
+    this->error[i] = e;
+    this->active[i] = dt != 0 && std::isfinite(e);
+  }
+
+  // Update all PIDs at once
+  const char * __restrict__ active = this->active.data();
+  const double * __restrict__ error = this->error.data();
+  const double * __restrict__ pGain = this->pGain.data();
+  const double * __restrict__ iGain = this->iGain.data();
+  const double * __restrict__ dGain = this->dGain.data();
+  const double * __restrict__ iMax = this->iMax.data();
+  const double * __restrict__ iMin = this->iMin.data();
+  const double * __restrict__ cmdMax = this->cmdMax.data();
+  const double * __restrict__ cmdMin = this->cmdMin.data();
+  const double * __restrict__ forceScale = this->forceScale.data();
+  double * __restrict__ pErrLast = this->pErrLast.data();
+  double * __restrict__ iErr = this->iErr.data();
+  double * __restrict__ force = this->force.data();
+
+  // Inactive slots are computed too (with meaningless results that are
+  // then discarded), so that the loop has no branches
+  const double invDt = dt != 0 ? 1.0 / dt : 0.0;
+  for (size_t i = 0; i < n; i++)
+  {
+    const double e = error[i];
+
+    double ie = iErr[i] + iGain[i] * dt * e;
+    if (iMax[i] >= iMin[i])
+      ie = std::min(std::max(ie, iMin[i]), iMax[i]);
+
+    const double dErr = (e - pErrLast[i]) * invDt;
+
+    double cmd = -pGain[i] * e - ie - dGain[i] * dErr;
+    if (cmdMax[i] >= cmdMin[i])
+      cmd = std::min(std::max(cmd, cmdMin[i]), cmdMax[i]);
+
+    iErr[i] = active[i] ? ie : iErr[i];
+    pErrLast[i] = active[i] ? e : pErrLast[i];
+    force[i] = active[i] ? forceScale[i] * cmd : 0.0;
+  }
+
+  // Apply forces
+  for (size_t i = 0; i < n; i++)
+  {
+    if (!this->pending[i])
+      continue;
+
+    if (this->primed[i])
+      this->joints[i]->SetForce(0, force[i]);
+
+    this->pending[i] = false;
+    this->primed[i] = true;
+  }
+}
@@ -0,0 +1,118 @@
+/*
+ * Copyright (C) 2018 Fabio D'Urso <durso@dmi.unict.it>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+#ifndef GZUAV_FLEETACTUATOR_HH_
+#define GZUAV_FLEETACTUATOR_HH_
+
+#include "GzUavVehiclePlugin/common.hh"
+
+#include <gazebo/physics/physics.hh>
+
+#include <vector>
+
+namespace gazebo
+{
+namespace GzUav
+{
+  /// \brief Drives the PID-controlled joints of all the vehicles in the
+  /// world at once.
+  ///
+  /// Rotors and gimbals only submit their inputs during the updateBegin1
+  /// event. During updateBegin2, joint velocities are gathered, the PIDs
+  /// of all joints are evaluated in plain loops over structure-of-arrays
+  /// buffers (which the compiler vectorizes) and forces are finally
+  /// applied in a single pass.
+  ///
+  /// The PID update is the same as common::PID::Update's, with the time
+  /// step shared by all joints.
+  class FleetActuator
+  {
+    /// \brief Return the singleton instance.
+    public: static FleetActuator *instance();
+
+    /// \brief Start driving a joint.
+    /// \param[in] _joint Joint to apply the force to.
+    /// \param[in] _pid Initial PID configuration and state.
+    /// \param[in] _forceScale Multiplier applied to the PID output.
+    /// \return Index identifying the joint in subsequent calls.
+    public: size_t AddJoint(physics::JointPtr _joint, const common::PID &_pid,
+      double _forceScale);
+
+    /// \brief Stop driving a joint.
+    public: void RemoveJoint(size_t _index);
+
+    /// \brief Set the target velocity for the current step. The PID input
+    /// will be the difference between the joint velocity and the target.
+    public: void SetVelocityTarget(size_t _index, double _target);
+
+    /// \brief Set the PID input for the current step.
+    public: void SetError(size_t _index, double _error);
+
+    /// \brief Constructor.
+    private: FleetActuator();
+
+    /// \brief Simulation step callback method (event 2).
+    private: void OnUpdateBegin2(const common::UpdateInfo &_info);
+
+    /// \brief World the joints belong to.
+    private: physics::WorldPtr world;
+
+    /// \brief Simulation time of the last step.
+    private: common::Time prevTime;
+
+    /// \brief Driven joints (null in unused slots).
+    private: std::vector<physics::JointPtr> joints;
+
+    /// \brief Indices of unused slots.
+    private: std::vector<size_t> freeSlots;
+
+    /// \brief Whether the PID input is relative to the joint velocity.
+    private: std::vector<char> tracksVelocity;
+
+    /// \brief Whether an input was submitted for the current step.
+    private: std::vector<char> pending;
+
+    /// \brief Whether an input was submitted in a previous step. The very
+    /// first input only starts the clock, as common::PID needs a time step.
+    private: std::vector<char> primed;
+
+    /// \brief Whether the PID is to be updated in the current step.
+    private: std::vector<char> active;
+
+    /// \brief Submitted inputs (velocity targets or errors).
+    private: std::vector<double> input;
+
+    /// \brief PID inputs.
+    private: std::vector<double> error;
+
+    /// \brief PID configuration.
+    private: std::vector<double> pGain, iGain, dGain, iMax, iMin, cmdMax, cmdMin;
+
+    /// \brief PID state.
+    private: std::vector<double> pErrLast, iErr;
+
+    /// \brief PID output multipliers.
+    private: std::vector<double> forceScale;
+
+    /// \brief Forces to be applied.
+    private: std::vector<double> force;
+
+    /// \brief Pointer to the update event connection.
+    private: event::ConnectionPtr updateConnection;
+  };
+}
+}
+#endif
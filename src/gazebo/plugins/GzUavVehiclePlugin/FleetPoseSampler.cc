@@ -0,0 +1,232 @@
+/*
+ * Copyright (C) 2016 Open Source Robotics Foundation
+ * Copyright (C) 2018 Fabio D'Urso <durso@dmi.unict.it>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+#include "GzUavVehiclePlugin/FleetPoseSampler.hh"
+#include "GzUavVehiclePlugin/PoseSampler.hh"
+
+#include "GzUavPhaseGenerator.hh"
+
+#include <algorithm>
+
+using namespace gazebo;
+
+GzUav::FleetPoseSampler::FleetPoseSampler()
+{
+  this->updateConnection = GzUavPhaseGenerator::instance()->updateBegin2.Connect(
+    std::bind(&FleetPoseSampler::OnUpdateBegin2, this, std::placeholders::_1));
+}
+
+GzUav::FleetPoseSampler *GzUav::FleetPoseSampler::instance()
+{
+  // init on first call
+  static FleetPoseSampler inst;
+
+  return &inst;
+}
+
+void GzUav::FleetPoseSampler::Register(PoseSampler *_sampler)
+{
+  if (!this->world)
+    this->world = _sampler->model->GetWorld();
+
+  this->samplers.push_back(_sampler);
+
+  const size_t n = this->samplers.size();
+  for (std::vector<double> *buf : { &this->px, &this->py, &this->pz,
+      &this->vx, &this->vy, &this->vz,
+      &this->qw, &this->qx, &this->qy, &this->qz,
+      &this->nedPx, &this->nedPy, &this->nedPz,
+      &this->nedVx, &this->nedVy, &this->nedVz,
+      &this->nedQw, &this->nedQx, &this->nedQy, &this->nedQz })
+  {
+    buf->resize(n);
+  }
+}
+
+void GzUav::FleetPoseSampler::Unregister(PoseSampler *_sampler)
+{
+  // Buffers are just left larger than needed
+  this->samplers.erase(
+    std::remove(this->samplers.begin(), this->samplers.end(), _sampler),
+    this->samplers.end());
+}
+
+void GzUav::FleetPoseSampler::UpdateTransforms()
+{
+  // Gazebo world xyz is assumed to be N, -E, -D, and the vehicle's link is
+  // x-forward, y-left, z-up, while ArduPilot wants NED positions and
+  // velocities and the rotation from the world NED frame to the vehicle's
+  // x-forward, y-right, z-down frame.
+
+  // If Gazebo world is rotated (i.e. X axis is not North), this transform
+  // fixes it so that the above comment still applies
+  ignition::math::Quaterniond worldYaw(0, 0,
+    this->world->SphericalCoords()->HeadingOffset().Radian());
+
+  // gazeboToNED brings us from gazebo model: x-forward, y-right, z-down
+  // to the aerospace convention: x-forward, y-left, z-up
+  ignition::math::Quaterniond gazeboToNED(IGN_PI, 0, 0);
+
+  // The pose composition worldYaw + (gazeboToNED + worldPose - gazeboToNED)
+  // that used to be evaluated for each vehicle boils down to, for a link
+  // with world pose (p, q) and world linear velocity v:
+  //   position in NED    = A * p
+  //   velocity in NED    = A * v
+  //   orientation in NED = A * q * gazeboToNED
+  // with A = worldYaw * inverse(gazeboToNED), i.e. to linear maps that are
+  // the same for all vehicles
+  ignition::math::Quaterniond a = worldYaw * gazeboToNED.Inverse();
+
+  // Columns of both matrices are the images of the basis vectors
+  const ignition::math::Vector3d axes[3] =
+  {
+    ignition::math::Vector3d::UnitX,
+    ignition::math::Vector3d::UnitY,
+    ignition::math::Vector3d::UnitZ,
+  };
+  for (int col = 0; col < 3; col++)
+  {
+    ignition::math::Vector3d v = a.RotateVector(axes[col]);
+    this->worldToNED[0 * 3 + col] = v.X();
+    this->worldToNED[1 * 3 + col] = v.Y();
+    this->worldToNED[2 * 3 + col] = v.Z();
+  }
+
+  for (int col = 0; col < 4; col++)
+  {
+    ignition::math::Quaterniond e(col == 0 ? 1.0 : 0.0, col == 1 ? 1.0 : 0.0,
+                                  col == 2 ? 1.0 : 0.0, col == 3 ? 1.0 : 0.0);
+    ignition::math::Quaterniond r = a * e * gazeboToNED;
+    this->orientationToNED[0 * 4 + col] = r.W();
+    this->orientationToNED[1 * 4 + col] = r.X();
+    this->orientationToNED[2 * 4 + col] = r.Y();
+    this->orientationToNED[3 * 4 + col] = r.Z();
+  }
+}
+
+void GzUav::FleetPoseSampler::OnUpdateBegin2(const common::UpdateInfo &/*_info*/)
+{
+  const size_t n = this->samplers.size();
+  if (n == 0)
+    return;
+
+  this->UpdateTransforms();
+
+  // Gather link states. IMU readings need no transform, so they are
+  // written to the samples directly
+  for (size_t i = 0; i < n; i++)
+  {
+    PoseSampler *s = this->samplers[i];
+
+    s->imuSensor->Update(true);
+
+    ignition::math::Vector3d linearAccel = s->imuSensor->LinearAcceleration();
+    s->sample.imuLinearAccelerationXYZ[0] = linearAccel.X();
+    s->sample.imuLinearAccelerationXYZ[1] = linearAccel.Y();
+    s->sample.imuLinearAccelerationXYZ[2] = linearAccel.Z();
+
+    ignition::math::Vector3d angularVel = s->imuSensor->AngularVelocity();
+    s->sample.imuAngularVelocityRPY[0] = angularVel.X();
+    s->sample.imuAngularVelocityRPY[1] = angularVel.Y();
+    s->sample.imuAngularVelocityRPY[2] = angularVel.Z();
+
+    const ignition::math::Pose3d &worldPose = s->link->WorldPose();
+    this->px[i] = worldPose.Pos().X();
+    this->py[i] = worldPose.Pos().Y();
+    this->pz[i] = worldPose.Pos().Z();
+    this->qw[i] = worldPose.Rot().W();
+    this->qx[i] = worldPose.Rot().X();
+    this->qy[i] = worldPose.Rot().Y();
+    this->qz[i] = worldPose.Rot().Z();
+
+    ignition::math::Vector3d vel = s->link->WorldLinearVel();
+    this->vx[i] = vel.X();
+    this->vy[i] = vel.Y();
+    this->vz[i] = vel.Z();
+  }
+
+  // Transform all vehicles at once
+  const double *m = this->worldToNED;
+  const double *k = this->orientationToNED;
+
+  const double * __restrict__ px = this->px.data();
+  const double * __restrict__ py = this->py.data();
+  const double * __restrict__ pz = this->pz.data();
+  const double * __restrict__ vx = this->vx.data();
+  const double * __restrict__ vy = this->vy.data();
+  const double * __restrict__ vz = this->vz.data();
+  const double * __restrict__ qw = this->qw.data();
+  const double * __restrict__ qx = this->qx.data();
+  const double * __restrict__ qy = this->qy.data();
+  const double * __restrict__ qz = this->qz.data();
+
+  double * __restrict__ nedPx = this->nedPx.data();
+  double * __restrict__ nedPy = this->nedPy.data();
+  double * __restrict__ nedPz = this->nedPz.data();
+  double * __restrict__ nedVx = this->nedVx.data();
+  double * __restrict__ nedVy = this->nedVy.data();
+  double * __restrict__ nedVz = this->nedVz.data();
+  double * __restrict__ nedQw = this->nedQw.data();
+  double * __restrict__ nedQx = this->nedQx.data();
+  double * __restrict__ nedQy = this->nedQy.data();
+  double * __restrict__ nedQz = this->nedQz.data();
+
+  for (size_t i = 0; i < n; i++)
+  {
+    nedPx[i] = m[0] * px[i] + m[1] * py[i] + m[2] * pz[i];
+    nedPy[i] = m[3] * px[i] + m[4] * py[i] + m[5] * pz[i];
+    nedPz[i] = m[6] * px[i] + m[7] * py[i] + m[8] * pz[i];
+  }
+
+  for (size_t i = 0; i < n; i++)
+  {
+    nedVx[i] = m[0] * vx[i] + m[1] * vy[i] + m[2] * vz[i];
+    nedVy[i] = m[3] * vx[i] + m[4] * vy[i] + m[5] * vz[i];
+    nedVz[i] = m[6] * vx[i] + m[7] * vy[i] + m[8] * vz[i];
+  }
+
+  for (size_t i = 0; i < n; i++)
+  {
+    nedQw[i] = k[0] * qw[i] + k[1] * qx[i] + k[2] * qy[i] + k[3] * qz[i];
+    nedQx[i] = k[4] * qw[i] + k[5] * qx[i] + k[6] * qy[i] + k[7] * qz[i];
+    nedQy[i] = k[8] * qw[i] + k[9] * qx[i] + k[10] * qy[i] + k[11] * qz[i];
+    nedQz[i] = k[12] * qw[i] + k[13] * qx[i] + k[14] * qy[i] + k[15] * qz[i];
+  }
+
+  // Scatter results
+  for (size_t i = 0; i < n; i++)
+  {
+    poseSample &pose = this->samplers[i]->sample;
+
+    pose.positionXYZ[0] = nedPx[i];
+    pose.positionXYZ[1] = nedPy[i];
+    pose.positionXYZ[2] = nedPz[i];
+
+    pose.imuOrientationQuat[0] = nedQw[i];
+    pose.imuOrientationQuat[1] = nedQx[i];
+    pose.imuOrientationQuat[2] = nedQy[i];
+    pose.imuOrientationQuat[3] = nedQz[i];
+
+    pose.velocityXYZ[0] = nedVx[i];
+    pose.velocityXYZ[1] = nedVy[i];
+    pose.velocityXYZ[2] = nedVz[i];
+
+    pose.positionXYZ_world[0] = px[i];
+    pose.positionXYZ_world[1] = py[i];
+    pose.positionXYZ_world[2] = pz[i];
+  }
+}
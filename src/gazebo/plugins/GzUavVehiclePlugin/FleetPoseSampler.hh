@@ -0,0 +1,91 @@
+/*
+ * Copyright (C) 2018 Fabio D'Urso <durso@dmi.unict.it>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+#ifndef GZUAV_FLEETPOSESAMPLER_HH_
+#define GZUAV_FLEETPOSESAMPLER_HH_
+
+#include "GzUavVehiclePlugin/common.hh"
+
+#include <gazebo/physics/physics.hh>
+
+#include <vector>
+
+namespace gazebo
+{
+namespace GzUav
+{
+  class PoseSampler;
+
+  /// \brief Samples the pose of all the vehicles in the world at once.
+  ///
+  /// Link poses, velocities and IMU readings of every registered PoseSampler
+  /// are gathered into structure-of-arrays buffers during the updateBegin2
+  /// event, before any BEGIN-TICK-AC packet is sent. Since PoseSampler is
+  /// loaded before rotors and gimbals, this runs before FleetActuator
+  /// applies the motor commands of the tick, which only take effect at the
+  /// next physics step anyway. The NED transforms only involve rotations
+  /// that are the same for all vehicles, so they are computed for the whole
+  /// fleet in plain loops over the buffers, which the compiler vectorizes.
+  /// Results are then scattered back to each PoseSampler.
+  class FleetPoseSampler
+  {
+    /// \brief Return the singleton instance.
+    public: static FleetPoseSampler *instance();
+
+    /// \brief Start sampling a vehicle at every step.
+    public: void Register(PoseSampler *_sampler);
+
+    /// \brief Stop sampling a vehicle.
+    public: void Unregister(PoseSampler *_sampler);
+
+    /// \brief Constructor.
+    private: FleetPoseSampler();
+
+    /// \brief Simulation step callback method (event 2).
+    private: void OnUpdateBegin2(const common::UpdateInfo &_info);
+
+    /// \brief Recompute the world-to-NED rotations.
+    private: void UpdateTransforms();
+
+    /// \brief Registered samplers.
+    private: std::vector<PoseSampler*> samplers;
+
+    /// \brief World the vehicles belong to.
+    private: physics::WorldPtr world;
+
+    /// \brief Rotation from Gazebo world frame to NED (row-major).
+    private: double worldToNED[9];
+
+    /// \brief Linear map from link orientation to NED orientation, acting
+    /// on (w, x, y, z) quaternion components (row-major).
+    private: double orientationToNED[16];
+
+    /// \brief Link position and linear velocity in Gazebo world frame.
+    private: std::vector<double> px, py, pz, vx, vy, vz;
+
+    /// \brief Link orientation in Gazebo world frame.
+    private: std::vector<double> qw, qx, qy, qz;
+
+    /// \brief Transformed position, velocity and orientation.
+    private: std::vector<double> nedPx, nedPy, nedPz, nedVx, nedVy, nedVz;
+    private: std::vector<double> nedQw, nedQx, nedQy, nedQz;
+
+    /// \brief Pointer to the update event connection.
+    private: event::ConnectionPtr updateConnection;
+  };
+}
+}
+#endif
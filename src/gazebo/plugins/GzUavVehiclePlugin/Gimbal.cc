@@ -18,11 +18,19 @@
  *
 */
 #include "GzUavVehiclePlugin/Gimbal.hh"
+#include "GzUavVehiclePlugin/FleetActuator.hh"
 
 using namespace gazebo;
 
-static void loadAxis(physics::ModelPtr model, sdf::ElementPtr axisSDF,
-  common::PID &pid, physics::JointPtr &joint)
+// anything to do with gazebo joint has
+// hardcoded negative joint axis for pitch and roll
+// TODO: make joint direction a parameter
+static const double rDir = -1;
+static const double pDir = -1;
+static const double yDir = 1;
+
+static size_t loadAxis(physics::ModelPtr model, sdf::ElementPtr axisSDF,
+  common::PID &pid, double dir, physics::JointPtr &joint)
 {
   GzUav::getSdfPidParams(axisSDF, "vel", pid);
 
@@ -32,6 +40,9 @@ static void loadAxis(physics::ModelPtr model, sdf::ElementPtr axisSDF,
   joint = model->GetJoint(jointName);
   if (!joint)
     gzthrow("[GzUavVehiclePlugin] Gimbal joint not found");
+
+  // Forces will be applied by FleetActuator
+  return GzUav::FleetActuator::instance()->AddJoint(joint, pid, dir);
 }
 
 static double normalizeAbout(double _angle, double reference)
@@ -98,34 +109,38 @@ GzUav::Gimbal::Gimbal(physics::ModelPtr _model, sdf::ElementPtr gimbalSDF)
     ));
 
   // Configure axes
-  this->rollPid.Init(5, 0, 0, 0, 0, 0.3, -0.3);
+  common::PID rollPid;
+  rollPid.Init(5, 0, 0, 0, 0, 0.3, -0.3);
   if (gimbalSDF->HasElement("roll"))
-    loadAxis(_model, gimbalSDF->GetElement("roll"), this->rollPid, this->rollJoint);
+    this->rollIndex = loadAxis(_model, gimbalSDF->GetElement("roll"), rollPid, rDir, this->rollJoint);
   else
     gzthrow("[GzUavVehiclePlugin] Gimbal <roll> block is missing");
 
-  this->pitchPid.Init(5, 0, 0, 0, 0, 0.3, -0.3);
+  common::PID pitchPid;
+  pitchPid.Init(5, 0, 0, 0, 0, 0.3, -0.3);
   if (gimbalSDF->HasElement("pitch"))
-    loadAxis(_model, gimbalSDF->GetElement("pitch"), this->pitchPid, this->pitchJoint);
+    this->pitchIndex = loadAxis(_model, gimbalSDF->GetElement("pitch"), pitchPid, pDir, this->pitchJoint);
   else
     gzthrow("[GzUavVehiclePlugin] Gimbal <pitch> block is missing");
 
-  this->yawPid.Init(1, 2, 0, 0, 0, 1.0, -1.0);
+  common::PID yawPid;
+  yawPid.Init(1, 2, 0, 0, 0, 1.0, -1.0);
   if (gimbalSDF->HasElement("yaw"))
-    loadAxis(_model, gimbalSDF->GetElement("yaw"), this->yawPid, this->yawJoint);
+    this->yawIndex = loadAxis(_model, gimbalSDF->GetElement("yaw"), yawPid, yDir, this->yawJoint);
   else
     gzthrow("[GzUavVehiclePlugin] Gimbal <yaw> block is missing");
 }
 
 GzUav::Gimbal::~Gimbal()
 {
+  FleetActuator::instance()->RemoveJoint(this->rollIndex);
+  FleetActuator::instance()->RemoveJoint(this->pitchIndex);
+  FleetActuator::instance()->RemoveJoint(this->yawIndex);
 }
 
 struct GzUav::gimbalOrientationSample GzUav::Gimbal::Update(double target_roll,
         double target_pitch, double target_yaw)
 {
-  common::Time curTime = this->rollJoint->GetWorld()->SimTime();
-
   this->imuSensor->Update(true);
 
   // Change sign of roll and pitch target value
@@ -141,108 +156,89 @@ struct GzUav::gimbalOrientationSample GzUav::Gimbal::Update(double target_roll,
   ignition::math::Vector3d currentAnglePRYVariable(
     QtoZXY(ignition::math::Quaterniond(currentAngleYPRVariable)));
 
-  if (prevTime != common::Time())
-  {
-    double dt = (curTime - prevTime).Double();
-
-    // anything to do with gazebo joint has
-    // hardcoded negative joint axis for pitch and roll
-    // TODO: make joint direction a parameter
-    const double rDir = -1;
-    const double pDir = -1;
-    const double yDir = 1;
-
-    // truncate command inside joint angle limits
-    double rollLimited = ignition::math::clamp(target_roll,
-      rDir*this->rollJoint->UpperLimit(0),
+  // truncate command inside joint angle limits
+  double rollLimited = ignition::math::clamp(target_roll,
+    rDir*this->rollJoint->UpperLimit(0),
 	  rDir*this->rollJoint->LowerLimit(0));
-    double pitchLimited = ignition::math::clamp(target_pitch,
-      pDir*this->pitchJoint->UpperLimit(0),
-      pDir*this->pitchJoint->LowerLimit(0));
-    double yawLimited = ignition::math::clamp(target_yaw,
-      yDir*this->yawJoint->LowerLimit(0),
+  double pitchLimited = ignition::math::clamp(target_pitch,
+    pDir*this->pitchJoint->UpperLimit(0),
+    pDir*this->pitchJoint->LowerLimit(0));
+  double yawLimited = ignition::math::clamp(target_yaw,
+    yDir*this->yawJoint->LowerLimit(0),
 	  yDir*this->yawJoint->UpperLimit(0));
 
-    ignition::math::Quaterniond commandRPY(
-      rollLimited, pitchLimited, yawLimited);
-
-    /// get joint limits (in sensor frame)
-    /// TODO: move to Load() if limits do not change
-    ignition::math::Vector3d lowerLimitsPRY
-      (pDir*this->pitchJoint->LowerLimit(0),
-       rDir*this->rollJoint->LowerLimit(0),
-       yDir*this->yawJoint->LowerLimit(0));
-    ignition::math::Vector3d upperLimitsPRY
-      (pDir*this->pitchJoint->UpperLimit(0),
-       rDir*this->rollJoint->UpperLimit(0),
-       yDir*this->yawJoint->UpperLimit(0));
-
-    // normalize errors
-    double pitchError = shortestAngularDistance(
-      pitchLimited, currentAnglePRYVariable.X());
-    double rollError = shortestAngularDistance(
-      rollLimited, currentAnglePRYVariable.Y());
-    double yawError = shortestAngularDistance(
-      yawLimited, currentAnglePRYVariable.Z());
-
-    // Clamp errors based on current angle and estimated errors from rotations:
-    // given error = current - target, then
-    // if target (current angle - error) is outside joint limit, truncate error
-    // so that current angle - error is within joint limit, i.e.:
-    // lower limit < current angle - error < upper limit
-    // or
-    // current angle - lower limit > error > current angle - upper limit
-    // re-expressed as clamps:
-    // hardcoded negative joint axis for pitch and roll
-    if (lowerLimitsPRY.X() < upperLimitsPRY.X())
-    {
-      pitchError = ignition::math::clamp(pitchError,
-        currentAnglePRYVariable.X() - upperLimitsPRY.X(),
-        currentAnglePRYVariable.X() - lowerLimitsPRY.X());
-    }
-    else
-    {
-      pitchError = ignition::math::clamp(pitchError,
-        currentAnglePRYVariable.X() - lowerLimitsPRY.X(),
-        currentAnglePRYVariable.X() - upperLimitsPRY.X());
-    }
-    if (lowerLimitsPRY.Y() < upperLimitsPRY.Y())
-    {
-      rollError = ignition::math::clamp(rollError,
-        currentAnglePRYVariable.Y() - upperLimitsPRY.Y(),
-        currentAnglePRYVariable.Y() - lowerLimitsPRY.Y());
-    }
-    else
-    {
-      rollError = ignition::math::clamp(rollError,
-        currentAnglePRYVariable.Y() - lowerLimitsPRY.Y(),
-        currentAnglePRYVariable.Y() - upperLimitsPRY.Y());
-    }
-    if (lowerLimitsPRY.Z() < upperLimitsPRY.Z())
-    {
-      yawError = ignition::math::clamp(yawError,
-        currentAnglePRYVariable.Z() - upperLimitsPRY.Z(),
-        currentAnglePRYVariable.Z() - lowerLimitsPRY.Z());
-    }
-    else
-    {
-      yawError = ignition::math::clamp(yawError,
-        currentAnglePRYVariable.Z() - lowerLimitsPRY.Z(),
-        currentAnglePRYVariable.Z() - upperLimitsPRY.Z());
-    }
-
-    // apply forces to move gimbal
-    double pitchForce = this->pitchPid.Update(pitchError, dt);
-    this->pitchJoint->SetForce(0, pDir*pitchForce);
-
-    double rollForce = this->rollPid.Update(rollError, dt);
-    this->rollJoint->SetForce(0, rDir*rollForce);
-
-    double yawForce = this->yawPid.Update(yawError, dt);
-    this->yawJoint->SetForce(0, yDir*yawForce);
+  ignition::math::Quaterniond commandRPY(
+    rollLimited, pitchLimited, yawLimited);
+
+  /// get joint limits (in sensor frame)
+  /// TODO: move to Load() if limits do not change
+  ignition::math::Vector3d lowerLimitsPRY
+    (pDir*this->pitchJoint->LowerLimit(0),
+     rDir*this->rollJoint->LowerLimit(0),
+     yDir*this->yawJoint->LowerLimit(0));
+  ignition::math::Vector3d upperLimitsPRY
+    (pDir*this->pitchJoint->UpperLimit(0),
+     rDir*this->rollJoint->UpperLimit(0),
+     yDir*this->yawJoint->UpperLimit(0));
+
+  // normalize errors
+  double pitchError = shortestAngularDistance(
+    pitchLimited, currentAnglePRYVariable.X());
+  double rollError = shortestAngularDistance(
+    rollLimited, currentAnglePRYVariable.Y());
+  double yawError = shortestAngularDistance(
+    yawLimited, currentAnglePRYVariable.Z());
+
+  // Clamp errors based on current angle and estimated errors from rotations:
+  // given error = current - target, then
+  // if target (current angle - error) is outside joint limit, truncate error
+  // so that current angle - error is within joint limit, i.e.:
+  // lower limit < current angle - error < upper limit
+  // or
+  // current angle - lower limit > error > current angle - upper limit
+  // re-expressed as clamps:
+  // hardcoded negative joint axis for pitch and roll
+  if (lowerLimitsPRY.X() < upperLimitsPRY.X())
+  {
+    pitchError = ignition::math::clamp(pitchError,
+      currentAnglePRYVariable.X() - upperLimitsPRY.X(),
+      currentAnglePRYVariable.X() - lowerLimitsPRY.X());
+  }
+  else
+  {
+    pitchError = ignition::math::clamp(pitchError,
+      currentAnglePRYVariable.X() - lowerLimitsPRY.X(),
+      currentAnglePRYVariable.X() - upperLimitsPRY.X());
+  }
+  if (lowerLimitsPRY.Y() < upperLimitsPRY.Y())
+  {
+    rollError = ignition::math::clamp(rollError,
+      currentAnglePRYVariable.Y() - upperLimitsPRY.Y(),
+      currentAnglePRYVariable.Y() - lowerLimitsPRY.Y());
+  }
+  else
+  {
+    rollError = ignition::math::clamp(rollError,
+      currentAnglePRYVariable.Y() - lowerLimitsPRY.Y(),
+      currentAnglePRYVariable.Y() - upperLimitsPRY.Y());
+  }
+  if (lowerLimitsPRY.Z() < upperLimitsPRY.Z())
+  {
+    yawError = ignition::math::clamp(yawError,
+      currentAnglePRYVariable.Z() - upperLimitsPRY.Z(),
+      currentAnglePRYVariable.Z() - lowerLimitsPRY.Z());
+  }
+  else
+  {
+    yawError = ignition::math::clamp(yawError,
+      currentAnglePRYVariable.Z() - lowerLimitsPRY.Z(),
+      currentAnglePRYVariable.Z() - upperLimitsPRY.Z());
   }
 
-  prevTime = curTime;
+  // forces to move gimbal will be applied by FleetActuator
+  FleetActuator::instance()->SetError(this->pitchIndex, pitchError);
+  FleetActuator::instance()->SetError(this->rollIndex, rollError);
+  FleetActuator::instance()->SetError(this->yawIndex, yawError);
 
   // Change sign of roll and pitch readings
   gimbalOrientationSample result;
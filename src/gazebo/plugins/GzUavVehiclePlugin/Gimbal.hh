@@ -41,9 +41,10 @@ namespace GzUav
     public: struct gimbalOrientationSample Update(double target_roll,
         double target_pitch, double target_yaw);
 
-    private: common::PID rollPid;
-    private: common::PID pitchPid;
-    private: common::PID yawPid;
+    /// \brief Indices of the joints in FleetActuator.
+    private: size_t rollIndex;
+    private: size_t pitchIndex;
+    private: size_t yawIndex;
 
     private: physics::JointPtr rollJoint;
     private: physics::JointPtr pitchJoint;
@@ -51,9 +52,6 @@ namespace GzUav
 
     /// \brief Pointer to an IMU sensor
     private: sensors::ImuSensorPtr imuSensor;
-
-    /// \brief Simulation time of last OnUpdate call.
-    private: common::Time prevTime;
   };
 }
 }
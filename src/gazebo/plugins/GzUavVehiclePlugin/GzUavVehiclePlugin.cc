@@ -19,6 +19,7 @@
 #include "GzUavPhaseGenerator.hh"
 
 #include <sys/socket.h>
+#include <sys/uio.h>
 #include <sys/un.h>
 
 using namespace gazebo;
@@ -26,7 +27,9 @@ using namespace gazebo;
 GZ_REGISTER_MODEL_PLUGIN(GzUav::GzUavVehiclePlugin)
 
 GzUav::GzUavVehiclePlugin::GzUavVehiclePlugin()
+  : gimbal(nullptr)
 {
+  memset(&this->gimbalSample, 0, sizeof(this->gimbalSample));
 }
 
 GzUav::GzUavVehiclePlugin::~GzUavVehiclePlugin()
@@ -36,6 +39,8 @@ GzUav::GzUavVehiclePlugin::~GzUavVehiclePlugin()
     Rotor *rotor = it.first;
     delete rotor;
   }
+
+  delete this->gimbal;
 }
 
 void GzUav::GzUavVehiclePlugin::Load(physics::ModelPtr _model, sdf::ElementPtr _sdf)
@@ -51,7 +56,6 @@ void GzUav::GzUavVehiclePlugin::Load(physics::ModelPtr _model, sdf::ElementPtr _
 
   // Initialize internal components and rotors
   this->poseSampler.Load(_model, _sdf);
-  this->gimbal = nullptr;
   sdf::ElementPtr elemSDF = _sdf->GetFirstElement();
 
   while (elemSDF)
@@ -64,6 +68,9 @@ void GzUav::GzUavVehiclePlugin::Load(physics::ModelPtr _model, sdf::ElementPtr _
       else
         gzthrow("[GzUavVehiclePlugin] <rotor channel=\"nn\">...</rotor> must be set");
 
+      if (channel < 0 || channel >= GZUAV_MAX_MOTORS)
+        gzthrow("[GzUavVehiclePlugin] rotor channel is out of range");
+
       Rotor *rotor = new Rotor(this->model, elemSDF);
       this->rotors.emplace(rotor, channel);
     }
@@ -88,9 +95,35 @@ void GzUav::GzUavVehiclePlugin::Load(physics::ModelPtr _model, sdf::ElementPtr _
   if (connect(this->sock, (struct sockaddr*)&addr, sizeof(addr)) == -1)
     gzthrow("[GzUavVehiclePlugin] connect failed");
 
-  // Send IDENTIFY-UAV message
+  // Send HELLO message
   std::string uav_name = _model->GetName();
-  send(this->sock, uav_name.c_str(), uav_name.length(), 0);
+  Protocol::Hello hello;
+  memset(&hello, 0, sizeof(hello));
+  hello.caps = Protocol::SUPPORTED_CAPS;
+  hello.role = Protocol::ROLE_SIMULATOR;
+
+  std::string helloMsg(sizeof(Protocol::Header) + sizeof(hello), '\0');
+  Protocol::Header h = Protocol::makeHeader(Protocol::PKT_HELLO, 0,
+    sizeof(hello) + uav_name.length());
+  memcpy(&helloMsg[0], &h, sizeof(h));
+  memcpy(&helloMsg[sizeof(h)], &hello, sizeof(hello));
+  helloMsg += uav_name;
+
+  if (send(this->sock, helloMsg.data(), helloMsg.length(), 0) != (ssize_t)helloMsg.length())
+    gzthrow("[GzUavVehiclePlugin] send HELLO failed");
+
+  // Receive HELLO-ACK message
+  char ackMsg[sizeof(Protocol::Header) + sizeof(Protocol::HelloAck)];
+  ssize_t r = recv(this->sock, ackMsg, sizeof(ackMsg), 0);
+  memcpy(&h, ackMsg, sizeof(h));
+  if (r != sizeof(ackMsg) || !Protocol::isValidMessage(ackMsg, r)
+      || h.type != Protocol::PKT_HELLO_ACK)
+    gzthrow("[GzUavVehiclePlugin] invalid HELLO-ACK from gzuavchannel");
+
+  Protocol::HelloAck ack;
+  memcpy(&ack, ackMsg + sizeof(h), sizeof(ack));
+  this->uavId = ack.uavId;
+  this->caps = ack.caps;
 
   // Request OnUpdate callbacks
   this->updateConnection1 = GzUavPhaseGenerator::instance()->updateBegin1.Connect(
@@ -103,23 +136,36 @@ void GzUav::GzUavVehiclePlugin::OnUpdateBegin1()
 {
   ssize_t r;
 
-  // Receive END-TICK-AC packet
-  struct packetEndTickAC endTickPkt;
+  // Receive END-TICK packet
+  Protocol::Header h;
+  Protocol::EndTick endTickPkt;
+  struct iovec iov[2] = {
+    { &h, sizeof(h) },
+    { &endTickPkt, sizeof(endTickPkt) }
+  };
 
-  r = recv(this->sock,
-           reinterpret_cast<void *>(&endTickPkt),
-           sizeof(endTickPkt),
-           0);
+  struct msghdr mh;
+  memset(&mh, 0, sizeof(mh));
+  mh.msg_iov = iov;
+  mh.msg_iovlen = 2;
 
-  if (r != sizeof(endTickPkt))
+  r = recvmsg(this->sock, &mh, 0);
+
+  if (r != sizeof(h) + sizeof(endTickPkt))
     gzthrow("[GzUavVehiclePlugin] recv failed");
 
+  if (h.magic != Protocol::MAGIC || h.version != Protocol::VERSION
+      || h.type != Protocol::PKT_END_TICK || h.uavId != this->uavId
+      || h.length != sizeof(endTickPkt))
+    gzthrow("[GzUavVehiclePlugin] invalid END-TICK packet");
+
+  // Commands are actually applied by FleetActuator, for all vehicles at once
   for (std::pair<Rotor*, int> it : rotors)
   {
     Rotor *rotor = it.first;
     int channel = it.second;
 
-    rotor->ApplyMotorCommand(endTickPkt.motorCommands[channel]);
+    rotor->SetMotorCommand(endTickPkt.motorCommands[channel]);
   }
 
   if (this->gimbal != nullptr)
@@ -136,18 +182,39 @@ void GzUav::GzUavVehiclePlugin::OnUpdateBegin3()
 {
   ssize_t r;
 
-  // Send BEGIN-TICK-AC packet
-  struct packetBeginTickAC beginTickPkt;
+  // Send BEGIN-TICK packet
+  Protocol::BeginTick beginTickPkt;
 
   beginTickPkt.timestamp = this->model->GetWorld()->SimTime().Double();
   beginTickPkt.vehiclePose = this->poseSampler.Sample();
-  beginTickPkt.gimbalOrientation = this->gimbalSample;
+  memcpy(beginTickPkt.gimbalRPY, this->gimbalSample.gimbalRPY,
+         sizeof(beginTickPkt.gimbalRPY));
+
+  // Halve the packet size if gzuavchannel accepts single precision values
+  Protocol::CompactBeginTick compactPkt;
+  void *payload = &beginTickPkt;
+  size_t payloadLen = sizeof(beginTickPkt);
+  if (this->caps & Protocol::CAP_COMPACT_BEGIN_TICK)
+  {
+    Protocol::compactBeginTick(beginTickPkt, &compactPkt);
+    payload = &compactPkt;
+    payloadLen = sizeof(compactPkt);
+  }
+
+  Protocol::Header h = Protocol::makeHeader(Protocol::PKT_BEGIN_TICK,
+    this->uavId, payloadLen);
+  struct iovec iov[2] = {
+    { &h, sizeof(h) },
+    { payload, payloadLen }
+  };
+
+  struct msghdr mh;
+  memset(&mh, 0, sizeof(mh));
+  mh.msg_iov = iov;
+  mh.msg_iovlen = 2;
 
-  r = send(this->sock,
-           reinterpret_cast<const void *>(&beginTickPkt),
-           sizeof(beginTickPkt),
-           0);
+  r = sendmsg(this->sock, &mh, 0);
 
-  if (r != sizeof(beginTickPkt))
+  if (r != (ssize_t)(sizeof(h) + payloadLen))
     gzthrow("[GzUavVehiclePlugin] send failed");
 }
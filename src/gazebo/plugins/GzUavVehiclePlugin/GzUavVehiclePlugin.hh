@@ -49,6 +49,12 @@ namespace GzUav
     /// \brief Unix domain socket connected to gzuavchannel.
     private: int sock;
 
+    /// \brief UAV id assigned by gzuavchannel.
+    private: uint16_t uavId;
+
+    /// \brief Protocol capabilities enabled by gzuavchannel.
+    private: uint32_t caps;
+
     /// \brief Pointers to the update event connections.
     private: event::ConnectionPtr updateConnection1, updateConnection3;
 
@@ -26,6 +26,8 @@ namespace gazebo
 {
 namespace GzUav
 {
+  /// \brief Per-vehicle state sampler. Samples are actually produced by
+  /// FleetPoseSampler, for all vehicles at once.
   class PoseSampler
   {
     /// \brief Constructor.
@@ -37,14 +39,25 @@ namespace GzUav
     /// \brief Initialize this sampler.
     public: void Load(physics::ModelPtr _model, sdf::ElementPtr _sdf);
 
-    /// \brief Produce one pose sample according to the current vehicle state.
-    public: struct poseSample Sample();
+    /// \brief Return the pose sample taken during the current step.
+    public: const poseSample &Sample() const;
 
     /// \brief Pointer to the model;
     private: physics::ModelPtr model;
 
+    /// \brief Pointer to the model's canonical link.
+    private: physics::LinkPtr link;
+
     /// \brief Pointer to an IMU sensor
     private: sensors::ImuSensorPtr imuSensor;
+
+    /// \brief Latest sample.
+    private: poseSample sample;
+
+    /// \brief Whether this sampler is registered with FleetPoseSampler.
+    private: bool registered;
+
+    friend class FleetPoseSampler;
   };
 }
 }
@@ -16,6 +16,7 @@
  *
 */
 #include "GzUavVehiclePlugin/Rotor.hh"
+#include "GzUavVehiclePlugin/FleetActuator.hh"
 
 using namespace gazebo;
 
@@ -26,8 +27,8 @@ GzUav::Rotor::Rotor(physics::ModelPtr _model, sdf::ElementPtr rotorSDF)
   // Get pointer to the joint
   std::string jointName;
   getSdfParam<std::string>(rotorSDF, "joint_name", jointName, "<missing joint_name>", true);
-  this->joint = _model->GetJoint(jointName);
-  if (!this->joint)
+  physics::JointPtr joint = _model->GetJoint(jointName);
+  if (!joint)
     gzthrow("[GzUavVehiclePlugin] Joint not found");
 
   // Get turning direction
@@ -40,28 +41,21 @@ GzUav::Rotor::Rotor(physics::ModelPtr _model, sdf::ElementPtr rotorSDF)
   else
     gzthrow("[GzUavVehiclePlugin] Invalid turning direction");
 
-  // Initialize PID with default values
-  this->pid.Init(0.1, 0, 0, 0, 0, 1.0, -1.0);
-  getSdfPidParams(rotorSDF, "vel", this->pid);
+  // Initialize velocity PID with default values
+  common::PID pid;
+  pid.Init(0.1, 0, 0, 0, 0, 1.0, -1.0);
+  getSdfPidParams(rotorSDF, "vel", pid);
+
+  this->jointIndex = FleetActuator::instance()->AddJoint(joint, pid, 1.0);
 }
 
 GzUav::Rotor::~Rotor()
 {
+  FleetActuator::instance()->RemoveJoint(this->jointIndex);
 }
 
-void GzUav::Rotor::ApplyMotorCommand(float command)
+void GzUav::Rotor::SetMotorCommand(float command)
 {
-  common::Time curTime = this->joint->GetWorld()->SimTime();
-
-  if (prevTime != common::Time())
-  {
-    double velTarget = this->multiplier * this->maxRpm * command;
-    double vel = this->joint->GetVelocity(0);
-    double error = vel - velTarget;
-    double force = this->pid.Update(error, (curTime - prevTime).Double());
-
-    this->joint->SetForce(0, force);
-  }
-
-  prevTime = curTime;
+  FleetActuator::instance()->SetVelocityTarget(this->jointIndex,
+    this->multiplier * this->maxRpm * command);
 }
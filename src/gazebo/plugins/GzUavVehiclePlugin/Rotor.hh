@@ -34,23 +34,18 @@ namespace GzUav
     /// \brief Destructor.
     public: ~Rotor();
 
-    /// \brief Apply motor command.
-    public: void ApplyMotorCommand(float command);
+    /// \brief Set the motor command for the current step. It will be
+    /// applied by FleetActuator.
+    public: void SetMotorCommand(float command);
 
     /// \brief Max rotor propeller RPM.
     private: double maxRpm;
 
-    /// \brief Velocity PID for motor control.
-    private: common::PID pid;
-
-    /// \brief Control propeller joint.
-    private: physics::JointPtr joint;
-
     /// \brief Direction multiplier for this rotor.
     private: double multiplier;
 
-    /// \brief Simulation time of last ApplyMotorCommand call.
-    private: common::Time prevTime;
+    /// \brief Index of the propeller joint in FleetActuator.
+    private: size_t jointIndex;
   };
 }
 }
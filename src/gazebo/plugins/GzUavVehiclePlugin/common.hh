@@ -18,11 +18,11 @@
 #ifndef GZUAV_COMMON_HH_
 #define GZUAV_COMMON_HH_
 
+#include "GzUav/Protocol.h"
+
 #include <sdf/sdf.hh>
 #include <gazebo/common/common.hh>
 
-#define MAX_MOTORS 16
-
 namespace gazebo
 {
 namespace GzUav
@@ -58,27 +58,11 @@ namespace GzUav
   void getSdfPidParams(sdf::ElementPtr _sdf, const std::string &_prefix,
     common::PID &_pid);
 
-  /// \brief A struct containing pose and other dynamics info.
-  struct poseSample
-  {
-    /// \brief Model position in world frame
-    double positionXYZ_world[3];
-
-    /// \brief IMU angular velocity
-    double imuAngularVelocityRPY[3];
+  /// \brief Wire protocol shared with gzuavchannel.
+  namespace Protocol = ::GzUavProtocol;
 
-    /// \brief IMU linear acceleration
-    double imuLinearAccelerationXYZ[3];
-
-    /// \brief IMU quaternion orientation
-    double imuOrientationQuat[4];
-
-    /// \brief Model velocity in NED frame
-    double velocityXYZ[3];
-
-    /// \brief Model position in NED frame
-    double positionXYZ[3];
-  };
+  /// \brief A struct containing pose and other dynamics info.
+  typedef Protocol::PoseSample poseSample;
 
   /// \brief A struct containing current gimbal angles.
   struct gimbalOrientationSample
@@ -86,29 +70,6 @@ namespace GzUav
     /// \brief Gimbal orientation (yaw=0 is north)
     double gimbalRPY[3];
   };
-
-  /// \brief An outgoing packet (sent at the beginning of each simulation step).
-  struct packetBeginTickAC
-  {
-    /// \brief Packet timestamp
-    double timestamp;
-
-    /// \brief Vehicle pose and other dynamics info
-    poseSample vehiclePose;
-
-    /// \brief Gimbal orientation.
-    gimbalOrientationSample gimbalOrientation;
-  };
-
-  /// \brief An incoming packet (received at the end of each simulation step).
-  struct packetEndTickAC
-  {
-    /// \brief Motor commands sent by ArduCopter.
-    float motorCommands[MAX_MOTORS];
-
-    /// \brief Gimbal setpoint (yaw=0 is north)
-    float gimbalRPY[3];
-  };
 }
 }
 #endif
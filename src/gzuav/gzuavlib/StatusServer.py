@@ -1,5 +1,6 @@
 import json
 import http.server
+import socket
 import socketserver
 import sys
 import threading
@@ -7,6 +8,8 @@ import threading
 _status = 'WAITING'
 _uav_info = None
 _network_info = None
+_stats_path = None
+_mavmix_stats_socket = None
 
 class _Handler(http.server.BaseHTTPRequestHandler):
     def do_GET(self):
@@ -16,6 +19,19 @@ class _Handler(http.server.BaseHTTPRequestHandler):
                 'uav_info': _uav_info,
                 'network_info': _network_info
             }))
+        elif self.path == '/stats' and _stats_path is not None:
+            # Latest timing/straggler dump written by gzuavchannel
+            try:
+                with open(_stats_path, 'rt') as fp:
+                    self._send_text(fp.read())
+            except FileNotFoundError:
+                self.send_error(404, 'No statistics available yet')
+        elif self.path == '/mavlink-stats' and _mavmix_stats_socket is not None:
+            # Per-UAV MAVLink counters, queried from mavmix
+            try:
+                self._send_text(_query_unix_socket(_mavmix_stats_socket))
+            except OSError:
+                self.send_error(503, 'mavmix is not running')
 
     def _send_text(self, text):
         self.send_response(200)
@@ -24,10 +40,26 @@ class _Handler(http.server.BaseHTTPRequestHandler):
 
         self.wfile.write(text.encode('utf-8'))
 
-def start(port, uav_info, network_info):
-    global _uav_info, _network_info
+def _query_unix_socket(path):
+    with socket.socket(socket.AF_UNIX, socket.SOCK_STREAM) as sk:
+        sk.settimeout(5)
+        sk.connect(path)
+
+        chunks = []
+        while True:
+            chunk = sk.recv(65536)
+            if not chunk:
+                break
+            chunks.append(chunk)
+
+    return b''.join(chunks).decode('utf-8')
+
+def start(port, uav_info, network_info, stats_path=None, mavmix_stats_socket=None):
+    global _uav_info, _network_info, _stats_path, _mavmix_stats_socket
     _uav_info = uav_info
     _network_info = network_info
+    _stats_path = stats_path
+    _mavmix_stats_socket = mavmix_stats_socket
 
     socketserver.TCPServer.allow_reuse_address = True
     httpd = socketserver.TCPServer(("0.0.0.0", port), _Handler)
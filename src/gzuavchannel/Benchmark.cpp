@@ -0,0 +1,524 @@
+// End-to-end lockstep benchmark for gzuavchannel.
+//
+// For each configuration, gzuavchannel is started with a UDS upstream and a
+// TCP downstream, both driven by synthetic peers in this process, and with
+// an optional number of phase 0 / phase 1 ExternalSyncServer subscribers.
+// The tick latency is measured from the moment the downstream END-TICK
+// packets are sent to the moment all the resulting BEGIN-TICK packets have
+// been received back.
+
+#include "TickStats.h"
+
+#include "GzUav/Protocol.h"
+
+#include <arpa/inet.h>
+#include <err.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <string>
+#include <thread>
+#include <vector>
+
+#define BEGIN_TICK_SIZE sizeof(GzUavProtocol::BeginTick)
+#define END_TICK_SIZE sizeof(GzUavProtocol::EndTick)
+
+enum
+{
+	OPT_GZUAVCHANNEL = 256,
+	OPT_MAX_UAVS,
+	OPT_TICKS,
+	OPT_WARMUP,
+	OPT_PHASE0,
+	OPT_PHASE1,
+};
+
+static option long_options[] =
+{
+	{ "help", no_argument, nullptr, 'h' },
+	{ "gzuavchannel", required_argument, nullptr, OPT_GZUAVCHANNEL },
+	{ "max-uavs", required_argument, nullptr, OPT_MAX_UAVS },
+	{ "ticks", required_argument, nullptr, OPT_TICKS },
+	{ "warmup", required_argument, nullptr, OPT_WARMUP },
+	{ "phase0", required_argument, nullptr, OPT_PHASE0 },
+	{ "phase1", required_argument, nullptr, OPT_PHASE1 },
+	{ nullptr, 0, nullptr, 0 }
+};
+
+static void showHelp()
+{
+	fprintf(stderr, "Usage: %s [options] [-- extra gzuavchannel options...]\n", program_invocation_name);
+	fprintf(stderr, "\n");
+	fprintf(stderr, "This program measures gzuavchannel's lockstep throughput with 1, 2, 4, ...\n");
+	fprintf(stderr, "UAVs, using synthetic upstream (UDS) and downstream (TCP) peers.\n");
+	fprintf(stderr, "\n");
+	fprintf(stderr, "Options:\n");
+	fprintf(stderr, " --gzuavchannel PATH: gzuavchannel executable (default: %s)\n", GZUAVCHANNEL_PATH);
+	fprintf(stderr, " --max-uavs N: Largest number of UAVs to be tested (default: 64)\n");
+	fprintf(stderr, " --ticks N: Number of measured ticks per configuration (default: 10000)\n");
+	fprintf(stderr, " --warmup N: Number of unmeasured ticks per configuration (default: 1000)\n");
+	fprintf(stderr, " --phase0 N: Number of phase 0 ExternalSyncServer subscribers (default: 0)\n");
+	fprintf(stderr, " --phase1 N: Number of phase 1 ExternalSyncServer subscribers (default: 0)\n");
+	fprintf(stderr, "\n");
+
+	exit(EXIT_FAILURE);
+}
+
+static int parseCount(const char *text, const char *optname, int min)
+{
+	char *endp;
+	long value = strtol(text, &endp, 10);
+	if (*text == '\0' || *endp != '\0' || value < min)
+		errx(EXIT_FAILURE, "option '%s' has invalid format", optname);
+	return value;
+}
+
+static void recvAll(int fd, void *buf, size_t len)
+{
+	if (recv(fd, buf, len, MSG_WAITALL) != (ssize_t)len)
+		errx(EXIT_FAILURE, "connection to gzuavchannel lost");
+}
+
+static void sendAll(int fd, const void *buf, size_t len)
+{
+	while (len != 0)
+	{
+		ssize_t r = send(fd, buf, len, MSG_NOSIGNAL);
+		if (r <= 0)
+			err(EXIT_FAILURE, "send to gzuavchannel failed");
+
+		buf = r + (const char*)buf;
+		len -= r;
+	}
+}
+
+static void appendBE16(std::vector<uint8_t> &buf, uint16_t val)
+{
+	buf.push_back(val >> 8);
+	buf.push_back(val & 0xff);
+}
+
+static void appendBE32(std::vector<uint8_t> &buf, uint32_t val)
+{
+	appendBE16(buf, val >> 16);
+	appendBE16(buf, val & 0xffff);
+}
+
+// Find a TCP port that is currently unused
+static int findFreePort()
+{
+	int fd = socket(AF_INET, SOCK_STREAM, 0);
+
+	struct sockaddr_in addr;
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+	socklen_t addrlen = sizeof(addr);
+	if (bind(fd, (struct sockaddr*)&addr, sizeof(addr)) < 0
+		|| getsockname(fd, (struct sockaddr*)&addr, &addrlen) < 0)
+	{
+		err(EXIT_FAILURE, "cannot allocate a TCP port");
+	}
+
+	close(fd);
+	return ntohs(addr.sin_port);
+}
+
+static int connectTcp(int port)
+{
+	struct sockaddr_in addr;
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	addr.sin_port = htons(port);
+
+	int fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+	if (connect(fd, (struct sockaddr*)&addr, sizeof(addr)) < 0)
+		err(EXIT_FAILURE, "connect to port %d failed", port);
+
+	int optval = 1;
+	setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &optval, sizeof(optval));
+
+	return fd;
+}
+
+static int connectUds(const std::string &path)
+{
+	struct sockaddr_un addr;
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	strncpy(addr.sun_path, path.c_str(), sizeof(addr.sun_path) - 1);
+
+	int fd = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+	if (connect(fd, (struct sockaddr*)&addr, sizeof(addr)) < 0)
+	{
+		close(fd);
+		return -1;
+	}
+
+	return fd;
+}
+
+// ExternalSyncServer subscriber that acknowledges everything immediately
+static void runSyncSubscriber(int fd, char phase)
+{
+	sendAll(fd, &phase, 1);
+
+	std::vector<uint8_t> buf;
+	while (true)
+	{
+		if (phase == 0)
+		{
+			double ts;
+			if (recv(fd, &ts, sizeof(ts), MSG_WAITALL) != sizeof(ts))
+				break;
+		}
+		else
+		{
+			uint8_t header[sizeof(double) + sizeof(uint32_t)];
+			if (recv(fd, header, sizeof(header), MSG_WAITALL) != sizeof(header))
+				break;
+
+			uint32_t count;
+			memcpy(&count, header + sizeof(double), sizeof(count));
+
+			buf.resize(count * (sizeof(uint32_t) + 3 * sizeof(double)));
+			if (!buf.empty() && recv(fd, buf.data(), buf.size(), MSG_WAITALL) != (ssize_t)buf.size())
+				break;
+		}
+
+		char ack = '!';
+		if (send(fd, &ack, 1, MSG_NOSIGNAL) != 1)
+			break;
+	}
+
+	close(fd);
+}
+
+// Total CPU time (user + system) consumed by a process, in clock ticks
+static uint64_t processCpuTicks(pid_t pid)
+{
+	char path[64];
+	sprintf(path, "/proc/%d/stat", (int)pid);
+
+	FILE *fp = fopen(path, "r");
+	if (fp == nullptr)
+		return 0;
+
+	char buf[1024];
+	size_t len = fread(buf, 1, sizeof(buf) - 1, fp);
+	buf[len] = '\0';
+	fclose(fp);
+
+	// Skip pid and comm (which may contain spaces), then fields 3 to 13
+	const char *p = strrchr(buf, ')');
+	unsigned long utime = 0, stime = 0;
+	if (p == nullptr || sscanf(p + 2, "%*c %*d %*d %*d %*d %*d %*u %*u %*u %*u %*u %lu %lu", &utime, &stime) != 2)
+		return 0;
+
+	return utime + stime;
+}
+
+struct Config
+{
+	const char *gzuavchannelPath;
+	std::vector<const char*> extraArgs;
+	int ticks, warmup;
+	int phase0, phase1;
+};
+
+struct Result
+{
+	double ticksPerSecond;
+	uint64_t p50, p99;
+	double cpuPercent;
+};
+
+static Result runBenchmark(const Config &cfg, int uavCount)
+{
+	char tmpdir[] = "/tmp/gzuavchannel-bench.XXXXXX";
+	if (mkdtemp(tmpdir) == nullptr)
+		err(EXIT_FAILURE, "mkdtemp failed");
+
+	std::string udsPath = std::string(tmpdir) + "/upstream";
+	int downstreamPort = findFreePort();
+	int syncPort = findFreePort();
+
+	std::vector<std::string> names;
+	for (int i = 0; i < uavCount; i++)
+		names.push_back("uav" + std::to_string(i));
+
+	// Start gzuavchannel with its stdout connected to a pipe
+	std::string upstreamSpec = "uds:" + udsPath;
+	std::string downstreamSpec = "tcpl:" + std::to_string(downstreamPort);
+	std::string syncPortText = std::to_string(syncPort);
+
+	std::vector<char*> argv;
+	argv.push_back(const_cast<char*>(cfg.gzuavchannelPath));
+	argv.push_back(const_cast<char*>("--upstream"));
+	argv.push_back(const_cast<char*>(upstreamSpec.c_str()));
+	argv.push_back(const_cast<char*>("--downstream"));
+	argv.push_back(const_cast<char*>(downstreamSpec.c_str()));
+	if (cfg.phase0 != 0 || cfg.phase1 != 0)
+	{
+		argv.push_back(const_cast<char*>("--external-sync-server"));
+		argv.push_back(const_cast<char*>(syncPortText.c_str()));
+	}
+	for (const char *arg : cfg.extraArgs)
+		argv.push_back(const_cast<char*>(arg));
+	for (const std::string &name : names)
+		argv.push_back(const_cast<char*>(name.c_str()));
+	argv.push_back(nullptr);
+
+	int pipefd[2];
+	if (pipe(pipefd) != 0)
+		err(EXIT_FAILURE, "pipe failed");
+
+	pid_t pid = fork();
+	if (pid < 0)
+	{
+		err(EXIT_FAILURE, "fork failed");
+	}
+	else if (pid == 0)
+	{
+		dup2(pipefd[1], STDOUT_FILENO);
+		close(pipefd[0]);
+		close(pipefd[1]);
+
+		// Silence connection messages
+		int devnull = open("/dev/null", O_WRONLY);
+		dup2(devnull, STDERR_FILENO);
+
+		execv(argv[0], argv.data());
+		_exit(127);
+	}
+
+	close(pipefd[1]);
+	FILE *status = fdopen(pipefd[0], "r");
+
+	// Wait for the given status line
+	auto waitStatus = [&](const char *expected)
+	{
+		char line[128];
+		while (fgets(line, sizeof(line), status) != nullptr)
+		{
+			line[strcspn(line, "\n")] = '\0';
+			if (strcmp(line, expected) == 0)
+				return;
+		}
+
+		errx(EXIT_FAILURE, "gzuavchannel terminated while waiting for %s", expected);
+	};
+
+	// Connect upstream peers, like GzUavVehiclePlugin does
+	waitStatus("GZUAVCHANNEL:STARTING");
+	std::vector<int> upstreamFds;
+	for (const std::string &name : names)
+	{
+		// The socket might not be listening yet
+		int fd;
+		while ((fd = connectUds(udsPath)) < 0)
+			usleep(1000);
+
+		GzUavProtocol::Header h = GzUavProtocol::makeHeader(GzUavProtocol::PKT_HELLO, 0,
+			sizeof(GzUavProtocol::Hello) + name.length());
+		GzUavProtocol::Hello hello;
+		memset(&hello, 0, sizeof(hello));
+		hello.role = GzUavProtocol::ROLE_SIMULATOR;
+
+		std::vector<uint8_t> msg((const uint8_t*)&h, (const uint8_t*)(&h + 1));
+		msg.insert(msg.end(), (const uint8_t*)&hello, (const uint8_t*)(&hello + 1));
+		msg.insert(msg.end(), name.begin(), name.end());
+		sendAll(fd, msg.data(), msg.size());
+
+		upstreamFds.push_back(fd);
+	}
+
+	// Receive HELLO-ACKs
+	for (int fd : upstreamFds)
+	{
+		uint8_t ack[sizeof(GzUavProtocol::Header) + sizeof(GzUavProtocol::HelloAck)];
+		if (recv(fd, ack, sizeof(ack), 0) != sizeof(ack))
+			errx(EXIT_FAILURE, "connection to gzuavchannel lost");
+	}
+
+	// Connect downstream peer, like gzuavchannel's tcpc transport does
+	waitStatus("GZUAVCHANNEL:TCP-LISTENING");
+	int downstreamFd = connectTcp(downstreamPort);
+	std::vector<uint8_t> hello;
+	appendBE32(hello, GzUavProtocol::TCP_MAGIC);
+	appendBE16(hello, GzUavProtocol::VERSION);
+	appendBE16(hello, 0);
+	appendBE32(hello, 0); // no capabilities
+	appendBE16(hello, uavCount);
+	for (const std::string &name : names)
+	{
+		appendBE16(hello, name.length());
+		hello.insert(hello.end(), name.begin(), name.end());
+	}
+	sendAll(downstreamFd, hello.data(), hello.size());
+	uint8_t helloReply[sizeof(GzUavProtocol::TcpHello)];
+	recvAll(downstreamFd, helloReply, sizeof(helloReply));
+	waitStatus("GZUAVCHANNEL:GO");
+
+	// Start ExternalSyncServer subscribers
+	std::vector<std::thread> subscribers;
+	for (int i = 0; i < cfg.phase0 + cfg.phase1; i++)
+		subscribers.emplace_back(runSyncSubscriber, connectTcp(syncPort), (char)(i < cfg.phase0 ? 0 : 1));
+
+	// Pre-build the downstream END-TICK packets of all UAVs
+	std::vector<uint8_t> endTickFrames;
+	for (int i = 0; i < uavCount; i++)
+	{
+		appendBE16(endTickFrames, i);
+		appendBE16(endTickFrames, END_TICK_SIZE);
+		endTickFrames.resize(endTickFrames.size() + END_TICK_SIZE, 0);
+	}
+
+	std::vector<uint8_t> beginTickFrames(uavCount * (4 + BEGIN_TICK_SIZE));
+	GzUavProtocol::BeginTick beginTickPkt;
+	memset(&beginTickPkt, 0, sizeof(beginTickPkt));
+	uint8_t endTickPkt[sizeof(GzUavProtocol::Header) + END_TICK_SIZE];
+
+	LatencyHistogram hist;
+	uint64_t startTime = 0, startCpu = 0;
+
+	for (int tick = 0; tick < cfg.warmup + cfg.ticks; tick++)
+	{
+		if (tick == cfg.warmup)
+		{
+			startTime = TickStats::now();
+			startCpu = processCpuTicks(pid);
+		}
+
+		uint64_t t0 = TickStats::now();
+
+		sendAll(downstreamFd, endTickFrames.data(), endTickFrames.size());
+
+		beginTickPkt.timestamp = tick * 0.001;
+		for (int i = 0; i < uavCount; i++)
+		{
+			if (recv(upstreamFds[i], endTickPkt, sizeof(endTickPkt), 0) != sizeof(endTickPkt))
+				errx(EXIT_FAILURE, "connection to gzuavchannel lost");
+
+			GzUavProtocol::Header h = GzUavProtocol::makeHeader(GzUavProtocol::PKT_BEGIN_TICK,
+				i, sizeof(beginTickPkt));
+			uint8_t msg[sizeof(h) + sizeof(beginTickPkt)];
+			memcpy(msg, &h, sizeof(h));
+			memcpy(msg + sizeof(h), &beginTickPkt, sizeof(beginTickPkt));
+			sendAll(upstreamFds[i], msg, sizeof(msg));
+		}
+
+		recvAll(downstreamFd, beginTickFrames.data(), beginTickFrames.size());
+
+		if (tick >= cfg.warmup)
+			hist.record(TickStats::now() - t0);
+	}
+
+	uint64_t elapsed = TickStats::now() - startTime;
+	uint64_t cpu = processCpuTicks(pid) - startCpu;
+
+	// Terminate gzuavchannel; subscribers exit when their connections close
+	kill(pid, SIGTERM);
+	waitpid(pid, nullptr, 0);
+	for (std::thread &t : subscribers)
+		t.join();
+
+	for (int fd : upstreamFds)
+		close(fd);
+	close(downstreamFd);
+	fclose(status);
+	unlink(udsPath.c_str());
+	rmdir(tmpdir);
+
+	Result res;
+	res.ticksPerSecond = cfg.ticks / (elapsed / 1e9);
+	res.p50 = hist.percentile(50);
+	res.p99 = hist.percentile(99);
+	res.cpuPercent = 100.0 * cpu / sysconf(_SC_CLK_TCK) / (elapsed / 1e9);
+	return res;
+}
+
+int main(int argc, char *argv[])
+{
+	Config cfg;
+	cfg.gzuavchannelPath = GZUAVCHANNEL_PATH;
+	cfg.ticks = 10000;
+	cfg.warmup = 1000;
+	cfg.phase0 = 0;
+	cfg.phase1 = 0;
+	int maxUavs = 64;
+
+	while (true)
+	{
+		int c, option_index = 0;
+		c = getopt_long(argc, argv, "h", long_options, &option_index);
+
+		if (c == -1) // end of options
+			break;
+
+		switch (c)
+		{
+			case '?':
+			case ':':
+				// getopt() has already printed an error message
+				exit(EXIT_FAILURE);
+			case 'h':
+				showHelp();
+				break;
+			case OPT_GZUAVCHANNEL:
+				cfg.gzuavchannelPath = optarg;
+				break;
+			case OPT_MAX_UAVS:
+				maxUavs = parseCount(optarg, long_options[option_index].name, 1);
+				break;
+			case OPT_TICKS:
+				cfg.ticks = parseCount(optarg, long_options[option_index].name, 1);
+				break;
+			case OPT_WARMUP:
+				cfg.warmup = parseCount(optarg, long_options[option_index].name, 0);
+				break;
+			case OPT_PHASE0:
+				cfg.phase0 = parseCount(optarg, long_options[option_index].name, 0);
+				break;
+			case OPT_PHASE1:
+				cfg.phase1 = parseCount(optarg, long_options[option_index].name, 0);
+				break;
+		}
+	}
+
+	for (int i = optind; i < argc; i++)
+		cfg.extraArgs.push_back(argv[i]);
+
+	// Subscribers are only accepted between ticks
+	if ((cfg.phase0 != 0 || cfg.phase1 != 0) && cfg.warmup == 0)
+		warnx("some ExternalSyncServer subscribers might miss the first measured ticks (--warmup is 0)");
+
+	printf("%6s %6s %6s %12s %10s %10s %8s\n", "uavs", "phase0", "phase1", "ticks/s", "p50_us", "p99_us", "cpu_%");
+
+	std::vector<int> uavCounts;
+	for (int n = 1; n < maxUavs; n *= 2)
+		uavCounts.push_back(n);
+	uavCounts.push_back(maxUavs);
+
+	for (int n : uavCounts)
+	{
+		Result res = runBenchmark(cfg, n);
+		printf("%6d %6d %6d %12.1f %10.1f %10.1f %8.1f\n", n, cfg.phase0, cfg.phase1,
+			res.ticksPerSecond, res.p50 / 1e3, res.p99 / 1e3, res.cpuPercent);
+		fflush(stdout);
+	}
+
+	return EXIT_SUCCESS;
+}
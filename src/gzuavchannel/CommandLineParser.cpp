@@ -6,12 +6,20 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include <algorithm>
+#include <map>
+
 enum
 {
 	OPT_DOWNSTREAM = 256,
 	OPT_UPSTREAM,
 	OPT_INVERT_ORDER,
 	OPT_EXTERNAL_SYNC_SERVER,
+	OPT_STATS_OUTPUT,
+	OPT_STATS_INTERVAL,
+	OPT_STATS_STRAGGLERS,
+	OPT_RECORD_TRACE,
+	OPT_DECIMATION,
 };
 
 static option long_options[] =
@@ -21,6 +29,11 @@ static option long_options[] =
 	{ "upstream", required_argument, nullptr, OPT_UPSTREAM },
 	{ "invert-order", no_argument, nullptr, OPT_INVERT_ORDER },
 	{ "external-sync-server", required_argument, nullptr, OPT_EXTERNAL_SYNC_SERVER },
+	{ "stats-output", required_argument, nullptr, OPT_STATS_OUTPUT },
+	{ "stats-interval", required_argument, nullptr, OPT_STATS_INTERVAL },
+	{ "stats-stragglers", required_argument, nullptr, OPT_STATS_STRAGGLERS },
+	{ "record-trace", required_argument, nullptr, OPT_RECORD_TRACE },
+	{ "decimation", required_argument, nullptr, OPT_DECIMATION },
 	{ nullptr, 0, nullptr, 0 }
 };
 
@@ -37,6 +50,11 @@ static void showHelp()
 	fprintf(stderr, " - uds:/path/to/socket\n");
 	fprintf(stderr, "   Wait for one SEQPACKET connection from each UAV on the specified Unix Domain\n");
 	fprintf(stderr, "   socket path. The first received packet must contain the uav_name.\n");
+	fprintf(stderr, "   UAVs can connect from different processes (e.g. one gzserver for each\n");
+	fprintf(stderr, "   physics partition), whose simulation times must stay equal.\n");
+	fprintf(stderr, " - replay:/path/to/trace (upstream only)\n");
+	fprintf(stderr, "   Replay the upstream packets of a trace recorded with --record-trace, as\n");
+	fprintf(stderr, "   fast as they are consumed, instead of connecting to the simulator.\n");
 	fprintf(stderr, "\n");
 	fprintf(stderr, "\"uav_names...\" is a comma-separated list of UAV names:\n");
 	fprintf(stderr, "   If a name does not contain a colon, the same name is used on both sides.\n");
@@ -47,6 +65,23 @@ static void showHelp()
 	fprintf(stderr, "Other options:\n");
 	fprintf(stderr, " --invert-order: Normally, the upstream transport is initialized first. This\n");
 	fprintf(stderr, "                 option makes the downstream transport be initialized first.\n");
+	fprintf(stderr, " --stats-output PATH: Record per-tick timing histograms and dump them as JSON\n");
+	fprintf(stderr, "                      to PATH periodically and whenever SIGUSR1 is received.\n");
+	fprintf(stderr, " --stats-interval SECONDS: Interval between periodic dumps (default: 10, 0\n");
+	fprintf(stderr, "                           disables periodic dumps).\n");
+	fprintf(stderr, " --stats-stragglers K: Number of UAVs with the highest average lateness to be\n");
+	fprintf(stderr, "                       listed in the stats dump (default: 5). Lateness is\n");
+	fprintf(stderr, "                       only meaningful per UAV with a uds downstream transport\n");
+	fprintf(stderr, "                       (i.e. in gzuavcluster, see its --stats option): a tcp\n");
+	fprintf(stderr, "                       downstream delivers all the END-TICK packets of a\n");
+	fprintf(stderr, "                       cluster at once.\n");
+	fprintf(stderr, " --record-trace PATH: Record all forwarded packets to a binary trace (PATH) and\n");
+	fprintf(stderr, "                      its per-tick index (PATH.idx).\n");
+	fprintf(stderr, " --decimation NAME=K: Only exchange packets with the downstream peer of the\n");
+	fprintf(stderr, "                      UAV named NAME (upstream name) every K simulation steps.\n");
+	fprintf(stderr, "                      Its last END-TICK packet is repeated upstream in the\n");
+	fprintf(stderr, "                      other steps. Can be specified multiple times. Requires\n");
+	fprintf(stderr, "                      a uds downstream transport.\n");
 	fprintf(stderr, "\n");
 
 	exit(EXIT_FAILURE);
@@ -58,7 +93,12 @@ CommandLineParser::CommandLineParser(int argc, char *argv[])
 	upstreamSpec = nullptr;
 	invertInitializationOrder = false;
 	externalSyncServerPort = 0;
+	statsOutputPath = nullptr;
+	statsInterval = 10;
+	statsTopStragglers = 5;
+	traceOutputPath = nullptr;
 
+	std::map<std::string, unsigned> decimationByName;
 	bool help_requested = false;
 
 	while (true)
@@ -100,6 +140,42 @@ CommandLineParser::CommandLineParser(int argc, char *argv[])
 				if (externalSyncServerPort == 0)
 					errx(EXIT_FAILURE, "option '%s' has invalid format", long_options[option_index].name);
 				break;
+			case OPT_STATS_OUTPUT:
+				if (statsOutputPath != nullptr)
+					errx(EXIT_FAILURE, "option '%s' cannot be specified more than once", long_options[option_index].name);
+				statsOutputPath = optarg;
+				break;
+			case OPT_STATS_INTERVAL:
+			{
+				char *endp;
+				statsInterval = strtod(optarg, &endp);
+				if (*optarg == '\0' || *endp != '\0' || statsInterval < 0)
+					errx(EXIT_FAILURE, "option '%s' has invalid format", long_options[option_index].name);
+				break;
+			}
+			case OPT_STATS_STRAGGLERS:
+				if (atoi(optarg) < 0)
+					errx(EXIT_FAILURE, "option '%s' has invalid format", long_options[option_index].name);
+				statsTopStragglers = atoi(optarg);
+				break;
+			case OPT_RECORD_TRACE:
+				if (traceOutputPath != nullptr)
+					errx(EXIT_FAILURE, "option '%s' cannot be specified more than once", long_options[option_index].name);
+				traceOutputPath = optarg;
+				break;
+			case OPT_DECIMATION:
+			{
+				char *eq = strrchr(optarg, '=');
+				char *endp;
+				long k = (eq == nullptr) ? 0 : strtol(eq + 1, &endp, 10);
+				if (eq == nullptr || eq == optarg || eq[1] == '\0' || *endp != '\0' || k < 1 || k > 65535)
+					errx(EXIT_FAILURE, "option '%s' has invalid format", long_options[option_index].name);
+
+				std::string name(optarg, eq - optarg);
+				if (!decimationByName.emplace(name, k).second)
+					errx(EXIT_FAILURE, "option '%s' cannot be specified more than once for %s", long_options[option_index].name, name.c_str());
+				break;
+			}
 		}
 	}
 
@@ -112,6 +188,11 @@ CommandLineParser::CommandLineParser(int argc, char *argv[])
 	if (upstreamSpec == nullptr)
 		errx(EXIT_FAILURE, "option 'upstream' is required");
 
+	// Checked by makeTransport too, but only after the upstream side (which
+	// may block waiting for connections) has been set up
+	if (strncasecmp(downstreamSpec, "replay:", 7) == 0)
+		errx(EXIT_FAILURE, "Transport type replay can only be used upstream: %s", downstreamSpec);
+
 	if (optind == argc)
 		errx(EXIT_FAILURE, "at least one UAV name is required");
 
@@ -135,4 +216,16 @@ CommandLineParser::CommandLineParser(int argc, char *argv[])
 	}
 
 	uavCount = upstreamUavNames.size();
+
+	decimation.assign(uavCount, 1);
+	for (const std::pair<const std::string, unsigned> &it : decimationByName)
+	{
+		size_t idx = std::find(upstreamUavNames.begin(), upstreamUavNames.end(), it.first) - upstreamUavNames.begin();
+		if (idx == uavCount)
+			errx(EXIT_FAILURE, "option 'decimation' refers to unknown UAV name: %s", it.first.c_str());
+		decimation[idx] = it.second;
+	}
+
+	if (decimationByName.size() != 0 && strncasecmp(downstreamSpec, "uds:", 4) != 0)
+		errx(EXIT_FAILURE, "option 'decimation' requires a uds downstream transport");
 }
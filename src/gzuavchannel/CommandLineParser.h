@@ -14,9 +14,19 @@ struct CommandLineParser
 
 	int externalSyncServerPort; // 0 = no server
 
+	const char *statsOutputPath; // nullptr = no stats
+	double statsInterval; // seconds, 0 = only on SIGUSR1
+	size_t statsTopStragglers;
+
+	const char *traceOutputPath; // nullptr = no trace
+
 	size_t uavCount;
 	std::vector<std::string> upstreamUavNames;
 	std::vector<std::string> downstreamUavNames;
+
+	// Per-UAV number of simulation steps between exchanges with the
+	// downstream peer (1 = every step)
+	std::vector<unsigned> decimation;
 };
 
 #endif // COMMANDLINEPARSER_H
@@ -0,0 +1,198 @@
+#include "ReplayTransport.h"
+#include "TraceFormat.h"
+
+#include <err.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+
+static const uint8_t *mapFile(const std::string &path, size_t *size)
+{
+	int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+	if (fd < 0)
+		err(EXIT_FAILURE, "Replay: cannot open %s", path.c_str());
+
+	struct stat st;
+	if (fstat(fd, &st) != 0)
+		err(EXIT_FAILURE, "Replay: cannot stat %s", path.c_str());
+
+	if ((size_t)st.st_size < sizeof(TraceFileHeader))
+		errx(EXIT_FAILURE, "Replay: %s is truncated", path.c_str());
+
+	void *ptr = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	if (ptr == MAP_FAILED)
+		err(EXIT_FAILURE, "Replay: cannot mmap %s", path.c_str());
+
+	// Ticks are read sequentially
+	madvise(ptr, st.st_size, MADV_SEQUENTIAL);
+
+	close(fd);
+	*size = st.st_size;
+	return (const uint8_t*)ptr;
+}
+
+static void checkHeader(const std::string &path, const uint8_t *base, const char *magic)
+{
+	const TraceFileHeader *h = (const TraceFileHeader*)base;
+
+	if (memcmp(h->magic, magic, sizeof(h->magic)) != 0)
+		errx(EXIT_FAILURE, "Replay: %s is not a gzuavchannel trace file", path.c_str());
+
+	if (h->version != TRACE_VERSION)
+		errx(EXIT_FAILURE, "Replay: %s has unsupported version %u", path.c_str(), h->version);
+}
+
+ReplayTransport::ReplayTransport(const std::string &path, const std::vector<std::string> &uavNames)
+: m_nextPendingRecord(0)
+{
+	m_data = mapFile(path, &m_dataSize);
+	m_index = mapFile(path + ".idx", &m_indexSize);
+
+	checkHeader(path, m_data, TRACE_DATA_MAGIC);
+	checkHeader(path + ".idx", m_index, TRACE_INDEX_MAGIC);
+
+	// Map UAV names in the trace to our UAV numbers
+	const TraceFileHeader *fh = (const TraceFileHeader*)m_data;
+	if (fh->uavCount != uavNames.size())
+		errx(EXIT_FAILURE, "Replay: trace contains %u UAVs, but %zu were given", fh->uavCount, uavNames.size());
+
+	size_t pos = sizeof(TraceFileHeader);
+	for (uint32_t i = 0; i < fh->uavCount; i++)
+	{
+		uint16_t name_len;
+		if (pos + sizeof(name_len) > m_dataSize)
+			errx(EXIT_FAILURE, "Replay: trace header is truncated");
+		memcpy(&name_len, m_data + pos, sizeof(name_len));
+		pos += sizeof(name_len);
+
+		if (pos + name_len > m_dataSize)
+			errx(EXIT_FAILURE, "Replay: trace header is truncated");
+		std::string name((const char*)m_data + pos, name_len);
+		pos += name_len;
+
+		std::vector<std::string>::const_iterator it = std::find(uavNames.begin(), uavNames.end(), name);
+		if (it == uavNames.end())
+			errx(EXIT_FAILURE, "Replay: trace contains unexpected UAV name: %s", name.c_str());
+
+		int idx = it - uavNames.begin();
+		warnx("Replay: UAV #%d is %s (#%u in trace)", idx, name.c_str(), i);
+		m_trace2local.push_back(idx);
+	}
+
+	m_lastRecord.resize(fh->uavCount, nullptr);
+	m_fillerRecord.resize(fh->uavCount);
+
+	m_nextEntry = (const TraceIndexEntry*)(m_index + sizeof(TraceFileHeader));
+	m_endEntry = m_nextEntry + (m_indexSize - sizeof(TraceFileHeader)) / sizeof(TraceIndexEntry);
+	warnx("Replay: trace contains %zu ticks", (size_t)(m_endEntry - m_nextEntry));
+
+	// An eventfd with a non-zero counter (that is never read) is always
+	// readable: we never have to wait for anything
+	m_eventFd = eventfd(1, EFD_CLOEXEC);
+	if (m_eventFd < 0)
+		err(EXIT_FAILURE, "Replay: eventfd failed");
+}
+
+ReplayTransport::~ReplayTransport()
+{
+	close(m_eventFd);
+	munmap(const_cast<uint8_t*>(m_data), m_dataSize);
+	munmap(const_cast<uint8_t*>(m_index), m_indexSize);
+}
+
+int ReplayTransport::fd() const
+{
+	return m_eventFd;
+}
+
+void ReplayTransport::loadTick()
+{
+	m_pendingRecords.clear();
+	m_nextPendingRecord = 0;
+
+	while (m_pendingRecords.empty())
+	{
+		if (m_nextEntry == m_endEntry)
+		{
+			warnx("Replay: end of trace reached");
+			exit(EXIT_SUCCESS);
+		}
+
+		const TraceIndexEntry *e = m_nextEntry++;
+
+		if (e->droppedCount != 0)
+			errx(EXIT_FAILURE, "Replay: tick %llu is incomplete (%u records were dropped while recording)",
+				(unsigned long long)e->tick, e->droppedCount);
+
+		// Collect this tick's upstream records
+		std::vector<bool> recorded(m_lastRecord.size(), false);
+		size_t pos = e->offset;
+		for (uint32_t i = 0; i < e->recordCount; i++)
+		{
+			if (pos + sizeof(TraceRecordHeader) > m_dataSize)
+				errx(EXIT_FAILURE, "Replay: trace is truncated");
+
+			const TraceRecordHeader *rh = (const TraceRecordHeader*)(m_data + pos);
+			if (rh->tick != e->tick || rh->uavNum >= m_trace2local.size()
+				|| pos + sizeof(TraceRecordHeader) + rh->length > m_dataSize)
+			{
+				errx(EXIT_FAILURE, "Replay: corrupted record in tick %llu", (unsigned long long)e->tick);
+			}
+
+			if (rh->direction == TRACE_FROM_UPSTREAM)
+			{
+				if (rh->length < sizeof(double))
+					errx(EXIT_FAILURE, "Replay: corrupted record in tick %llu", (unsigned long long)e->tick);
+
+				m_pendingRecords.push_back(rh);
+				m_lastRecord[rh->uavNum] = rh;
+				recorded[rh->uavNum] = true;
+			}
+
+			pos += sizeof(TraceRecordHeader) + TRACE_ALIGN(rh->length);
+		}
+
+		// Stand in for the BEGIN-TICK packets that were not forwarded
+		for (size_t i = 0; i < m_lastRecord.size(); i++)
+		{
+			if (recorded[i] || m_lastRecord[i] == nullptr)
+				continue;
+
+			const TraceRecordHeader *last = m_lastRecord[i];
+			std::vector<uint8_t> &filler = m_fillerRecord[i];
+			filler.assign((const uint8_t*)last, (const uint8_t*)(last + 1) + last->length);
+
+			// BEGIN-TICK payloads start with the timestamp
+			memcpy(filler.data() + sizeof(TraceRecordHeader), &e->timestamp, sizeof(double));
+			m_pendingRecords.push_back((const TraceRecordHeader*)filler.data());
+		}
+	}
+}
+
+void ReplayTransport::runOnce()
+{
+	if (m_nextPendingRecord == m_pendingRecords.size())
+		loadTick();
+
+	const TraceRecordHeader *rh = m_pendingRecords[m_nextPendingRecord++];
+
+	if (m_recvHandler)
+		m_recvHandler(m_trace2local[rh->uavNum], rh + 1, rh->length);
+}
+
+void ReplayTransport::setReceivedPacketHandler(const std::function<void(int uav_num, const void *data, size_t len)> &cb)
+{
+	m_recvHandler = cb;
+}
+
+void ReplayTransport::sendPacket(int /*uav_num*/, const void * /*data*/, size_t /*len*/)
+{
+	// Recorded upstream packets do not depend on what is sent back
+}
@@ -0,0 +1,63 @@
+#ifndef REPLAYTRANSPORT_H
+#define REPLAYTRANSPORT_H
+
+#include "Transport.h"
+
+#include <string>
+#include <vector>
+
+struct TraceIndexEntry;
+struct TraceRecordHeader;
+
+/* Transport that replays the upstream packets of a recorded tick trace (see
+ * TraceFormat.h), in place of Gazebo.
+ *
+ * Packets are delivered as fast as the other side of gzuavchannel consumes
+ * them. Packets sent to this transport are discarded. When the end of the
+ * trace is reached, the process terminates.
+ *
+ * Only forwarded packets are recorded: in ticks where a decimated UAV's
+ * BEGIN-TICK was not forwarded, its last recorded one is delivered again
+ * (with the tick's timestamp), so that the trace can be replayed with the
+ * same --decimation options it was recorded with.
+ */
+class ReplayTransport : public Transport
+{
+	public:
+		ReplayTransport(const std::string &path, const std::vector<std::string> &uavNames);
+		~ReplayTransport() override;
+
+		int fd() const override;
+		void runOnce() override;
+
+		void setReceivedPacketHandler(const std::function<void(int uav_num, const void *data, size_t len)> &cb) override;
+		void sendPacket(int uav_num, const void *data, size_t len) override;
+
+	private:
+		void loadTick();
+
+		std::function<void(int uav_num, const void *data, size_t len)> m_recvHandler;
+
+		// Memory-mapped trace files
+		const uint8_t *m_data, *m_index;
+		size_t m_dataSize, m_indexSize;
+
+		// Mapping from the UAV numbers in the trace to ours
+		std::vector<int> m_trace2local;
+
+		// Always-readable eventfd, returned by fd()
+		int m_eventFd;
+
+		// Current position in the index, and upstream records of the current
+		// tick that are still to be delivered
+		const TraceIndexEntry *m_nextEntry, *m_endEntry;
+		std::vector<const TraceRecordHeader*> m_pendingRecords;
+		size_t m_nextPendingRecord;
+
+		// Last upstream record of each UAV (by trace UAV number), and
+		// the copies that stand in for the unrecorded ones
+		std::vector<const TraceRecordHeader*> m_lastRecord;
+		std::vector<std::vector<uint8_t>> m_fillerRecord;
+};
+
+#endif // REPLAYTRANSPORT_H
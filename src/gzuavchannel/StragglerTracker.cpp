@@ -0,0 +1,77 @@
+#include "StragglerTracker.h"
+
+#include "IO/JsonString.h"
+
+#include <algorithm>
+
+// Weight of the newest sample in the moving average
+#define EWMA_ALPHA 0.05
+
+StragglerTracker::StragglerTracker(const std::vector<std::string> &uavNames)
+: m_names(uavNames), m_stats(uavNames.size(), UavStats { 0, 0, 0, 0 })
+{
+	m_arrivals.reserve(uavNames.size());
+}
+
+void StragglerTracker::recordArrival(int uav_num, uint64_t offset)
+{
+	m_arrivals.emplace_back(uav_num, offset);
+}
+
+void StragglerTracker::endTick()
+{
+	if (m_arrivals.empty())
+		return;
+
+	uint64_t first = m_arrivals[0].second, last = m_arrivals[0].second;
+	int lastUavNum = m_arrivals[0].first;
+	for (const std::pair<int, uint64_t> &a : m_arrivals)
+	{
+		first = std::min(first, a.second);
+		if (a.second >= last)
+		{
+			last = a.second;
+			lastUavNum = a.first;
+		}
+	}
+
+	for (const std::pair<int, uint64_t> &a : m_arrivals)
+	{
+		UavStats &s = m_stats.at(a.first);
+		uint64_t lateness = a.second - first;
+
+		if (s.samples++ == 0)
+			s.avgLateness = lateness;
+		else
+			s.avgLateness += EWMA_ALPHA * (lateness - s.avgLateness);
+
+		s.maxLateness = std::max(s.maxLateness, lateness);
+	}
+
+	m_stats[lastUavNum].lastCount++;
+	m_arrivals.clear();
+}
+
+void StragglerTracker::writeJson(FILE *fp, size_t topK) const
+{
+	std::vector<int> order(m_stats.size());
+	for (size_t i = 0; i < order.size(); i++)
+		order[i] = i;
+
+	topK = std::min(topK, order.size());
+	std::partial_sort(order.begin(), order.begin() + topK, order.end(), [this](int a, int b)
+	{
+		return m_stats[a].avgLateness > m_stats[b].avgLateness;
+	});
+
+	fprintf(fp, "[");
+	for (size_t i = 0; i < topK; i++)
+	{
+		const UavStats &s = m_stats[order[i]];
+		fprintf(fp, "%s\n    { \"uav\": %d, \"name\": ", i == 0 ? "" : ",", order[i]);
+		IO::writeJsonString(fp, m_names[order[i]]);
+		fprintf(fp, ", \"avg_lateness_ns\": %.0f, \"max_lateness_ns\": %llu, \"last_count\": %llu }",
+			s.avgLateness, (unsigned long long)s.maxLateness, (unsigned long long)s.lastCount);
+	}
+	fprintf(fp, "%s]", topK == 0 ? "" : "\n  ");
+}
@@ -0,0 +1,45 @@
+#ifndef STRAGGLERTRACKER_H
+#define STRAGGLERTRACKER_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+/* Keeps rolling per-UAV statistics about how late each UAV's packet arrives
+ * within a tick.
+ *
+ * A UAV's lateness in a given tick is the time between the arrival of the
+ * first packet of that tick (from any UAV) and the arrival of its own packet.
+ * Lateness is smoothed with an exponentially-weighted moving average, so that
+ * UAVs that are consistently slow stand out from occasional outliers.
+ */
+class StragglerTracker
+{
+	public:
+		StragglerTracker(const std::vector<std::string> &uavNames);
+
+		// offset is the arrival time relative to an arbitrary per-tick origin
+		void recordArrival(int uav_num, uint64_t offset);
+		void endTick();
+
+		// Write a JSON array with the topK UAVs, sorted by average lateness
+		void writeJson(FILE *fp, size_t topK) const;
+
+	private:
+		struct UavStats
+		{
+			double avgLateness; // EWMA, in nanoseconds
+			uint64_t maxLateness;
+			uint64_t lastCount; // number of ticks in which this UAV was the last one
+			uint64_t samples;
+		};
+
+		std::vector<std::string> m_names;
+		std::vector<UavStats> m_stats;
+
+		// arrivals in the current tick
+		std::vector<std::pair<int, uint64_t>> m_arrivals;
+};
+
+#endif // STRAGGLERTRACKER_H
@@ -1,7 +1,10 @@
 #include "TCPTransport.h"
 
+#include "GzUav/Protocol.h"
+
 #include <arpa/inet.h>
 #include <err.h>
+#include <errno.h>
 #include <netinet/in.h>
 #include <netinet/tcp.h>
 #include <stdio.h>
@@ -53,7 +56,45 @@ static void send16(int fd, uint16_t val, bool haveMoreToSend = false)
 	sendAll(fd, &tmp, 2, haveMoreToSend);
 }
 
-TCPTransport::TCPTransport(int listenPort, const std::vector<std::string> &globalUavNames)
+static uint32_t recv32(int fd)
+{
+	uint32_t tmp;
+	recvAll(fd, &tmp, 4);
+	return ntohl(tmp);
+}
+
+static void send32(int fd, uint32_t val, bool haveMoreToSend = false)
+{
+	uint32_t tmp = htonl(val);
+	sendAll(fd, &tmp, 4, haveMoreToSend);
+}
+
+static void sendHello(int fd, uint32_t caps, bool haveMoreToSend)
+{
+	send32(fd, GzUavProtocol::TCP_MAGIC, true);
+	send16(fd, GzUavProtocol::VERSION, true);
+	send16(fd, 0, true);
+	send32(fd, caps, haveMoreToSend);
+}
+
+// Returns the capabilities advertised by the peer
+static uint32_t recvHello(int fd)
+{
+	uint32_t magic = recv32(fd);
+	uint16_t version = recv16(fd);
+	recv16(fd); // reserved
+	uint32_t caps = recv32(fd);
+
+	if (magic != GzUavProtocol::TCP_MAGIC)
+		errx(EXIT_FAILURE, "TCP: peer is not a gzuavchannel instance or is too old");
+
+	if (version != GzUavProtocol::VERSION)
+		errx(EXIT_FAILURE, "TCP: peer uses unsupported protocol version %d", version);
+
+	return caps;
+}
+
+TCPTransport::TCPTransport(int listenPort, const std::vector<std::string> &globalUavNames, GzUavProtocol::PeerRole peerRole)
 {
 	if (!isValidPort(listenPort))
 		errx(EXIT_FAILURE, "TCP: port number has invalid format or value");
@@ -83,6 +124,10 @@ TCPTransport::TCPTransport(int listenPort, const std::vector<std::string> &globa
 	{
 		int client_fd = accept(serv_fd, nullptr, nullptr);
 
+		// Negotiate capabilities
+		uint32_t caps = recvHello(client_fd) & GzUavProtocol::SUPPORTED_CAPS;
+		sendHello(client_fd, caps, false);
+
 		// Receive UAV list
 		std::vector<std::string> localUavNames;
 		std::vector<int> local2global;
@@ -105,7 +150,7 @@ TCPTransport::TCPTransport(int listenPort, const std::vector<std::string> &globa
 		}
 
 		// Create TCPConnection
-		TCPConnection *c = new TCPConnection(client_fd, local2global);
+		TCPConnection *c = new TCPConnection(client_fd, local2global, peerRole, caps);
 		m_connections.push_back(c);
 		m_pollGrp.add(c);
 
@@ -117,7 +162,7 @@ TCPTransport::TCPTransport(int listenPort, const std::vector<std::string> &globa
 	close(serv_fd);
 }
 
-TCPTransport::TCPTransport(const char *connectTarget, const std::vector<std::string> &globalUavNames)
+TCPTransport::TCPTransport(const char *connectTarget, const std::vector<std::string> &globalUavNames, GzUavProtocol::PeerRole peerRole)
 {
 	struct sockaddr_in addr;
 	memset(&addr, 0, sizeof(addr));
@@ -140,6 +185,7 @@ TCPTransport::TCPTransport(const char *connectTarget, const std::vector<std::str
 
 	std::vector<int> local2global;
 
+	sendHello(fd, GzUavProtocol::SUPPORTED_CAPS, true);
 	send16(fd, globalUavNames.size());
 	for (size_t i = 0; i < globalUavNames.size(); i++)
 	{
@@ -148,8 +194,13 @@ TCPTransport::TCPTransport(const char *connectTarget, const std::vector<std::str
 		local2global.push_back((int)i);
 	}
 
+	// The server replies with the capabilities that it has enabled
+	uint32_t caps = recvHello(fd);
+	if ((caps & ~GzUavProtocol::SUPPORTED_CAPS) != 0)
+		errx(EXIT_FAILURE, "TCP: peer enabled unsupported capabilities 0x%x", caps);
+
 	// Create TCPConnection
-	TCPConnection *c = new TCPConnection(fd, local2global);
+	TCPConnection *c = new TCPConnection(fd, local2global, peerRole, caps);
 	m_connections.push_back(c);
 	m_pollGrp.add(c);
 
@@ -184,8 +235,9 @@ void TCPTransport::sendPacket(int uav_num, const void *data, size_t len)
 	m_global2conn.at(uav_num)->sendPacket(uav_num, data, len);
 }
 
-TCPTransport::TCPConnection::TCPConnection(int fd, const std::vector<int> &local2global)
-: m_fd(fd), m_local2global(local2global), m_pendingMessagesCountdown(local2global.size())
+TCPTransport::TCPConnection::TCPConnection(int fd, const std::vector<int> &local2global, GzUavProtocol::PeerRole peerRole, uint32_t caps)
+: m_fd(fd), m_peerRole(peerRole), m_caps(caps), m_local2global(local2global),
+  m_recvBufferLen(0), m_pendingMessagesCountdown(local2global.size())
 {
 	// Create reverse mapping
 	for (size_t i = 0; i < m_local2global.size(); i++)
@@ -211,14 +263,59 @@ int TCPTransport::TCPConnection::fd() const
 
 void TCPTransport::TCPConnection::runOnce()
 {
-	uint16_t uav_id = m_local2global.at(recv16(m_fd));
-	uint16_t len = recv16(m_fd);
+	// Make room for at least one more message of maximum size
+	const size_t maxMessageSize = 4 + UINT16_MAX;
+	if (m_recvBuffer.size() - m_recvBufferLen < maxMessageSize)
+		m_recvBuffer.resize(m_recvBufferLen + maxMessageSize);
+
+	int r = recv(m_fd, m_recvBuffer.data() + m_recvBufferLen, m_recvBuffer.size() - m_recvBufferLen, MSG_DONTWAIT);
+	if (r < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+		return;
+	else if (r <= 0)
+		err(EXIT_FAILURE, "TCP: stream ended unexpectedly");
+
+	m_recvBufferLen += r;
 
-	uint8_t buf[len];
-	recvAll(m_fd, buf, len);
+	// Deliver all complete messages: uav_id (16 bits), length (16 bits)
+	// and payload
+	size_t pos = 0;
+	while (m_recvBufferLen - pos >= 4)
+	{
+		const uint8_t *msg = m_recvBuffer.data() + pos;
+		uint16_t local_id = (msg[0] << 8) | msg[1];
+		uint16_t len = (msg[2] << 8) | msg[3];
+
+		if (m_recvBufferLen - pos < 4 + (size_t)len)
+			break;
+
+		deliverPacket(m_local2global.at(local_id), msg + 4, len);
+		pos += 4 + len;
+	}
+
+	// Keep the incomplete tail, if any
+	memmove(m_recvBuffer.data(), m_recvBuffer.data() + pos, m_recvBufferLen - pos);
+	m_recvBufferLen -= pos;
+}
+
+void TCPTransport::TCPConnection::deliverPacket(int uav_num, const uint8_t *data, size_t len)
+{
+	if (m_peerRole == GzUavProtocol::ROLE_SIMULATOR && (m_caps & GzUavProtocol::CAP_COMPACT_BEGIN_TICK))
+	{
+		GzUavProtocol::CompactBeginTick compact;
+		if (len != sizeof(compact))
+			errx(EXIT_FAILURE, "TCP: received compact BEGIN-TICK packet of unexpected size %zu", len);
+
+		GzUavProtocol::BeginTick full;
+		memcpy(&compact, data, sizeof(compact));
+		GzUavProtocol::expandBeginTick(compact, &full);
+
+		if (m_recvHandler)
+			m_recvHandler(uav_num, &full, sizeof(full));
+		return;
+	}
 
 	if (m_recvHandler)
-		m_recvHandler(uav_id, buf, len);
+		m_recvHandler(uav_num, data, len);
 }
 
 void TCPTransport::TCPConnection::setReceivedPacketHandler(const std::function<void(int uav_num, const void *data, size_t len)> &cb)
@@ -228,6 +325,19 @@ void TCPTransport::TCPConnection::setReceivedPacketHandler(const std::function<v
 
 void TCPTransport::TCPConnection::sendPacket(int uav_num, const void *data, size_t len)
 {
+	GzUavProtocol::CompactBeginTick compact;
+	if (m_peerRole == GzUavProtocol::ROLE_AUTOPILOT && (m_caps & GzUavProtocol::CAP_COMPACT_BEGIN_TICK))
+	{
+		GzUavProtocol::BeginTick full;
+		if (len != sizeof(full))
+			errx(EXIT_FAILURE, "TCP: cannot compact BEGIN-TICK packet of unexpected size %zu", len);
+
+		memcpy(&full, data, sizeof(full));
+		GzUavProtocol::compactBeginTick(full, &compact);
+		data = &compact;
+		len = sizeof(compact);
+	}
+
 	send16(m_fd, m_global2local.at(uav_num), true);
 	send16(m_fd, len, true);
 
@@ -3,6 +3,8 @@
 
 #include "Transport.h"
 
+#include "GzUav/Protocol.h"
+
 #include <map>
 #include <string>
 #include <vector>
@@ -10,11 +12,14 @@
 class TCPTransport : public Transport
 {
 	public:
+		// peerRole is the role that the remote gzuavchannel instance plays
+		// towards us, i.e. whether it sends BEGIN-TICK or END-TICK packets
+
 		// server mode
-		TCPTransport(int listenPort, const std::vector<std::string> &uavNames);
+		TCPTransport(int listenPort, const std::vector<std::string> &uavNames, GzUavProtocol::PeerRole peerRole);
 
 		// client mode
-		TCPTransport(const char *connectTarget, const std::vector<std::string> &uavNames);
+		TCPTransport(const char *connectTarget, const std::vector<std::string> &uavNames, GzUavProtocol::PeerRole peerRole);
 
 		~TCPTransport() override;
 
@@ -28,7 +33,7 @@ class TCPTransport : public Transport
 		class TCPConnection : public IO::Pollable
 		{
 			public:
-				TCPConnection(int fd, const std::vector<int> &local2global);
+				TCPConnection(int fd, const std::vector<int> &local2global, GzUavProtocol::PeerRole peerRole, uint32_t caps);
 				~TCPConnection() override;
 
 				int fd() const override;
@@ -38,13 +43,23 @@ class TCPTransport : public Transport
 				void sendPacket(int uav_num, const void *data, size_t len);
 
 			private:
+				void deliverPacket(int uav_num, const uint8_t *data, size_t len);
+
 				int m_fd;
+				GzUavProtocol::PeerRole m_peerRole;
+				uint32_t m_caps; // GzUavProtocol::Capability flags negotiated with the peer
 				std::function<void(int uav_num, const void *data, size_t len)> m_recvHandler;
 
 				// UAV ID mapping
 				std::vector<int> m_local2global;
 				std::map<int, int> m_global2local;
 
+				// Received bytes that do not form a complete message yet. All
+				// the available data is read at once, and all the complete
+				// messages it contains are then delivered together
+				std::vector<uint8_t> m_recvBuffer;
+				size_t m_recvBufferLen;
+
 				// Number of messages to wait for before sending a TCP packet (we
 				// assume that all UAVs' packets are sent at the same time in both
 				// directions -- as is always the case with this framework)
@@ -0,0 +1,233 @@
+#include "TickStats.h"
+
+#include <err.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <algorithm>
+
+// Set by the SIGUSR1 handler, consumed by TickStats::recordTick
+static volatile sig_atomic_t g_dumpRequested = 0;
+
+static void sigusr1Handler(int)
+{
+	g_dumpRequested = 1;
+}
+
+LatencyHistogram::LatencyHistogram()
+: m_count(0), m_sum(0), m_min(UINT64_MAX), m_max(0)
+{
+	for (unsigned i = 0; i < NUM_BUCKETS; i++)
+		m_buckets[i].store(0, std::memory_order_relaxed);
+}
+
+unsigned LatencyHistogram::bucketIndex(uint64_t ns)
+{
+	if (ns < SUB_BUCKETS)
+		return ns;
+
+	unsigned msb = 63 - __builtin_clzll(ns);
+	unsigned shift = msb - SUB_BUCKET_BITS;
+	unsigned sub = (ns >> shift) & (SUB_BUCKETS - 1);
+
+	return (shift + 1) * SUB_BUCKETS + sub;
+}
+
+uint64_t LatencyHistogram::bucketUpperBound(unsigned idx)
+{
+	if (idx < SUB_BUCKETS)
+		return idx;
+
+	unsigned shift = idx / SUB_BUCKETS - 1;
+	uint64_t sub = idx % SUB_BUCKETS;
+	uint64_t lower = (SUB_BUCKETS + sub) << shift;
+
+	return lower + ((uint64_t)1 << shift) - 1;
+}
+
+void LatencyHistogram::record(uint64_t ns)
+{
+	m_buckets[bucketIndex(ns)].fetch_add(1, std::memory_order_relaxed);
+	m_count.fetch_add(1, std::memory_order_relaxed);
+	m_sum.fetch_add(ns, std::memory_order_relaxed);
+
+	uint64_t prev = m_min.load(std::memory_order_relaxed);
+	while (ns < prev && !m_min.compare_exchange_weak(prev, ns, std::memory_order_relaxed))
+		;
+
+	prev = m_max.load(std::memory_order_relaxed);
+	while (ns > prev && !m_max.compare_exchange_weak(prev, ns, std::memory_order_relaxed))
+		;
+}
+
+uint64_t LatencyHistogram::count() const
+{
+	return m_count.load(std::memory_order_relaxed);
+}
+
+uint64_t LatencyHistogram::min() const
+{
+	return count() == 0 ? 0 : m_min.load(std::memory_order_relaxed);
+}
+
+uint64_t LatencyHistogram::max() const
+{
+	return m_max.load(std::memory_order_relaxed);
+}
+
+double LatencyHistogram::mean() const
+{
+	uint64_t n = count();
+	return n == 0 ? 0 : (double)m_sum.load(std::memory_order_relaxed) / n;
+}
+
+uint64_t LatencyHistogram::percentile(double p) const
+{
+	uint64_t n = count();
+	if (n == 0)
+		return 0;
+
+	// rank of the requested sample (1-based)
+	uint64_t rank = (uint64_t)(p / 100 * n + 0.5);
+	if (rank < 1)
+		rank = 1;
+
+	uint64_t seen = 0;
+	for (unsigned i = 0; i < NUM_BUCKETS; i++)
+	{
+		seen += m_buckets[i].load(std::memory_order_relaxed);
+		if (seen >= rank)
+			return std::min(bucketUpperBound(i), max());
+	}
+
+	return max();
+}
+
+void LatencyHistogram::writeJson(FILE *fp) const
+{
+	fprintf(fp, "{ \"count\": %llu, \"min_ns\": %llu, \"max_ns\": %llu, \"mean_ns\": %.0f, "
+		"\"p50_ns\": %llu, \"p90_ns\": %llu, \"p99_ns\": %llu, \"p999_ns\": %llu, \"buckets\": [",
+		(unsigned long long)count(), (unsigned long long)min(), (unsigned long long)max(), mean(),
+		(unsigned long long)percentile(50), (unsigned long long)percentile(90),
+		(unsigned long long)percentile(99), (unsigned long long)percentile(99.9));
+
+	// non-empty buckets only, as [upper_bound_ns, count] pairs
+	bool first = true;
+	for (unsigned i = 0; i < NUM_BUCKETS; i++)
+	{
+		uint64_t c = m_buckets[i].load(std::memory_order_relaxed);
+		if (c == 0)
+			continue;
+
+		fprintf(fp, "%s[%llu, %llu]", first ? "" : ", ",
+			(unsigned long long)bucketUpperBound(i), (unsigned long long)c);
+		first = false;
+	}
+
+	fprintf(fp, "] }");
+}
+
+TickStats::TickStats(const char *outputPath, double dumpInterval,
+	const std::vector<std::string> &uavNames, size_t topStragglers)
+: m_outputPath(outputPath), m_dumpInterval(dumpInterval * 1e9), m_ticks(0), m_lastSlowestUavNum(-1),
+  m_stragglers(uavNames), m_topStragglers(topStragglers)
+{
+	m_startTime = m_lastDump = now();
+
+	struct sigaction sa;
+	memset(&sa, 0, sizeof(sa));
+	sa.sa_handler = sigusr1Handler;
+	sa.sa_flags = SA_RESTART;
+	sigemptyset(&sa.sa_mask);
+
+	if (sigaction(SIGUSR1, &sa, nullptr) != 0)
+		err(EXIT_FAILURE, "TickStats: sigaction failed");
+}
+
+TickStats::~TickStats()
+{
+	// covers the ticks since the last periodic dump
+	dump();
+}
+
+uint64_t TickStats::now()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+void TickStats::recordArrival(int uav_num, uint64_t offset)
+{
+	m_stragglers.recordArrival(uav_num, offset);
+}
+
+void TickStats::recordTick(const TickTimes &times)
+{
+	m_stragglers.endTick();
+
+	m_tick.record(times.phase0Wait + times.downstreamGather + times.phase1Wait + times.upstreamGather);
+	m_phase0Wait.record(times.phase0Wait);
+	m_downstreamGather.record(times.downstreamGather);
+	m_phase1Wait.record(times.phase1Wait);
+	m_upstreamGather.record(times.upstreamGather);
+	if (times.slowestUavNum != -1)
+		m_slowestUav.record(times.slowestUav);
+	m_lastSlowestUavNum = times.slowestUavNum;
+	m_ticks++;
+
+	uint64_t t = now();
+	if (g_dumpRequested || (m_dumpInterval != 0 && t - m_lastDump >= m_dumpInterval))
+	{
+		g_dumpRequested = 0;
+		m_lastDump = t;
+		dump();
+	}
+}
+
+void TickStats::dump()
+{
+	// Write to a temporary file first, so that readers never see a
+	// partially-written file
+	std::string tmpPath = m_outputPath + ".tmp";
+
+	FILE *fp = fopen(tmpPath.c_str(), "w");
+	if (fp == nullptr)
+	{
+		warn("TickStats: cannot open %s", tmpPath.c_str());
+		return;
+	}
+
+	fprintf(fp, "{\n");
+	fprintf(fp, "  \"uptime_s\": %.3f,\n", (now() - m_startTime) / 1e9);
+	fprintf(fp, "  \"ticks\": %llu,\n", (unsigned long long)m_ticks);
+	fprintf(fp, "  \"last_slowest_uav\": %d,\n", m_lastSlowestUavNum);
+
+	const struct { const char *name; const LatencyHistogram *h; } histograms[] =
+	{
+		{ "tick", &m_tick },
+		{ "phase0_ack_wait", &m_phase0Wait },
+		{ "downstream_gather", &m_downstreamGather },
+		{ "phase1_ack_wait", &m_phase1Wait },
+		{ "upstream_gather", &m_upstreamGather },
+		{ "slowest_uav", &m_slowestUav },
+	};
+
+	fprintf(fp, "  \"histograms\": {\n");
+	for (size_t i = 0; i < sizeof(histograms) / sizeof(histograms[0]); i++)
+	{
+		fprintf(fp, "    \"%s\": ", histograms[i].name);
+		histograms[i].h->writeJson(fp);
+		fprintf(fp, "%s\n", (i + 1 != sizeof(histograms) / sizeof(histograms[0])) ? "," : "");
+	}
+	fprintf(fp, "  },\n");
+
+	fprintf(fp, "  \"stragglers\": ");
+	m_stragglers.writeJson(fp, m_topStragglers);
+	fprintf(fp, "\n}\n");
+
+	if (fclose(fp) != 0 || rename(tmpPath.c_str(), m_outputPath.c_str()) != 0)
+		warn("TickStats: cannot write %s", m_outputPath.c_str());
+}
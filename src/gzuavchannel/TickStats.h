@@ -0,0 +1,108 @@
+#ifndef TICKSTATS_H
+#define TICKSTATS_H
+
+#include "StragglerTracker.h"
+
+#include <atomic>
+#include <stdint.h>
+#include <stdio.h>
+#include <string>
+
+/* Lock-free HDR-style histogram of latencies (expressed in nanoseconds).
+ *
+ * Values are grouped by their most significant bit, and each power-of-two
+ * range is further split into SUB_BUCKETS linear sub-buckets. This bounds the
+ * relative error of the reported percentiles to 1/SUB_BUCKETS, while keeping a
+ * fixed memory footprint that covers the whole uint64_t range.
+ *
+ * record() can be called concurrently with the read methods.
+ */
+class LatencyHistogram
+{
+	public:
+		LatencyHistogram();
+
+		void record(uint64_t ns);
+
+		uint64_t count() const;
+		uint64_t min() const;
+		uint64_t max() const;
+		double mean() const;
+
+		// p in [0, 100]
+		uint64_t percentile(double p) const;
+
+		// Write a JSON object with a summary and all non-empty buckets
+		void writeJson(FILE *fp) const;
+
+	private:
+		static const unsigned SUB_BUCKET_BITS = 5;
+		static const unsigned SUB_BUCKETS = 1 << SUB_BUCKET_BITS;
+		static const unsigned NUM_BUCKETS = (64 - SUB_BUCKET_BITS + 1) * SUB_BUCKETS;
+
+		static unsigned bucketIndex(uint64_t ns);
+		static uint64_t bucketUpperBound(unsigned idx);
+
+		std::atomic<uint64_t> m_buckets[NUM_BUCKETS];
+		std::atomic<uint64_t> m_count, m_sum, m_min, m_max;
+};
+
+// Durations measured during one iteration of the main loop
+struct TickTimes
+{
+	uint64_t phase0Wait;       // waiting for phase 0 subscribers' END-TICK
+	uint64_t downstreamGather; // waiting for all downstream packets
+	uint64_t phase1Wait;       // phase 1 round trip and maintenance
+	uint64_t upstreamGather;   // waiting for all upstream packets
+
+	// time between the beginning of the downstream gather and the arrival of
+	// the last downstream packet, and the UAV that sent it (-1 if no packet
+	// was expected, in which case slowestUav is not recorded)
+	uint64_t slowestUav;
+	int slowestUavNum;
+};
+
+/* Collects per-tick timing information and per-UAV arrival times, and
+ * periodically dumps them as JSON.
+ *
+ * Dumps are written when the configured interval expires or when SIGUSR1 is
+ * received. Both conditions are only checked at the end of each tick, so the
+ * lockstep loop is never interrupted. A final dump is written on destruction.
+ */
+class TickStats
+{
+	public:
+		// dumpInterval is in seconds (0 = only dump on SIGUSR1)
+		// topStragglers is the number of slowest UAVs to be listed
+		TickStats(const char *outputPath, double dumpInterval,
+			const std::vector<std::string> &uavNames, size_t topStragglers);
+		~TickStats();
+
+		// offset is the arrival time relative to the beginning of the gather
+		void recordArrival(int uav_num, uint64_t offset);
+		void recordTick(const TickTimes &times);
+
+		// current time (CLOCK_MONOTONIC) in nanoseconds
+		static uint64_t now();
+
+	private:
+		void dump();
+
+		std::string m_outputPath;
+		uint64_t m_dumpInterval, m_lastDump, m_startTime;
+
+		uint64_t m_ticks;
+		int m_lastSlowestUavNum;
+
+		LatencyHistogram m_tick;
+		LatencyHistogram m_phase0Wait;
+		LatencyHistogram m_downstreamGather;
+		LatencyHistogram m_phase1Wait;
+		LatencyHistogram m_upstreamGather;
+		LatencyHistogram m_slowestUav;
+
+		StragglerTracker m_stragglers;
+		size_t m_topStragglers;
+};
+
+#endif // TICKSTATS_H
@@ -0,0 +1,68 @@
+#ifndef TRACEFORMAT_H
+#define TRACEFORMAT_H
+
+#include <stdint.h>
+
+/* On-disk format of gzuavchannel's tick traces.
+ *
+ * A trace consists of two files, both in host byte order:
+ *
+ *  - The data file (PATH) starts with a TraceFileHeader, followed by the
+ *    names of the UAVs (each one as a uint16_t length and the characters,
+ *    without terminator), zero-padded to a multiple of 8 bytes. Then,
+ *    forwarded packets follow, each one as a TraceRecordHeader and the raw
+ *    packet contents, again zero-padded to a multiple of 8 bytes. Upstream
+ *    packets withheld by --decimation are not recorded, while the held
+ *    downstream packets that stand in for them are.
+ *
+ *  - The index file (PATH.idx) starts with a TraceFileHeader (without
+ *    names), followed by one TraceIndexEntry for each iteration of the main
+ *    loop (i.e. downstream gather, phase 1 and upstream gather).
+ *
+ * Both files are append-only and all structures are 8-byte aligned, so they
+ * can be mmap()ed and read in place.
+ */
+
+#define TRACE_DATA_MAGIC "GZUAVTRD"
+#define TRACE_INDEX_MAGIC "GZUAVTRI"
+#define TRACE_VERSION 1
+
+// Direction of a recorded packet
+enum
+{
+	TRACE_FROM_UPSTREAM = 0,   // e.g. Gazebo -> ArduCopter (BEGIN-TICK)
+	TRACE_FROM_DOWNSTREAM = 1, // e.g. ArduCopter -> Gazebo (END-TICK)
+};
+
+struct TraceFileHeader
+{
+	char magic[8];
+	uint32_t version;
+	uint32_t uavCount;
+};
+
+struct TraceRecordHeader
+{
+	uint64_t tick;
+	uint16_t uavNum;
+	uint8_t direction;
+	uint8_t reserved;
+	uint32_t length; // without padding
+};
+
+struct TraceIndexEntry
+{
+	uint64_t tick;
+	double timestamp;      // simulation time of the tick's upstream packets
+	uint64_t offset;       // offset of the tick's first record in the data file
+	uint32_t recordCount;
+	uint32_t droppedCount; // records that did not fit in the ring buffer
+};
+
+static_assert(sizeof(TraceFileHeader) == 16, "Unexpected TraceFileHeader size");
+static_assert(sizeof(TraceRecordHeader) == 16, "Unexpected TraceRecordHeader size");
+static_assert(sizeof(TraceIndexEntry) == 32, "Unexpected TraceIndexEntry size");
+
+#define TRACE_ALIGN(n) (((n) + 7) & ~(uint64_t)7)
+
+#endif // TRACEFORMAT_H
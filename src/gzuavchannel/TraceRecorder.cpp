@@ -0,0 +1,113 @@
+#include "TraceRecorder.h"
+#include "TraceFormat.h"
+
+#include <err.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Sizes of the ring buffers between the main loop and the writer threads
+#define DATA_RING_SIZE (64 * 1024 * 1024)
+#define INDEX_RING_SIZE (1024 * 1024)
+
+static const uint8_t zeroPadding[8] = { 0 };
+
+static int createFile(const std::string &path)
+{
+	int fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+	if (fd < 0)
+		err(EXIT_FAILURE, "TraceRecorder: cannot create %s", path.c_str());
+
+	return fd;
+}
+
+TraceRecorder::TraceRecorder(const char *path, const std::vector<std::string> &uavNames)
+: m_tick(0), m_offset(0), m_tickOffset(0), m_tickRecords(0), m_tickDropped(0), m_totalDropped(0)
+{
+	m_data = new IO::BackgroundWriter(createFile(path), DATA_RING_SIZE);
+	m_index = new IO::BackgroundWriter(createFile(std::string(path) + ".idx"), INDEX_RING_SIZE);
+
+	// Data file header and UAV names
+	std::vector<uint8_t> hdr(sizeof(TraceFileHeader));
+	TraceFileHeader *fh = (TraceFileHeader*)hdr.data();
+	memcpy(fh->magic, TRACE_DATA_MAGIC, sizeof(fh->magic));
+	fh->version = TRACE_VERSION;
+	fh->uavCount = uavNames.size();
+
+	for (const std::string &name : uavNames)
+	{
+		uint16_t name_len = name.length();
+		hdr.insert(hdr.end(), (const uint8_t*)&name_len, (const uint8_t*)&name_len + sizeof(name_len));
+		hdr.insert(hdr.end(), name.begin(), name.end());
+	}
+	hdr.resize(TRACE_ALIGN(hdr.size()), 0);
+
+	if (!m_data->write(hdr.data(), hdr.size()))
+		errx(EXIT_FAILURE, "TraceRecorder: header does not fit in the ring buffer");
+
+	m_offset = m_tickOffset = hdr.size();
+
+	// Index file header
+	TraceFileHeader ih;
+	memcpy(ih.magic, TRACE_INDEX_MAGIC, sizeof(ih.magic));
+	ih.version = TRACE_VERSION;
+	ih.uavCount = uavNames.size();
+	m_index->write(&ih, sizeof(ih));
+}
+
+TraceRecorder::~TraceRecorder()
+{
+	// flushes all pending data
+	delete m_data;
+	delete m_index;
+
+	if (m_totalDropped != 0)
+		warnx("TraceRecorder: %llu records were dropped", (unsigned long long)m_totalDropped);
+}
+
+void TraceRecorder::record(int uav_num, int direction, const void *data, size_t len)
+{
+	TraceRecordHeader rh;
+	rh.tick = m_tick;
+	rh.uavNum = uav_num;
+	rh.direction = direction;
+	rh.reserved = 0;
+	rh.length = len;
+
+	size_t padding = TRACE_ALIGN(len) - len;
+	struct iovec iov[3] =
+	{
+		{ &rh, sizeof(rh) },
+		{ const_cast<void*>(data), len },
+		{ const_cast<uint8_t*>(zeroPadding), padding },
+	};
+
+	if (m_data->write(iov, 3))
+	{
+		m_offset += sizeof(rh) + len + padding;
+		m_tickRecords++;
+	}
+	else
+	{
+		m_tickDropped++;
+	}
+}
+
+void TraceRecorder::endTick(double timestamp)
+{
+	TraceIndexEntry ie;
+	ie.tick = m_tick;
+	ie.timestamp = timestamp;
+	ie.offset = m_tickOffset;
+	ie.recordCount = m_tickRecords;
+	ie.droppedCount = m_tickDropped;
+
+	if (!m_index->write(&ie, sizeof(ie)))
+		m_tickDropped += m_tickRecords; // the whole tick is lost
+
+	m_totalDropped += m_tickDropped;
+
+	m_tick++;
+	m_tickOffset = m_offset;
+	m_tickRecords = m_tickDropped = 0;
+}
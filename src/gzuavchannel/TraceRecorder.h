@@ -0,0 +1,35 @@
+#ifndef TRACERECORDER_H
+#define TRACERECORDER_H
+
+#include "IO/BackgroundWriter.h"
+
+#include <string>
+#include <vector>
+
+/* Records all forwarded packets to a tick trace (see TraceFormat.h).
+ *
+ * Files are written by background threads. If the lockstep loop produces data
+ * faster than it can be written, records are dropped (and counted in the
+ * index) instead of stalling the loop.
+ */
+class TraceRecorder
+{
+	public:
+		TraceRecorder(const char *path, const std::vector<std::string> &uavNames);
+		~TraceRecorder();
+
+		void record(int uav_num, int direction, const void *data, size_t len);
+
+		// Close the current tick, whose upstream packets had the given timestamp
+		void endTick(double timestamp);
+
+	private:
+		IO::BackgroundWriter *m_data, *m_index;
+
+		uint64_t m_tick;
+		uint64_t m_offset, m_tickOffset;
+		uint32_t m_tickRecords, m_tickDropped;
+		uint64_t m_totalDropped;
+};
+
+#endif // TRACERECORDER_H
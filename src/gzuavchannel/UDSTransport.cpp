@@ -4,13 +4,14 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <sys/socket.h>
+#include <sys/uio.h>
 #include <sys/un.h>
 #include <unistd.h>
 
 #include <algorithm>
 #include <set>
 
-UDSTransport::UDSTransport(const std::string &path, const std::vector<std::string> &localNames)
+UDSTransport::UDSTransport(const std::string &path, const std::vector<std::string> &localNames, GzUavProtocol::PeerRole peerRole)
 {
 	int serv_fd = socket(AF_UNIX, SOCK_SEQPACKET, 0);
 
@@ -31,10 +32,66 @@ UDSTransport::UDSTransport(const std::string &path, const std::vector<std::strin
 	{
 		int uav_fd = accept(serv_fd, nullptr, nullptr);
 
+		// Receive either a HELLO or a legacy IDENTIFY-UAV message (i.e. just
+		// the name)
+		char msg[sizeof(GzUavProtocol::Header) + sizeof(GzUavProtocol::Hello) + 256];
+		int msg_len = recv(uav_fd, msg, sizeof(msg), 0);
+
+		if (msg_len <= 0)
+			errx(EXIT_FAILURE, "failed to receive UAV name");
+
+		Peer peer;
+		peer.fd = uav_fd;
+		peer.caps = 0;
+
+		GzUavProtocol::Header h;
+		GzUavProtocol::Hello hello;
 		char name[256];
-		int name_len = recv(uav_fd, name, sizeof(name), 0);
+		int name_len;
+
+		memcpy(&h, msg, std::min<size_t>(msg_len, sizeof(h)));
+		if (msg_len >= (int)sizeof(h) && h.magic == GzUavProtocol::MAGIC)
+		{
+			// Newer peers can talk to us using our version
+			if (h.type != GzUavProtocol::PKT_HELLO || h.version < 1
+				|| h.length != msg_len - sizeof(h) || h.length < sizeof(hello))
+			{
+				errx(EXIT_FAILURE, "UDS: received invalid HELLO");
+			}
+
+			memcpy(&hello, msg + sizeof(h), sizeof(hello));
+			name_len = h.length - sizeof(hello);
+			memcpy(name, msg + sizeof(h) + sizeof(hello), std::min<size_t>(name_len, sizeof(name)));
+
+			peer.legacy = false;
+			if (hello.role != peerRole)
+			{
+				errx(EXIT_FAILURE, "UDS: received HELLO with role %d on a socket for role %d",
+					hello.role, peerRole);
+			}
+			else if (hello.role == GzUavProtocol::ROLE_SIMULATOR)
+			{
+				peer.recvType = GzUavProtocol::PKT_BEGIN_TICK;
+				peer.sendType = GzUavProtocol::PKT_END_TICK;
+			}
+			else if (hello.role == GzUavProtocol::ROLE_AUTOPILOT)
+			{
+				peer.recvType = GzUavProtocol::PKT_END_TICK;
+				peer.sendType = GzUavProtocol::PKT_BEGIN_TICK;
+			}
+			else
+			{
+				errx(EXIT_FAILURE, "UDS: received HELLO with invalid role %d", hello.role);
+			}
+		}
+		else
+		{
+			name_len = std::min<size_t>(msg_len, sizeof(name));
+			memcpy(name, msg, name_len);
+			peer.legacy = true;
+		}
 
-		if (name_len <= 0 || name_len >= sizeof(name))
+		if (name_len <= 0 || name_len >= (int)sizeof(name))
 			errx(EXIT_FAILURE, "failed to receive UAV name");
 
 		name[name_len] = '\0';
@@ -43,19 +100,63 @@ UDSTransport::UDSTransport(const std::string &path, const std::vector<std::strin
 			errx(EXIT_FAILURE, "UDS: received unexpected UAV name: %s", name);
 
 		int idx = std::find(localNames.begin(), localNames.end(), name) - localNames.begin();
-		warnx("UDS: UAV #%d is connected %s on socket %d", idx, name, uav_fd);
+		warnx("UDS: UAV #%d is connected %s on socket %d (%s protocol)", idx, name, uav_fd,
+			peer.legacy ? "legacy" : "versioned");
 
-		m_num2fd.emplace(idx, uav_fd);
-		m_pollGrp.add(uav_fd, [this, idx, uav_fd]()
+		if (!peer.legacy)
+		{
+			GzUavProtocol::HelloAck ack;
+			memset(&ack, 0, sizeof(ack));
+			ack.caps = peer.caps = hello.caps & GzUavProtocol::SUPPORTED_CAPS;
+			ack.uavId = idx;
+
+			char reply[sizeof(h) + sizeof(ack)];
+			h = GzUavProtocol::makeHeader(GzUavProtocol::PKT_HELLO_ACK, 0, sizeof(ack));
+			memcpy(reply, &h, sizeof(h));
+			memcpy(reply + sizeof(h), &ack, sizeof(ack));
+
+			if (send(uav_fd, reply, sizeof(reply), MSG_NOSIGNAL) != sizeof(reply))
+				err(EXIT_FAILURE, "UDS: failed to send HELLO-ACK");
+		}
+
+		m_peers.emplace(idx, peer);
+		m_pollGrp.add(uav_fd, [this, idx, peer]()
 		{
 			char data[65536];
-			int r = recv(uav_fd, data, sizeof(data), 0);
+			int r = recv(peer.fd, data, sizeof(data), 0);
 
 			if (r <= 0)
 				err(EXIT_FAILURE, "UDS: UAV #%d read error", idx);
 
+			if (peer.legacy)
+			{
+				if (m_recvHandler)
+					m_recvHandler(idx, data, r);
+				return;
+			}
+
+			GzUavProtocol::Header h;
+			memcpy(&h, data, std::min<size_t>(r, sizeof(h)));
+			if (!GzUavProtocol::isValidMessage(data, r) || h.type != peer.recvType)
+				errx(EXIT_FAILURE, "UDS: UAV #%d sent an invalid packet", idx);
+
+			if (h.type == GzUavProtocol::PKT_BEGIN_TICK && (peer.caps & GzUavProtocol::CAP_COMPACT_BEGIN_TICK))
+			{
+				if (h.length != sizeof(GzUavProtocol::CompactBeginTick))
+					errx(EXIT_FAILURE, "UDS: UAV #%d sent a compact BEGIN-TICK packet of unexpected size %d", idx, h.length);
+
+				GzUavProtocol::CompactBeginTick compact;
+				GzUavProtocol::BeginTick full;
+				memcpy(&compact, data + sizeof(h), sizeof(compact));
+				GzUavProtocol::expandBeginTick(compact, &full);
+
+				if (m_recvHandler)
+					m_recvHandler(idx, &full, sizeof(full));
+				return;
+			}
+
 			if (m_recvHandler)
-				m_recvHandler(idx, data, r);
+				m_recvHandler(idx, data + sizeof(h), r - sizeof(h));
 		});
 	}
 
@@ -85,5 +186,40 @@ void UDSTransport::setReceivedPacketHandler(const std::function<void(int uav_num
 
 void UDSTransport::sendPacket(int uav_num, const void *data, size_t len)
 {
-	send(m_num2fd.at(uav_num), data, len, 0);
+	const Peer &peer = m_peers.at(uav_num);
+
+	if (peer.legacy)
+	{
+		send(peer.fd, data, len, 0);
+		return;
+	}
+
+	GzUavProtocol::CompactBeginTick compact;
+	if (peer.sendType == GzUavProtocol::PKT_BEGIN_TICK && (peer.caps & GzUavProtocol::CAP_COMPACT_BEGIN_TICK))
+	{
+		GzUavProtocol::BeginTick full;
+		if (len != sizeof(full))
+			errx(EXIT_FAILURE, "UDS: cannot compact BEGIN-TICK packet of unexpected size %zu", len);
+
+		memcpy(&full, data, sizeof(full));
+		GzUavProtocol::compactBeginTick(full, &compact);
+		data = &compact;
+		len = sizeof(compact);
+	}
+
+	GzUavProtocol::Header h = GzUavProtocol::makeHeader(
+		(GzUavProtocol::PacketType)peer.sendType, uav_num, len);
+
+	struct iovec iov[2];
+	iov[0].iov_base = &h;
+	iov[0].iov_len = sizeof(h);
+	iov[1].iov_base = const_cast<void*>(data);
+	iov[1].iov_len = len;
+
+	struct msghdr mh;
+	memset(&mh, 0, sizeof(mh));
+	mh.msg_iov = iov;
+	mh.msg_iovlen = 2;
+
+	sendmsg(peer.fd, &mh, 0);
 }
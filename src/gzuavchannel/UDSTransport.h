@@ -3,13 +3,18 @@
 
 #include "Transport.h"
 
+#include "GzUav/Protocol.h"
+
+#include <map>
 #include <string>
 #include <vector>
 
 class UDSTransport : public Transport
 {
 	public:
-		UDSTransport(const std::string &path, const std::vector<std::string> &localNames);
+		// peerRole is the role that the connecting processes play: HELLOs
+		// announcing a different one are rejected
+		UDSTransport(const std::string &path, const std::vector<std::string> &localNames, GzUavProtocol::PeerRole peerRole);
 		~UDSTransport() override;
 
 		int fd() const override;
@@ -19,9 +24,17 @@ class UDSTransport : public Transport
 		void sendPacket(int uav_num, const void *data, size_t len) override;
 
 	private:
+		struct Peer
+		{
+			int fd;
+			bool legacy; // raw payloads without GzUavProtocol headers
+			uint8_t recvType, sendType; // GzUavProtocol::PacketType
+			uint32_t caps; // GzUavProtocol::Capability flags enabled on this connection
+		};
+
 		IO::PollGroup m_pollGrp;
 		std::function<void(int uav_num, const void *data, size_t len)> m_recvHandler;
-		std::map<int, int> m_num2fd; // uav_num -> fd
+		std::map<int, Peer> m_peers; // uav_num -> peer
 };
 
 #endif // UDSTRANSPORT_H
@@ -1,34 +1,61 @@
 #include "CommandLineParser.h"
 #include "ExternalSyncServer.h"
+#include "ReplayTransport.h"
 #include "TCPTransport.h"
+#include "TickStats.h"
+#include "TraceFormat.h"
+#include "TraceRecorder.h"
 #include "UDSTransport.h"
 
+#include "GzUav/Protocol.h"
+
 #include <err.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
-// packet sent by gazebo plugin
-struct fdmPacket
+#include <vector>
+
+static TraceRecorder *recorder;
+static TickStats *stats;
+
+// Transports terminate the process with exit() when a peer disconnects: make
+// sure that the trace is completely written to disk in that case too
+static void flushTrace()
 {
-	double timestamp;
-	double positionXYZ[3];
-	// extra fields that are not used by gzuavchannel follow
-};
+	delete recorder;
+	recorder = nullptr;
+}
 
-static Transport *makeTransport(const char *spec, const std::vector<std::string> &uavNames)
+// Likewise, write the statistics of the last partial interval
+static void flushStats()
+{
+	delete stats;
+	stats = nullptr;
+}
+
+// peerRole is the role of the peers on the other side of the transport
+static Transport *makeTransport(const char *spec, const std::vector<std::string> &uavNames, GzUavProtocol::PeerRole peerRole)
 {
 	if (strncasecmp(spec, "tcpc:", 5) == 0)
 	{
-		return new TCPTransport(spec + 5, uavNames);
+		return new TCPTransport(spec + 5, uavNames, peerRole);
 	}
 	else if (strncasecmp(spec, "tcpl:", 5) == 0)
 	{
-		return new TCPTransport(atoi(spec + 5), uavNames);
+		return new TCPTransport(atoi(spec + 5), uavNames, peerRole);
 	}
 	else if (strncasecmp(spec, "uds:", 4) == 0 && strlen(spec) > 4)
 	{
-		return new UDSTransport(spec + 4, uavNames);
+		return new UDSTransport(spec + 4, uavNames, peerRole);
+	}
+	else if (strncasecmp(spec, "replay:", 7) == 0 && strlen(spec) > 7)
+	{
+		// Traces only contain what the simulator sends
+		if (peerRole != GzUavProtocol::ROLE_SIMULATOR)
+			errx(EXIT_FAILURE, "Transport type replay can only be used upstream: %s", spec);
+
+		return new ReplayTransport(spec + 7, uavNames);
 	}
 	else
 	{
@@ -48,67 +75,175 @@ int main(int argc, char *argv[])
 	ExternalSyncServer *syncsrv = (cl.externalSyncServerPort == 0) ?
 		nullptr : new ExternalSyncServer(cl.externalSyncServerPort);
 
+	// Initialize per-tick timing statistics
+	if (cl.statsOutputPath != nullptr)
+	{
+		stats = new TickStats(cl.statsOutputPath, cl.statsInterval, cl.upstreamUavNames, cl.statsTopStragglers);
+		atexit(flushStats);
+	}
+
+	// Initialize trace recorder
+	if (cl.traceOutputPath != nullptr)
+	{
+		recorder = new TraceRecorder(cl.traceOutputPath, cl.upstreamUavNames);
+		atexit(flushTrace);
+	}
+
 	// Initialize transport channels
 	Transport *upstreamTransport, *downstreamTransport;
 	if (cl.invertInitializationOrder == false)
 	{
 		puts("GZUAVCHANNEL:STARTING");
-		upstreamTransport = makeTransport(cl.upstreamSpec, cl.upstreamUavNames);
+		upstreamTransport = makeTransport(cl.upstreamSpec, cl.upstreamUavNames, GzUavProtocol::ROLE_SIMULATOR);
 		puts("GZUAVCHANNEL:HALF");
-		downstreamTransport = makeTransport(cl.downstreamSpec, cl.downstreamUavNames);
+		downstreamTransport = makeTransport(cl.downstreamSpec, cl.downstreamUavNames, GzUavProtocol::ROLE_AUTOPILOT);
 		puts("GZUAVCHANNEL:GO");
 	}
 	else
 	{
 		puts("GZUAVCHANNEL:STARTING");
-		downstreamTransport = makeTransport(cl.downstreamSpec, cl.downstreamUavNames);
+		downstreamTransport = makeTransport(cl.downstreamSpec, cl.downstreamUavNames, GzUavProtocol::ROLE_AUTOPILOT);
 		puts("GZUAVCHANNEL:HALF");
-		upstreamTransport = makeTransport(cl.upstreamSpec, cl.upstreamUavNames);
+		upstreamTransport = makeTransport(cl.upstreamSpec, cl.upstreamUavNames, GzUavProtocol::ROLE_SIMULATOR);
 		puts("GZUAVCHANNEL:GO");
 	}
 
+	// Decimation state: UAVs whose BEGIN-TICK packet was not forwarded
+	// downstream in the previous step are answered with their last END-TICK
+	// packet instead
+	uint64_t tickNum = 0;
+	std::vector<bool> awaitingEndTick(cl.uavCount, true);
+	std::vector<std::vector<uint8_t>> heldEndTick(cl.uavCount);
+	size_t expectedEndTicks;
+
 	// Setup callbacks
 	size_t forwardedPackets;
+	TickTimes times;
+	uint64_t gatherStart;
+	double tickTimestamp = 0;
 	upstreamTransport->setReceivedPacketHandler([&](int uav_num, const void *data, size_t len)
 	{
-		const fdmPacket *pkt = (const fdmPacket*)data;
+		if (len != sizeof(GzUavProtocol::BeginTick))
+			errx(EXIT_FAILURE, "UAV #%d sent a BEGIN-TICK packet of unexpected size %zu", uav_num, len);
+
+		GzUavProtocol::BeginTick pkt;
+		memcpy(&pkt, data, sizeof(pkt));
 
-		downstreamTransport->sendPacket(uav_num, data, len);
+		if (tickNum % cl.decimation[uav_num] == 0)
+		{
+			downstreamTransport->sendPacket(uav_num, data, len);
+			awaitingEndTick[uav_num] = true;
+
+			if (recorder != nullptr)
+				recorder->record(uav_num, TRACE_FROM_UPSTREAM, data, len);
+		}
 
 		if (forwardedPackets++ == 0)
 		{
+			tickTimestamp = pkt.timestamp;
+
 			if (syncsrv != nullptr)
-				syncsrv->beginPhase0(pkt->timestamp);
+				syncsrv->beginPhase0(pkt.timestamp);
+		}
+		else if (pkt.timestamp != tickTimestamp)
+		{
+			// UAVs can be simulated by different processes (e.g. one
+			// gzserver per physics partition), which must stay in step
+			errx(EXIT_FAILURE, "UAV #%d sent a BEGIN-TICK packet for time %.9f, but the current tick is at %.9f",
+				uav_num, pkt.timestamp, tickTimestamp);
 		}
 
 		if (syncsrv != nullptr)
-			syncsrv->setUavPosition(uav_num, pkt->positionXYZ[0], pkt->positionXYZ[1], pkt->positionXYZ[2]);
+			syncsrv->setUavPosition(uav_num, pkt.vehiclePose.positionXYZ_world[0],
+				pkt.vehiclePose.positionXYZ_world[1], pkt.vehiclePose.positionXYZ_world[2]);
 	});
 	downstreamTransport->setReceivedPacketHandler([&](int uav_num, const void *data, size_t len)
 	{
 		upstreamTransport->sendPacket(uav_num, data, len);
 		forwardedPackets++;
+
+		if (cl.decimation[uav_num] != 1)
+			heldEndTick[uav_num].assign((const uint8_t*)data, (const uint8_t*)data + len);
+
+		if (recorder != nullptr)
+			recorder->record(uav_num, TRACE_FROM_DOWNSTREAM, data, len);
+
+		if (stats != nullptr)
+		{
+			uint64_t offset = TickStats::now() - gatherStart;
+			stats->recordArrival(uav_num, offset);
+
+			// the last packet of each tick comes from the slowest UAV
+			if (forwardedPackets == expectedEndTicks)
+			{
+				times.slowestUav = offset;
+				times.slowestUavNum = uav_num;
+			}
+		}
 	});
 
 	// Main loop
 	while (true)
 	{
+		uint64_t t0 = TickStats::now();
+
 		if (syncsrv != nullptr)
 			syncsrv->endPhase0();
 
+		uint64_t t1 = TickStats::now();
+
 		// End phase 0: Downstream -> Upstream
+		expectedEndTicks = 0;
+		for (size_t i = 0; i < cl.uavCount; i++)
+		{
+			if (awaitingEndTick[i])
+			{
+				expectedEndTicks++;
+			}
+			else
+			{
+				upstreamTransport->sendPacket(i, heldEndTick[i].data(), heldEndTick[i].size());
+
+				if (recorder != nullptr)
+					recorder->record(i, TRACE_FROM_DOWNSTREAM, heldEndTick[i].data(), heldEndTick[i].size());
+			}
+
+			awaitingEndTick[i] = false;
+		}
+
 		forwardedPackets = 0;
-		while (forwardedPackets != cl.uavCount)
+		gatherStart = t1;
+		times.slowestUav = 0;
+		times.slowestUavNum = -1; // stays so if all UAVs are decimated
+		while (forwardedPackets != expectedEndTicks)
 			downstreamTransport->runOnce();
 
+		uint64_t t2 = TickStats::now();
+
 		// Phase 1
 		if (syncsrv != nullptr)
 			syncsrv->doPhase1AndMainteinance();
 
+		uint64_t t3 = TickStats::now();
+
 		// Start phase 0: Upstream -> Downstream
 		forwardedPackets = 0;
 		while (forwardedPackets != cl.uavCount)
 			upstreamTransport->runOnce();
+
+		if (stats != nullptr)
+		{
+			times.phase0Wait = t1 - t0;
+			times.downstreamGather = t2 - t1;
+			times.phase1Wait = t3 - t2;
+			times.upstreamGather = TickStats::now() - t3;
+			stats->recordTick(times);
+		}
+
+		if (recorder != nullptr)
+			recorder->endTick(tickTimestamp);
+
+		tickNum++;
 	}
 
 	delete syncsrv;
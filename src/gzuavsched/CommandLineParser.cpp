@@ -0,0 +1,170 @@
+#include "CommandLineParser.h"
+
+#include <getopt.h>
+#include <err.h>
+#include <errno.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+enum
+{
+	OPT_CORES = 256,
+	OPT_REBALANCE_INTERVAL,
+	OPT_STATS_OUTPUT,
+	OPT_REALTIME,
+};
+
+static option long_options[] =
+{
+	{ "help", no_argument, nullptr, 'h' },
+	{ "cores", required_argument, nullptr, OPT_CORES },
+	{ "rebalance-interval", required_argument, nullptr, OPT_REBALANCE_INTERVAL },
+	{ "stats-output", required_argument, nullptr, OPT_STATS_OUTPUT },
+	{ "realtime", required_argument, nullptr, OPT_REALTIME },
+	{ nullptr, 0, nullptr, 0 }
+};
+
+static void showHelp()
+{
+	fprintf(stderr, "Usage: %s [options] < instance_list\n", program_invocation_name);
+	fprintf(stderr, "\n");
+	fprintf(stderr, "This program launches and supervises the arducopter instances of a cluster,\n");
+	fprintf(stderr, "pinning each one to a core. Cores are shared by several instances, that only\n");
+	fprintf(stderr, "run when they have received an FDM packet from gzuavchannel. The placement is\n");
+	fprintf(stderr, "periodically rebalanced according to the CPU time used by each instance:\n");
+	fprintf(stderr, "idle cores steal instances from the busiest ones.\n");
+	fprintf(stderr, "\n");
+	fprintf(stderr, "Each line of the instance list describes one instance, as tab-separated\n");
+	fprintf(stderr, "fields: name, working directory, executable path and arguments.\n");
+	fprintf(stderr, "\n");
+	fprintf(stderr, "All instances are terminated when this program receives SIGINT or SIGTERM.\n");
+	fprintf(stderr, "\n");
+	fprintf(stderr, "Options:\n");
+	fprintf(stderr, " --cores LIST: CPUs to use, e.g. \"0-3,8-11\" (default: all the CPUs this\n");
+	fprintf(stderr, "               program is allowed to run on).\n");
+	fprintf(stderr, " --rebalance-interval SECONDS: Interval between placement updates and stats\n");
+	fprintf(stderr, "                               dumps (default: 5, 0 disables rebalancing).\n");
+	fprintf(stderr, " --stats-output PATH: Dump per-core utilization and placement as JSON to PATH\n");
+	fprintf(stderr, "                      periodically and whenever SIGUSR1 is received.\n");
+	fprintf(stderr, " --realtime PRIO: Run instances with the SCHED_FIFO policy and the given\n");
+	fprintf(stderr, "                  priority (1-99), so that instances sharing a core are not\n");
+	fprintf(stderr, "                  preempted by each other until they block for the next\n");
+	fprintf(stderr, "                  packet (requires CAP_SYS_NICE).\n");
+	fprintf(stderr, "\n");
+
+	exit(EXIT_FAILURE);
+}
+
+// Parses a list of CPU numbers and ranges, e.g. "0-3,8"
+static std::vector<int> parseCpuList(const char *text, const char *optname)
+{
+	std::vector<int> result;
+	const char *p = text;
+
+	while (true)
+	{
+		char *endp;
+		long first = strtol(p, &endp, 10), last = first;
+		if (endp == p || first < 0 || first >= CPU_SETSIZE)
+			errx(EXIT_FAILURE, "option '%s' has invalid format", optname);
+
+		p = endp;
+		if (*p == '-')
+		{
+			last = strtol(p + 1, &endp, 10);
+			if (endp == p + 1 || last < first || last >= CPU_SETSIZE)
+				errx(EXIT_FAILURE, "option '%s' has invalid format", optname);
+			p = endp;
+		}
+
+		for (long i = first; i <= last; i++)
+			result.push_back((int)i);
+
+		if (*p == '\0')
+			return result;
+		else if (*p++ != ',')
+			errx(EXIT_FAILURE, "option '%s' has invalid format", optname);
+	}
+}
+
+CommandLineParser::CommandLineParser(int argc, char *argv[])
+{
+	rebalanceInterval = 5;
+	statsOutputPath = nullptr;
+	realtimePriority = 0;
+
+	bool help_requested = false;
+
+	while (true)
+	{
+		int c, option_index = 0;
+		c = getopt_long(argc, argv, "+h", long_options, &option_index);
+
+		if (c == -1) // end of options
+			break;
+
+		switch (c)
+		{
+			case '?':
+			case ':':
+				// getopt() has already printed an error message
+				exit(EXIT_FAILURE);
+			case 'h':
+				help_requested = true;
+				break;
+			case OPT_CORES:
+				cores = parseCpuList(optarg, long_options[option_index].name);
+				break;
+			case OPT_REBALANCE_INTERVAL:
+			{
+				char *endp;
+				rebalanceInterval = strtod(optarg, &endp);
+				if (*optarg == '\0' || *endp != '\0' || rebalanceInterval < 0)
+					errx(EXIT_FAILURE, "option '%s' has invalid format", long_options[option_index].name);
+				break;
+			}
+			case OPT_STATS_OUTPUT:
+				statsOutputPath = optarg;
+				break;
+			case OPT_REALTIME:
+				realtimePriority = atoi(optarg);
+				if (realtimePriority < 1 || realtimePriority > 99)
+					errx(EXIT_FAILURE, "option '%s' has invalid format", long_options[option_index].name);
+				break;
+		}
+	}
+
+	if (help_requested)
+		showHelp();
+
+	if (optind != argc)
+		errx(EXIT_FAILURE, "unexpected argument: %s", argv[optind]);
+
+	cpu_set_t allowed;
+	if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0)
+		err(EXIT_FAILURE, "sched_getaffinity failed");
+
+	if (cores.empty())
+	{
+		for (int i = 0; i < CPU_SETSIZE; i++)
+		{
+			if (CPU_ISSET(i, &allowed))
+				cores.push_back(i);
+		}
+	}
+	else
+	{
+		cpu_set_t seen;
+		CPU_ZERO(&seen);
+		for (int cpu : cores)
+		{
+			if (!CPU_ISSET(cpu, &allowed))
+				errx(EXIT_FAILURE, "CPU %d is not available", cpu);
+			else if (CPU_ISSET(cpu, &seen))
+				errx(EXIT_FAILURE, "CPU %d is listed more than once", cpu);
+			CPU_SET(cpu, &seen);
+		}
+	}
+}
@@ -0,0 +1,16 @@
+#ifndef COMMANDLINEPARSER_H
+#define COMMANDLINEPARSER_H
+
+#include <vector>
+
+struct CommandLineParser
+{
+	CommandLineParser(int argc, char *argv[]);
+
+	std::vector<int> cores; // CPUs that instances can be placed on
+	double rebalanceInterval; // seconds, 0 = never rebalance
+	const char *statsOutputPath; // nullptr = no stats
+	int realtimePriority; // SCHED_FIFO priority, 0 = normal scheduling
+};
+
+#endif // COMMANDLINEPARSER_H
@@ -0,0 +1,63 @@
+#include "CoreUsage.h"
+
+#include <ctype.h>
+#include <err.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <map>
+
+CoreUsage::CoreUsage(const std::vector<int> &cpus)
+: m_cpus(cpus), m_prev(cpus.size(), Counters{0, 0}), m_last(cpus.size(), Counters{0, 0})
+{
+}
+
+void CoreUsage::sample()
+{
+	FILE *fp = fopen("/proc/stat", "r");
+	if (fp == nullptr)
+	{
+		warn("CoreUsage: cannot open /proc/stat");
+		return;
+	}
+
+	// Per-CPU lines: "cpuN user nice system idle iowait irq softirq steal ..."
+	// (%d would skip the blanks after the aggregate "cpu" line's name and
+	// read its first counter as a CPU number)
+	std::map<int, Counters> counters;
+	char line[512];
+	while (fgets(line, sizeof(line), fp) != nullptr)
+	{
+		int cpu;
+		unsigned long long v[8] = {};
+		if (strncmp(line, "cpu", 3) != 0 || !isdigit((unsigned char)line[3])
+			|| sscanf(line, "cpu%d %llu %llu %llu %llu %llu %llu %llu %llu", &cpu,
+				&v[0], &v[1], &v[2], &v[3], &v[4], &v[5], &v[6], &v[7]) < 5)
+		{
+			continue;
+		}
+
+		uint64_t total = v[0] + v[1] + v[2] + v[3] + v[4] + v[5] + v[6] + v[7];
+		uint64_t idle = v[3] + v[4];
+		counters[cpu] = Counters{total - idle, total};
+	}
+
+	fclose(fp);
+
+	m_prev = m_last;
+	for (size_t i = 0; i < m_cpus.size(); i++)
+	{
+		auto it = counters.find(m_cpus[i]);
+		if (it != counters.end())
+			m_last[i] = it->second;
+	}
+}
+
+double CoreUsage::busyFraction(size_t i) const
+{
+	uint64_t total = m_last[i].total - m_prev[i].total;
+	if (total == 0)
+		return 0;
+
+	return (double)(m_last[i].busy - m_prev[i].busy) / total;
+}
@@ -0,0 +1,32 @@
+#ifndef COREUSAGE_H
+#define COREUSAGE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+// Measures the utilization of a set of CPUs, as reported by /proc/stat
+class CoreUsage
+{
+	public:
+		CoreUsage(const std::vector<int> &cpus);
+
+		// Reads the current counters. Utilization values refer to the time
+		// between the last two calls
+		void sample();
+
+		// fraction of time the i-th CPU (in the list passed to the
+		// constructor) was not idle
+		double busyFraction(size_t i) const;
+
+	private:
+		struct Counters
+		{
+			uint64_t busy, total;
+		};
+
+		std::vector<int> m_cpus;
+		std::vector<Counters> m_prev, m_last;
+};
+
+#endif // COREUSAGE_H
@@ -0,0 +1,277 @@
+#include "InstanceScheduler.h"
+
+#include "IO/JsonString.h"
+
+#include <dirent.h>
+#include <err.h>
+#include <errno.h>
+#include <sched.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/prctl.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <algorithm>
+
+// Moving an instance costs a cold cache: only do it if the busiest core's
+// load decreases by at least this fraction of a core
+#define MIN_REBALANCE_GAIN 0.05
+
+// Returns the total CPU time (user + system) used by a process, in clock ticks
+static bool readCpuTicks(pid_t pid, uint64_t *result)
+{
+	char path[64], buf[1024];
+	snprintf(path, sizeof(path), "/proc/%d/stat", (int)pid);
+
+	FILE *fp = fopen(path, "r");
+	if (fp == nullptr)
+		return false;
+
+	size_t len = fread(buf, 1, sizeof(buf) - 1, fp);
+	fclose(fp);
+	buf[len] = '\0';
+
+	// The command name is enclosed in parentheses and can contain spaces:
+	// skip it. utime and stime are the 12th and 13th fields after it
+	const char *p = strrchr(buf, ')');
+	if (p == nullptr)
+		return false;
+
+	unsigned long long utime, stime;
+	if (sscanf(p + 1, " %*c %*d %*d %*d %*d %*d %*u %*u %*u %*u %*u %llu %llu", &utime, &stime) != 2)
+		return false;
+
+	*result = utime + stime;
+	return true;
+}
+
+InstanceScheduler::InstanceScheduler(const std::vector<int> &cores, int realtimePriority)
+: m_cores(cores), m_realtimePriority(realtimePriority), m_migrations(0)
+{
+}
+
+void InstanceScheduler::launch(const std::string &name, const std::string &cwd, const std::vector<std::string> &argv)
+{
+	Instance inst;
+	inst.name = name;
+	inst.core = m_instances.size() % m_cores.size();
+	inst.lastCpuTicks = 0;
+	inst.load = 0;
+
+	std::vector<char*> cargv;
+	for (const std::string &arg : argv)
+		cargv.push_back(const_cast<char*>(arg.c_str()));
+	cargv.push_back(nullptr);
+
+	inst.pid = fork();
+	if (inst.pid == -1)
+		err(EXIT_FAILURE, "fork failed");
+
+	if (inst.pid == 0)
+	{
+		// Do not survive this process, even if it is killed
+		prctl(PR_SET_PDEATHSIG, SIGTERM);
+
+		// Restore the signal mask, signals are blocked by main()
+		sigset_t mask;
+		sigemptyset(&mask);
+		sigprocmask(SIG_SETMASK, &mask, nullptr);
+
+		cpu_set_t set;
+		CPU_ZERO(&set);
+		CPU_SET(m_cores[inst.core], &set);
+		if (sched_setaffinity(0, sizeof(set), &set) != 0)
+			warn("%s: sched_setaffinity failed", name.c_str());
+
+		if (m_realtimePriority != 0)
+		{
+			sched_param param;
+			param.sched_priority = m_realtimePriority;
+			if (sched_setscheduler(0, SCHED_FIFO, &param) != 0)
+				warn("%s: cannot enable SCHED_FIFO", name.c_str());
+		}
+
+		if (chdir(cwd.c_str()) != 0)
+		{
+			warn("%s: chdir to %s failed", name.c_str(), cwd.c_str());
+			_exit(127);
+		}
+
+		execvp(cargv[0], cargv.data());
+		warn("%s: cannot execute %s", name.c_str(), cargv[0]);
+		_exit(127);
+	}
+
+	readCpuTicks(inst.pid, &inst.lastCpuTicks);
+	m_instances.push_back(inst);
+}
+
+void InstanceScheduler::childExited(pid_t pid, int status)
+{
+	for (Instance &inst : m_instances)
+	{
+		if (inst.pid != pid)
+			continue;
+
+		if (WIFSIGNALED(status))
+			warnx("instance %s terminated by signal %d", inst.name.c_str(), WTERMSIG(status));
+		else
+			warnx("instance %s exited with status %d", inst.name.c_str(), WEXITSTATUS(status));
+
+		inst.pid = -1;
+		inst.load = 0;
+		return;
+	}
+}
+
+void InstanceScheduler::terminateAll()
+{
+	for (const Instance &inst : m_instances)
+	{
+		if (inst.pid != -1)
+			kill(inst.pid, SIGTERM);
+	}
+}
+
+size_t InstanceScheduler::runningCount() const
+{
+	size_t count = 0;
+	for (const Instance &inst : m_instances)
+	{
+		if (inst.pid != -1)
+			count++;
+	}
+
+	return count;
+}
+
+void InstanceScheduler::updateLoads(double elapsedSeconds)
+{
+	const double ticksPerSecond = sysconf(_SC_CLK_TCK);
+
+	for (Instance &inst : m_instances)
+	{
+		uint64_t cpuTicks;
+		if (inst.pid == -1 || !readCpuTicks(inst.pid, &cpuTicks))
+			continue;
+
+		if (elapsedSeconds > 0)
+			inst.load = (cpuTicks - inst.lastCpuTicks) / (ticksPerSecond * elapsedSeconds);
+		inst.lastCpuTicks = cpuTicks;
+	}
+}
+
+std::vector<double> InstanceScheduler::coreLoads() const
+{
+	std::vector<double> result(m_cores.size(), 0);
+	for (const Instance &inst : m_instances)
+	{
+		if (inst.pid != -1)
+			result[inst.core] += inst.load;
+	}
+
+	return result;
+}
+
+void InstanceScheduler::rebalance()
+{
+	std::vector<double> loads = coreLoads();
+
+	// Each step moves one instance from the busiest core to the least
+	// busy one. The busiest core's load strictly decreases at each step
+	// (or a different core becomes the busiest one), so this terminates,
+	// but bound it anyway
+	for (size_t step = 0; step < m_instances.size(); step++)
+	{
+		size_t busiest = 0, idlest = 0;
+		for (size_t c = 1; c < loads.size(); c++)
+		{
+			if (loads[c] > loads[busiest])
+				busiest = c;
+			if (loads[c] < loads[idlest])
+				idlest = c;
+		}
+
+		// The best candidate is the one that leaves the two cores as
+		// balanced as possible, i.e. whose load is closest to half the gap
+		const double gap = loads[busiest] - loads[idlest];
+		Instance *candidate = nullptr;
+		double bestGain = MIN_REBALANCE_GAIN;
+		for (Instance &inst : m_instances)
+		{
+			if (inst.pid == -1 || inst.core != busiest)
+				continue;
+
+			double newMax = std::max(loads[busiest] - inst.load, loads[idlest] + inst.load);
+			double gain = loads[busiest] - newMax;
+			if (gain >= bestGain && inst.load < gap)
+			{
+				bestGain = gain;
+				candidate = &inst;
+			}
+		}
+
+		if (candidate == nullptr)
+			break;
+
+		loads[busiest] -= candidate->load;
+		loads[idlest] += candidate->load;
+		candidate->core = idlest;
+		setAffinity(*candidate);
+		m_migrations++;
+	}
+}
+
+void InstanceScheduler::setAffinity(const Instance &inst)
+{
+	cpu_set_t set;
+	CPU_ZERO(&set);
+	CPU_SET(m_cores[inst.core], &set);
+
+	// sched_setaffinity only affects one thread: apply it to all of them
+	char path[64];
+	snprintf(path, sizeof(path), "/proc/%d/task", (int)inst.pid);
+
+	DIR *dir = opendir(path);
+	if (dir == nullptr)
+		return; // the instance has just terminated
+
+	while (dirent *ent = readdir(dir))
+	{
+		pid_t tid = atoi(ent->d_name);
+		if (tid > 0 && sched_setaffinity(tid, sizeof(set), &set) != 0 && errno != ESRCH)
+			warn("%s: sched_setaffinity failed", inst.name.c_str());
+	}
+
+	closedir(dir);
+}
+
+void InstanceScheduler::writeJson(FILE *fp, const CoreUsage &usage) const
+{
+	const std::vector<double> loads = coreLoads();
+
+	fprintf(fp, "  \"cores\": [\n");
+	for (size_t c = 0; c < m_cores.size(); c++)
+	{
+		fprintf(fp, "    { \"cpu\": %d, \"busy_pct\": %.1f, \"instances_pct\": %.1f, \"instances\": [",
+			m_cores[c], usage.busyFraction(c) * 100, loads[c] * 100);
+
+		bool first = true;
+		for (const Instance &inst : m_instances)
+		{
+			if (inst.pid == -1 || inst.core != c)
+				continue;
+
+			fprintf(fp, "%s{ \"name\": ", first ? " " : ", ");
+			IO::writeJsonString(fp, inst.name);
+			fprintf(fp, ", \"pid\": %d, \"load_pct\": %.1f }", (int)inst.pid, inst.load * 100);
+			first = false;
+		}
+
+		fprintf(fp, "%s] }%s\n", first ? "" : " ", (c + 1 != m_cores.size()) ? "," : "");
+	}
+	fprintf(fp, "  ],\n");
+	fprintf(fp, "  \"migrations\": %llu", (unsigned long long)m_migrations);
+}
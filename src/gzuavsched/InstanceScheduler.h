@@ -0,0 +1,61 @@
+#ifndef INSTANCESCHEDULER_H
+#define INSTANCESCHEDULER_H
+
+#include "CoreUsage.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <sys/types.h>
+
+#include <string>
+#include <vector>
+
+/* Launches the instances and keeps each one pinned to a single core.
+ *
+ * Instances are initially placed round-robin. Then, at each rebalance(),
+ * the least loaded core steals instances from the most loaded one, as long
+ * as this reduces the load of the most loaded core. In lockstep, the tick
+ * time is bounded by the busiest core, so that is what we minimize. */
+class InstanceScheduler
+{
+	public:
+		InstanceScheduler(const std::vector<int> &cores, int realtimePriority);
+
+		void launch(const std::string &name, const std::string &cwd, const std::vector<std::string> &argv);
+
+		// Must be called when a child process terminates
+		void childExited(pid_t pid, int status);
+
+		// Sends SIGTERM to all running instances
+		void terminateAll();
+
+		size_t runningCount() const;
+
+		// Measures the CPU time used by each instance since the last call
+		void updateLoads(double elapsedSeconds);
+
+		void rebalance();
+
+		// Writes the "cores" and "migrations" members of a JSON object
+		void writeJson(FILE *fp, const CoreUsage &usage) const;
+
+	private:
+		struct Instance
+		{
+			std::string name;
+			pid_t pid; // -1 after termination
+			size_t core; // index in m_cores
+			uint64_t lastCpuTicks;
+			double load; // fraction of a core used in the last interval
+		};
+
+		void setAffinity(const Instance &inst);
+		std::vector<double> coreLoads() const;
+
+		std::vector<int> m_cores;
+		int m_realtimePriority;
+		std::vector<Instance> m_instances;
+		uint64_t m_migrations;
+};
+
+#endif // INSTANCESCHEDULER_H
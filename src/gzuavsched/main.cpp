@@ -0,0 +1,173 @@
+#include "CommandLineParser.h"
+#include "CoreUsage.h"
+#include "InstanceScheduler.h"
+
+#include <err.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/signalfd.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+static double now()
+{
+	timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// Splits a line of the instance list into its tab-separated fields
+static std::vector<std::string> splitFields(const char *line)
+{
+	std::vector<std::string> result;
+	const char *p = line;
+
+	while (true)
+	{
+		const char *end = strpbrk(p, "\t\n");
+		if (end == nullptr)
+		{
+			result.push_back(p);
+			return result;
+		}
+
+		result.push_back(std::string(p, end - p));
+		if (*end == '\n')
+			return result;
+		p = end + 1;
+	}
+}
+
+static void dumpStats(const char *outputPath, double uptime, const InstanceScheduler &sched, const CoreUsage &usage)
+{
+	// Write to a temporary file first, so that readers never see a
+	// partially-written file
+	std::string tmpPath = std::string(outputPath) + ".tmp";
+
+	FILE *fp = fopen(tmpPath.c_str(), "w");
+	if (fp == nullptr)
+	{
+		warn("cannot open %s", tmpPath.c_str());
+		return;
+	}
+
+	fprintf(fp, "{\n");
+	fprintf(fp, "  \"uptime_s\": %.3f,\n", uptime);
+	sched.writeJson(fp, usage);
+	fprintf(fp, "\n}\n");
+
+	if (fclose(fp) != 0 || rename(tmpPath.c_str(), outputPath) != 0)
+		warn("cannot write %s", outputPath);
+}
+
+int main(int argc, char *argv[])
+{
+	CommandLineParser cl(argc, argv);
+
+	// Receive signals through a file descriptor. The mask is inherited by
+	// children, InstanceScheduler restores it before exec'ing them
+	sigset_t mask;
+	sigemptyset(&mask);
+	sigaddset(&mask, SIGCHLD);
+	sigaddset(&mask, SIGINT);
+	sigaddset(&mask, SIGTERM);
+	sigaddset(&mask, SIGUSR1);
+	if (sigprocmask(SIG_BLOCK, &mask, nullptr) != 0)
+		err(EXIT_FAILURE, "sigprocmask failed");
+
+	int sfd = signalfd(-1, &mask, SFD_CLOEXEC);
+	if (sfd == -1)
+		err(EXIT_FAILURE, "signalfd failed");
+
+	InstanceScheduler sched(cl.cores, cl.realtimePriority);
+	CoreUsage usage(cl.cores);
+	usage.sample();
+
+	const double startTime = now();
+	double lastSample = startTime;
+
+	char *line = nullptr;
+	size_t lineSize = 0;
+	while (getline(&line, &lineSize, stdin) != -1)
+	{
+		if (line[0] == '\n' || line[0] == '\0')
+			continue;
+
+		std::vector<std::string> fields = splitFields(line);
+		if (fields.size() < 3)
+			errx(EXIT_FAILURE, "invalid instance line: %s", line);
+
+		sched.launch(fields[0], fields[1], std::vector<std::string>(fields.begin() + 2, fields.end()));
+	}
+	free(line);
+
+	if (sched.runningCount() == 0)
+		errx(EXIT_FAILURE, "no instances to launch");
+
+	bool terminating = false;
+	while (sched.runningCount() != 0)
+	{
+		int timeout = -1;
+		double nextSample = lastSample + cl.rebalanceInterval;
+		if (cl.rebalanceInterval != 0 && !terminating)
+			timeout = std::max(0, (int)((nextSample - now()) * 1000) + 1);
+
+		pollfd pfd = { sfd, POLLIN, 0 };
+		if (poll(&pfd, 1, timeout) == -1)
+			err(EXIT_FAILURE, "poll failed");
+
+		bool dumpRequested = false;
+		if (pfd.revents & POLLIN)
+		{
+			signalfd_siginfo si;
+			if (read(sfd, &si, sizeof(si)) != sizeof(si))
+				err(EXIT_FAILURE, "read from signalfd failed");
+
+			switch (si.ssi_signo)
+			{
+				case SIGCHLD:
+				{
+					// Several terminations can be coalesced into one signal
+					pid_t pid;
+					int status;
+					while ((pid = waitpid(-1, &status, WNOHANG)) > 0)
+						sched.childExited(pid, status);
+					break;
+				}
+				case SIGINT:
+				case SIGTERM:
+					terminating = true;
+					sched.terminateAll();
+					break;
+				case SIGUSR1:
+					dumpRequested = true;
+					break;
+			}
+		}
+
+		const bool periodic = !terminating && cl.rebalanceInterval != 0 && now() >= nextSample;
+		if (periodic || dumpRequested)
+		{
+			double t = now();
+			usage.sample();
+			sched.updateLoads(t - lastSample);
+			lastSample = t;
+
+			if (periodic)
+				sched.rebalance();
+
+			if (cl.statsOutputPath != nullptr)
+				dumpStats(cl.statsOutputPath, t - startTime, sched, usage);
+		}
+	}
+
+	return terminating ? EXIT_SUCCESS : EXIT_FAILURE;
+}
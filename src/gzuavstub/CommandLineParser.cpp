@@ -0,0 +1,109 @@
+#include "CommandLineParser.h"
+
+#include <getopt.h>
+#include <err.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+enum
+{
+	OPT_UDS = 256,
+	OPT_STEP_SIZE,
+	OPT_SPACING,
+	OPT_MOTORS,
+};
+
+static option long_options[] =
+{
+	{ "help", no_argument, nullptr, 'h' },
+	{ "uds", required_argument, nullptr, OPT_UDS },
+	{ "step-size", required_argument, nullptr, OPT_STEP_SIZE },
+	{ "spacing", required_argument, nullptr, OPT_SPACING },
+	{ "motors", required_argument, nullptr, OPT_MOTORS },
+	{ nullptr, 0, nullptr, 0 }
+};
+
+static void showHelp()
+{
+	fprintf(stderr, "Usage: %s [options] uav_names...\n", program_invocation_name);
+	fprintf(stderr, "\n");
+	fprintf(stderr, "This program stands in for gzserver and GzUavVehiclePlugin: it connects to\n");
+	fprintf(stderr, "gzuavchannel once per UAV and simulates each UAV as a point mass whose\n");
+	fprintf(stderr, "vertical thrust is given by the received motor commands.\n");
+	fprintf(stderr, "\n");
+	fprintf(stderr, "Options:\n");
+	fprintf(stderr, " --uds PATH: Unix Domain socket of gzuavchannel (default: $GZUAV_UDS).\n");
+	fprintf(stderr, " --step-size SECONDS: Simulated time per tick (default: 0.001).\n");
+	fprintf(stderr, " --spacing METERS: Distance between adjacent UAVs, which start on a square\n");
+	fprintf(stderr, "                   grid (default: 2).\n");
+	fprintf(stderr, " --motors N: Number of motor commands that contribute to thrust (default: 4).\n");
+	fprintf(stderr, "\n");
+
+	exit(EXIT_FAILURE);
+}
+
+static double parsePositiveDouble(const char *text, const char *optname)
+{
+	char *endp;
+	double value = strtod(text, &endp);
+	if (*text == '\0' || *endp != '\0' || value <= 0)
+		errx(EXIT_FAILURE, "option '%s' has invalid format", optname);
+	return value;
+}
+
+CommandLineParser::CommandLineParser(int argc, char *argv[])
+{
+	udsPath = getenv("GZUAV_UDS");
+	stepSize = 0.001;
+	spacing = 2;
+	motorCount = 4;
+
+	bool help_requested = false;
+
+	while (true)
+	{
+		int c, option_index = 0;
+		c = getopt_long(argc, argv, "+h", long_options, &option_index);
+
+		if (c == -1) // end of options
+			break;
+
+		switch (c)
+		{
+			case '?':
+			case ':':
+				// getopt() has already printed an error message
+				exit(EXIT_FAILURE);
+			case 'h':
+				help_requested = true;
+				break;
+			case OPT_UDS:
+				udsPath = optarg;
+				break;
+			case OPT_STEP_SIZE:
+				stepSize = parsePositiveDouble(optarg, long_options[option_index].name);
+				break;
+			case OPT_SPACING:
+				spacing = parsePositiveDouble(optarg, long_options[option_index].name);
+				break;
+			case OPT_MOTORS:
+				motorCount = atoi(optarg);
+				if (motorCount < 1 || motorCount > 16)
+					errx(EXIT_FAILURE, "option '%s' has invalid format", long_options[option_index].name);
+				break;
+		}
+	}
+
+	if (help_requested)
+		showHelp();
+
+	if (udsPath == nullptr)
+		errx(EXIT_FAILURE, "option 'uds' is required if GZUAV_UDS is not set");
+
+	if (optind == argc)
+		errx(EXIT_FAILURE, "at least one UAV name is required");
+
+	for (int i = optind; i < argc; i++)
+		uavNames.emplace_back(argv[i]);
+}
@@ -0,0 +1,19 @@
+#ifndef COMMANDLINEPARSER_H
+#define COMMANDLINEPARSER_H
+
+#include <string>
+#include <vector>
+
+struct CommandLineParser
+{
+	CommandLineParser(int argc, char *argv[]);
+
+	const char *udsPath;
+	double stepSize; // seconds
+	double spacing; // meters between adjacent UAVs in the initial grid
+	int motorCount;
+
+	std::vector<std::string> uavNames;
+};
+
+#endif // COMMANDLINEPARSER_H
@@ -0,0 +1,139 @@
+#include "Fleet.h"
+
+#include <math.h>
+
+#include <algorithm>
+
+#define GRAVITY 9.80665 // m/s^2
+#define MASS 1.5 // kg
+#define DRAG 0.3 // 1/s
+#define THRUST_TO_WEIGHT 4 // at full throttle
+
+Fleet::Fleet(size_t count, double spacing, int motorCount)
+: m_count(count), m_motorCount(motorCount),
+  m_posN(count), m_posE(count), m_posD(count, 0.0),
+  m_velN(count, 0.0), m_velE(count, 0.0), m_velD(count, 0.0),
+  m_accN(count, 0.0), m_accE(count, 0.0), m_accD(count, -GRAVITY),
+  m_thrust(count, 0.0),
+  m_gimbalRoll(count, 0.0), m_gimbalPitch(count, 0.0), m_gimbalYaw(count, 0.0)
+{
+	size_t side = ceil(sqrt(count));
+
+	for (size_t i = 0; i < count; i++)
+	{
+		m_posN[i] = (i / side) * spacing;
+		m_posE[i] = (i % side) * spacing;
+	}
+}
+
+size_t Fleet::count() const
+{
+	return m_count;
+}
+
+void Fleet::applyCommands(size_t uav_num, const GzUavProtocol::EndTick &cmd)
+{
+	double thrust = 0;
+	for (int i = 0; i < m_motorCount; i++)
+	{
+		double c = std::min(std::max((double)cmd.motorCommands[i], 0.0), 1.0);
+		thrust += c * c;
+	}
+
+	// The thrust/weight ratio at full throttle does not depend on the number
+	// of motors
+	m_thrust[uav_num] = thrust / m_motorCount * THRUST_TO_WEIGHT * MASS * GRAVITY;
+
+	m_gimbalRoll[uav_num] = cmd.gimbalRPY[0];
+	m_gimbalPitch[uav_num] = cmd.gimbalRPY[1];
+	m_gimbalYaw[uav_num] = cmd.gimbalRPY[2];
+}
+
+void Fleet::sample(size_t uav_num, double timestamp, GzUavProtocol::BeginTick *out) const
+{
+	GzUavProtocol::PoseSample &p = out->vehiclePose;
+
+	out->timestamp = timestamp;
+
+	// Gazebo world frame is North, West, Up
+	p.positionXYZ_world[0] = m_posN[uav_num];
+	p.positionXYZ_world[1] = -m_posE[uav_num];
+	p.positionXYZ_world[2] = -m_posD[uav_num];
+
+	p.imuAngularVelocityRPY[0] = 0;
+	p.imuAngularVelocityRPY[1] = 0;
+	p.imuAngularVelocityRPY[2] = 0;
+
+	// Body frame is aligned with NED
+	p.imuLinearAccelerationXYZ[0] = m_accN[uav_num];
+	p.imuLinearAccelerationXYZ[1] = m_accE[uav_num];
+	p.imuLinearAccelerationXYZ[2] = m_accD[uav_num];
+
+	p.imuOrientationQuat[0] = 1;
+	p.imuOrientationQuat[1] = 0;
+	p.imuOrientationQuat[2] = 0;
+	p.imuOrientationQuat[3] = 0;
+
+	p.velocityXYZ[0] = m_velN[uav_num];
+	p.velocityXYZ[1] = m_velE[uav_num];
+	p.velocityXYZ[2] = m_velD[uav_num];
+
+	p.positionXYZ[0] = m_posN[uav_num];
+	p.positionXYZ[1] = m_posE[uav_num];
+	p.positionXYZ[2] = m_posD[uav_num];
+
+	out->gimbalRPY[0] = m_gimbalRoll[uav_num];
+	out->gimbalRPY[1] = m_gimbalPitch[uav_num];
+	out->gimbalRPY[2] = m_gimbalYaw[uav_num];
+}
+
+void Fleet::step(double dt)
+{
+	// Keep all arrays' data in local pointers, so that the compiler does not
+	// have to assume that they alias each other
+	double * __restrict__ posN = m_posN.data();
+	double * __restrict__ posE = m_posE.data();
+	double * __restrict__ posD = m_posD.data();
+	double * __restrict__ velN = m_velN.data();
+	double * __restrict__ velE = m_velE.data();
+	double * __restrict__ velD = m_velD.data();
+	double * __restrict__ accN = m_accN.data();
+	double * __restrict__ accE = m_accE.data();
+	double * __restrict__ accD = m_accD.data();
+	const double * __restrict__ thrust = m_thrust.data();
+	const size_t n = m_count;
+
+	// Horizontal motion: drag only
+	for (size_t i = 0; i < n; i++)
+	{
+		double aN = -DRAG * velN[i];
+		double aE = -DRAG * velE[i];
+
+		velN[i] += aN * dt;
+		velE[i] += aE * dt;
+		posN[i] += velN[i] * dt;
+		posE[i] += velE[i] * dt;
+		accN[i] = aN;
+		accE[i] = aE;
+	}
+
+	// Vertical motion: thrust points up (negative D), ground is at D = 0
+	for (size_t i = 0; i < n; i++)
+	{
+		double prevVel = velD[i];
+		double a = GRAVITY - thrust[i] / MASS - DRAG * prevVel;
+		double v = prevVel + a * dt;
+		double d = posD[i] + v * dt;
+
+		// Branch-free ground contact: clamp position and downward velocity
+		double onGround = (d >= 0) ? 1.0 : 0.0;
+		v = v * (1 - onGround) + std::min(v, 0.0) * onGround;
+		d = std::min(d, 0.0);
+
+		velD[i] = v;
+		posD[i] = d;
+
+		// The IMU measures acceleration minus gravity
+		accD[i] = (v - prevVel) / dt - GRAVITY;
+	}
+}
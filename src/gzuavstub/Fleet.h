@@ -0,0 +1,50 @@
+#ifndef FLEET_H
+#define FLEET_H
+
+#include "GzUav/Protocol.h"
+
+#include <stddef.h>
+#include <vector>
+
+/* Point-mass model of a fleet of multirotors.
+ *
+ * Each UAV is always level and pointing north, and it is only subject to
+ * gravity, linear drag and vertical thrust. Thrust grows with the square of
+ * each motor command, so that hovering requires commands of about 0.5.
+ *
+ * State is stored as one array per quantity, so that step() processes all
+ * UAVs with simple loops that the compiler can vectorize.
+ */
+class Fleet
+{
+	public:
+		// UAVs start on the ground, on a square grid with the given spacing
+		Fleet(size_t count, double spacing, int motorCount);
+
+		size_t count() const;
+
+		void applyCommands(size_t uav_num, const GzUavProtocol::EndTick &cmd);
+		void sample(size_t uav_num, double timestamp, GzUavProtocol::BeginTick *out) const;
+
+		// Advance simulation time by dt seconds
+		void step(double dt);
+
+	private:
+		size_t m_count;
+		int m_motorCount;
+
+		// NED position and velocity
+		std::vector<double> m_posN, m_posE, m_posD;
+		std::vector<double> m_velN, m_velE, m_velD;
+
+		// Specific force measured by the IMU in the last step
+		std::vector<double> m_accN, m_accE, m_accD;
+
+		// Current thrust
+		std::vector<double> m_thrust;
+
+		// Gimbal is assumed to reach its setpoint instantly
+		std::vector<double> m_gimbalRoll, m_gimbalPitch, m_gimbalYaw;
+};
+
+#endif // FLEET_H
@@ -0,0 +1,148 @@
+#include "CommandLineParser.h"
+#include "Fleet.h"
+
+#include <err.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <vector>
+
+// Send a message made of a GzUavProtocol header and a payload
+static void sendMessage(int sock, GzUavProtocol::PacketType type, uint16_t uavId, const void *data, size_t len)
+{
+	GzUavProtocol::Header h = GzUavProtocol::makeHeader(type, uavId, len);
+
+	struct iovec iov[2];
+	iov[0].iov_base = &h;
+	iov[0].iov_len = sizeof(h);
+	iov[1].iov_base = const_cast<void*>(data);
+	iov[1].iov_len = len;
+
+	struct msghdr mh;
+	memset(&mh, 0, sizeof(mh));
+	mh.msg_iov = iov;
+	mh.msg_iovlen = 2;
+
+	if (sendmsg(sock, &mh, MSG_NOSIGNAL) != (ssize_t)(sizeof(h) + len))
+		err(EXIT_FAILURE, "send failed");
+}
+
+// Receive a message of the given type and payload size, or exit if
+// gzuavchannel closed the connection
+static void recvMessage(int sock, GzUavProtocol::PacketType type, void *data, size_t len)
+{
+	char buf[sizeof(GzUavProtocol::Header) + len];
+	ssize_t r = recv(sock, buf, sizeof(buf), 0);
+
+	if (r == 0)
+	{
+		warnx("Connection closed by gzuavchannel");
+		exit(EXIT_SUCCESS);
+	}
+	else if (r < 0)
+	{
+		err(EXIT_FAILURE, "recv failed");
+	}
+
+	GzUavProtocol::Header h;
+	memcpy(&h, buf, std::min(sizeof(h), (size_t)r));
+	if (!GzUavProtocol::isValidMessage(buf, r) || h.type != type || h.length != len)
+		errx(EXIT_FAILURE, "received invalid packet");
+
+	memcpy(data, buf + sizeof(h), len);
+}
+
+// Connect to gzuavchannel and perform the HELLO handshake, like
+// GzUavVehiclePlugin::Load does
+static int connectUav(const char *udsPath, const std::string &uavName, uint16_t *uavId, uint32_t *caps)
+{
+	struct sockaddr_un addr;
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	strncpy(addr.sun_path, udsPath, sizeof(addr.sun_path) - 1);
+
+	int sock = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+	if (sock == -1)
+		err(EXIT_FAILURE, "socket failed");
+
+	if (connect(sock, (struct sockaddr*)&addr, sizeof(addr)) == -1)
+		err(EXIT_FAILURE, "connect to %s failed", udsPath);
+
+	std::vector<char> hello(sizeof(GzUavProtocol::Hello));
+	GzUavProtocol::Hello *h = (GzUavProtocol::Hello*)hello.data();
+	h->caps = GzUavProtocol::SUPPORTED_CAPS;
+	h->role = GzUavProtocol::ROLE_SIMULATOR;
+	hello.insert(hello.end(), uavName.begin(), uavName.end());
+	sendMessage(sock, GzUavProtocol::PKT_HELLO, 0, hello.data(), hello.size());
+
+	GzUavProtocol::HelloAck ack;
+	recvMessage(sock, GzUavProtocol::PKT_HELLO_ACK, &ack, sizeof(ack));
+	*uavId = ack.uavId;
+	*caps = ack.caps;
+
+	return sock;
+}
+
+int main(int argc, char *argv[])
+{
+	CommandLineParser cl(argc, argv);
+
+	std::vector<int> socks;
+	std::vector<uint16_t> uavIds;
+	std::vector<uint32_t> uavCaps;
+	for (const std::string &name : cl.uavNames)
+	{
+		uint16_t uavId;
+		uint32_t caps;
+		socks.push_back(connectUav(cl.udsPath, name, &uavId, &caps));
+		uavIds.push_back(uavId);
+		uavCaps.push_back(caps);
+	}
+
+	warnx("%zu UAVs connected", socks.size());
+
+	Fleet fleet(socks.size(), cl.spacing, cl.motorCount);
+	double simTime = 0;
+
+	while (true)
+	{
+		// Receive END-TICK packets
+		for (size_t i = 0; i < socks.size(); i++)
+		{
+			GzUavProtocol::EndTick endTickPkt;
+			recvMessage(socks[i], GzUavProtocol::PKT_END_TICK, &endTickPkt, sizeof(endTickPkt));
+
+			fleet.applyCommands(i, endTickPkt);
+		}
+
+		// Like gzserver, increment the simulation time before the
+		// plugin's update callbacks, and run the physics after them
+		simTime += cl.stepSize;
+
+		// Send BEGIN-TICK packets
+		for (size_t i = 0; i < socks.size(); i++)
+		{
+			GzUavProtocol::BeginTick beginTickPkt;
+			fleet.sample(i, simTime, &beginTickPkt);
+
+			if (uavCaps[i] & GzUavProtocol::CAP_COMPACT_BEGIN_TICK)
+			{
+				GzUavProtocol::CompactBeginTick compactPkt;
+				GzUavProtocol::compactBeginTick(beginTickPkt, &compactPkt);
+				sendMessage(socks[i], GzUavProtocol::PKT_BEGIN_TICK, uavIds[i], &compactPkt, sizeof(compactPkt));
+			}
+			else
+			{
+				sendMessage(socks[i], GzUavProtocol::PKT_BEGIN_TICK, uavIds[i], &beginTickPkt, sizeof(beginTickPkt));
+			}
+		}
+
+		fleet.step(cl.stepSize);
+	}
+}
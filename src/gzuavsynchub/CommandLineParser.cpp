@@ -0,0 +1,92 @@
+#include "CommandLineParser.h"
+
+#include <getopt.h>
+#include <err.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+enum
+{
+	OPT_LISTEN_TCP = 256,
+	OPT_LISTEN_UDS,
+};
+
+static option long_options[] =
+{
+	{ "help", no_argument, nullptr, 'h' },
+	{ "listen-tcp", required_argument, nullptr, OPT_LISTEN_TCP },
+	{ "listen-uds", required_argument, nullptr, OPT_LISTEN_UDS },
+	{ nullptr, 0, nullptr, 0 }
+};
+
+static void showHelp()
+{
+	fprintf(stderr, "Usage: %s [options] upstream_ip:port\n", program_invocation_name);
+	fprintf(stderr, "\n");
+	fprintf(stderr, "This program subscribes to phase 0 of an external synchronization server\n");
+	fprintf(stderr, "(see gzuavchannel's --external-sync-server option) as a single client, and\n");
+	fprintf(stderr, "serves the same protocol to local subscribers. Each BEGIN-TICK is forwarded\n");
+	fprintf(stderr, "to all local subscribers, and one END-TICK is sent upstream when all of them\n");
+	fprintf(stderr, "have replied.\n");
+	fprintf(stderr, "\n");
+	fprintf(stderr, "Only phase 0 subscriptions are accepted. Subscribers that connect while a\n");
+	fprintf(stderr, "tick is in progress join from the next one.\n");
+	fprintf(stderr, "\n");
+	fprintf(stderr, "\"GZUAVSYNCHUB:LISTENING\" is printed on stdout once subscribers can connect.\n");
+	fprintf(stderr, "\n");
+	fprintf(stderr, "Options:\n");
+	fprintf(stderr, " --listen-tcp PORT: Accept subscribers on this TCP port.\n");
+	fprintf(stderr, " --listen-uds PATH: Accept subscribers on this Unix Domain socket\n");
+	fprintf(stderr, "                    (SOCK_STREAM).\n");
+	fprintf(stderr, "\n");
+	fprintf(stderr, "At least one of --listen-tcp and --listen-uds must be given.\n");
+	fprintf(stderr, "\n");
+
+	exit(EXIT_FAILURE);
+}
+
+CommandLineParser::CommandLineParser(int argc, char *argv[])
+{
+	listenTcpPort = 0;
+	listenUdsPath = nullptr;
+
+	bool help_requested = false;
+
+	while (true)
+	{
+		int c, option_index = 0;
+		c = getopt_long(argc, argv, "+h", long_options, &option_index);
+
+		if (c == -1) // end of options
+			break;
+
+		switch (c)
+		{
+			case '?':
+			case ':':
+				// getopt() has already printed an error message
+				exit(EXIT_FAILURE);
+			case 'h':
+				help_requested = true;
+				break;
+			case OPT_LISTEN_TCP:
+				listenTcpPort = atoi(optarg);
+				if (listenTcpPort < 1 || listenTcpPort > 65535)
+					errx(EXIT_FAILURE, "option '%s' has invalid format", long_options[option_index].name);
+				break;
+			case OPT_LISTEN_UDS:
+				listenUdsPath = optarg;
+				break;
+		}
+	}
+
+	if (help_requested || optind + 1 != argc)
+		showHelp();
+
+	if (listenTcpPort == 0 && listenUdsPath == nullptr)
+		errx(EXIT_FAILURE, "no listening socket specified");
+
+	upstreamTarget = argv[optind];
+}
@@ -0,0 +1,13 @@
+#ifndef COMMANDLINEPARSER_H
+#define COMMANDLINEPARSER_H
+
+struct CommandLineParser
+{
+	CommandLineParser(int argc, char *argv[]);
+
+	const char *upstreamTarget; // IP:PORT of the ExternalSyncServer
+	int listenTcpPort; // 0 = do not listen on TCP
+	const char *listenUdsPath; // nullptr = do not listen on a Unix socket
+};
+
+#endif // COMMANDLINEPARSER_H
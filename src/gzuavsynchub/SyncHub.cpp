@@ -0,0 +1,286 @@
+#include "SyncHub.h"
+
+#include <arpa/inet.h>
+#include <err.h>
+#include <errno.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <string>
+
+static bool isValidPort(int n)
+{
+	if (n < 1 || n > 65535)
+		return false;
+	else
+		return true;
+}
+
+static bool sendAll(int fd, const void *buf, size_t len)
+{
+	while (len != 0)
+	{
+		int r = send(fd, buf, len, MSG_NOSIGNAL);
+		if (r <= 0)
+			return false;
+
+		buf = r + (const char*)buf;
+		len -= r;
+	}
+
+	return true;
+}
+
+// Disable TCP outgoing data buffering (no-op on Unix sockets)
+static void setNoDelay(int fd)
+{
+	int optval = 1;
+	setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &optval, sizeof(optval));
+}
+
+SyncHub::SyncHub(const char *upstreamTarget, int listenTcpPort, const char *listenUdsPath)
+: m_tcpServ(-1), m_udsServ(-1), m_udsPath(listenUdsPath), m_recvBufferLen(0),
+  m_tickOngoing(false), m_pendingAcks(0)
+{
+	// Connect to the upstream server and subscribe to phase 0
+	struct sockaddr_in addr;
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+
+	const char *colon = strrchr(upstreamTarget, ':');
+	if (colon == nullptr || colon == upstreamTarget
+		|| !isValidPort(atoi(colon + 1))
+		|| inet_pton(AF_INET, std::string(upstreamTarget, colon).c_str(), &addr.sin_addr) != 1)
+	{
+		errx(EXIT_FAILURE, "SyncHub: invalid upstream address or port number");
+	}
+
+	addr.sin_port = htons(atoi(colon + 1));
+
+	m_upstream = socket(AF_INET, SOCK_STREAM, 0);
+	if (connect(m_upstream, (struct sockaddr*)&addr, sizeof(addr)) < 0)
+		err(EXIT_FAILURE, "SyncHub: connect(%s) failed", upstreamTarget);
+
+	setNoDelay(m_upstream);
+
+	const char subscribePhase = 0;
+	if (!sendAll(m_upstream, &subscribePhase, 1))
+		err(EXIT_FAILURE, "SyncHub: failed to subscribe to upstream server");
+
+	// Create listening sockets
+	if (listenTcpPort != 0)
+	{
+		m_tcpServ = socket(AF_INET, SOCK_STREAM, 0);
+
+		int optval = 1;
+		setsockopt(m_tcpServ, SOL_SOCKET, SO_REUSEADDR, &optval, sizeof(optval));
+
+		memset(&addr, 0, sizeof(addr));
+		addr.sin_family = AF_INET;
+		addr.sin_addr.s_addr = htonl(INADDR_ANY);
+		addr.sin_port = htons(listenTcpPort);
+
+		if (bind(m_tcpServ, (struct sockaddr*)&addr, sizeof(addr)) < 0)
+			err(EXIT_FAILURE, "SyncHub: bind(%d) failed", listenTcpPort);
+
+		listen(m_tcpServ, 1000);
+	}
+
+	if (listenUdsPath != nullptr)
+	{
+		struct sockaddr_un uaddr;
+		memset(&uaddr, 0, sizeof(uaddr));
+		uaddr.sun_family = AF_UNIX;
+		if (strlen(listenUdsPath) >= sizeof(uaddr.sun_path))
+			errx(EXIT_FAILURE, "SyncHub: socket path is too long");
+		strcpy(uaddr.sun_path, listenUdsPath);
+
+		m_udsServ = socket(AF_UNIX, SOCK_STREAM, 0);
+		unlink(listenUdsPath);
+
+		if (bind(m_udsServ, (struct sockaddr*)&uaddr, sizeof(uaddr)) < 0)
+			err(EXIT_FAILURE, "SyncHub: bind(%s) failed", listenUdsPath);
+
+		listen(m_udsServ, 1000);
+	}
+}
+
+SyncHub::~SyncHub()
+{
+	for (const Client &c : m_clients)
+		close(c.fd);
+
+	if (m_tcpServ != -1)
+		close(m_tcpServ);
+
+	if (m_udsServ != -1)
+	{
+		close(m_udsServ);
+		unlink(m_udsPath);
+	}
+
+	close(m_upstream);
+}
+
+void SyncHub::run()
+{
+	std::vector<pollfd> pfds;
+
+	while (true)
+	{
+		// Upstream does not send the next BEGIN-TICK before our END-TICK,
+		// so it is only polled between ticks
+		pfds.clear();
+		pfds.push_back({ m_tickOngoing ? -1 : m_upstream, POLLIN, 0 });
+		pfds.push_back({ m_tcpServ, POLLIN, 0 });
+		pfds.push_back({ m_udsServ, POLLIN, 0 });
+		for (const Client &c : m_clients)
+			pfds.push_back({ c.fd, POLLIN, 0 });
+
+		if (poll(pfds.data(), pfds.size(), -1) == -1)
+		{
+			if (errno == EINTR)
+				continue;
+			err(EXIT_FAILURE, "SyncHub: poll failed");
+		}
+
+		// Subscribers accepted below are appended to m_clients, after the
+		// ones that have been polled
+		const size_t numPolledClients = m_clients.size();
+
+		for (size_t i = 0; i < numPolledClients; i++)
+		{
+			if (pfds[3 + i].revents != 0)
+				handleClient(m_clients[i]);
+		}
+
+		if (pfds[1].revents != 0)
+			acceptClients(m_tcpServ);
+
+		if (pfds[2].revents != 0)
+			acceptClients(m_udsServ);
+
+		m_clients.erase(std::remove_if(m_clients.begin(), m_clients.end(),
+			[](const Client &c) { return c.fd == -1; }), m_clients.end());
+
+		if (pfds[0].revents != 0)
+			handleUpstream();
+
+		endTickIfComplete();
+	}
+}
+
+void SyncHub::acceptClients(int serv)
+{
+	int fd = accept(serv, nullptr, nullptr);
+	if (fd < 0)
+	{
+		warn("SyncHub: accept failed");
+		return;
+	}
+
+	setNoDelay(fd);
+	m_clients.push_back({ fd, CLIENT_SUBSCRIBING });
+}
+
+void SyncHub::handleClient(Client &c)
+{
+	char data;
+	if (recv(c.fd, &data, 1, 0) != 1)
+	{
+		warnx("SyncHub: subscriber disconnected");
+		removeClient(c);
+		return;
+	}
+
+	switch (c.state)
+	{
+		case CLIENT_SUBSCRIBING:
+			if (data != 0)
+			{
+				warnx("SyncHub: only phase 0 subscriptions are supported");
+				removeClient(c);
+				return;
+			}
+
+			warnx("SyncHub: new connection subscribed to phase 0");
+			c.state = CLIENT_IDLE;
+			break;
+		case CLIENT_IDLE:
+			warnx("SyncHub: unexpected END-TICK, removing subscriber");
+			removeClient(c);
+			break;
+		case CLIENT_IN_TICK:
+			c.state = CLIENT_IDLE;
+			m_pendingAcks--;
+			break;
+	}
+}
+
+void SyncHub::removeClient(Client &c)
+{
+	if (c.state == CLIENT_IN_TICK)
+		m_pendingAcks--;
+
+	close(c.fd);
+	c.fd = -1;
+}
+
+void SyncHub::handleUpstream()
+{
+	int r = recv(m_upstream, m_recvBuffer + m_recvBufferLen, sizeof(m_recvBuffer) - m_recvBufferLen, 0);
+	if (r <= 0)
+		errx(EXIT_FAILURE, "SyncHub: upstream connection closed");
+
+	m_recvBufferLen += r;
+	if (m_recvBufferLen == sizeof(m_recvBuffer))
+	{
+		m_recvBufferLen = 0;
+		beginTick();
+	}
+}
+
+void SyncHub::beginTick()
+{
+	m_tickOngoing = true;
+
+	for (Client &c : m_clients)
+	{
+		if (c.state != CLIENT_IDLE)
+			continue;
+
+		if (sendAll(c.fd, m_recvBuffer, sizeof(m_recvBuffer)))
+		{
+			c.state = CLIENT_IN_TICK;
+			m_pendingAcks++;
+		}
+		else
+		{
+			warnx("SyncHub: failed to send BEGIN-TICK, removing subscriber");
+			removeClient(c);
+		}
+	}
+
+	m_clients.erase(std::remove_if(m_clients.begin(), m_clients.end(),
+		[](const Client &c) { return c.fd == -1; }), m_clients.end());
+}
+
+void SyncHub::endTickIfComplete()
+{
+	if (!m_tickOngoing || m_pendingAcks != 0)
+		return;
+
+	const char ack = '!';
+	if (!sendAll(m_upstream, &ack, 1))
+		errx(EXIT_FAILURE, "SyncHub: failed to send END-TICK upstream");
+
+	m_tickOngoing = false;
+}
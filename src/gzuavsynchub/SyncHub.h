@@ -0,0 +1,61 @@
+#ifndef SYNCHUB_H
+#define SYNCHUB_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <vector>
+
+/* Multiplexes local phase 0 subscribers on a single ExternalSyncServer
+ * connection.
+ *
+ * The protocol is the same on both sides: the subscriber sends a 0 byte to
+ * subscribe, then it receives each BEGIN-TICK as an 8-byte timestamp and
+ * replies with a 1-byte END-TICK. */
+class SyncHub
+{
+	public:
+		SyncHub(const char *upstreamTarget, int listenTcpPort, const char *listenUdsPath);
+		~SyncHub();
+
+		// Never returns, the process exits when the upstream connection
+		// is closed
+		void run();
+
+	private:
+		enum ClientState
+		{
+			CLIENT_SUBSCRIBING, // waiting for the subscription byte
+			CLIENT_IDLE,        // waiting for the next BEGIN-TICK
+			CLIENT_IN_TICK,     // waiting for the END-TICK
+		};
+
+		struct Client
+		{
+			int fd; // -1 after removal
+			ClientState state;
+		};
+
+		void acceptClients(int serv);
+		void handleClient(Client &c);
+		void removeClient(Client &c);
+
+		void handleUpstream();
+		void beginTick();
+		void endTickIfComplete();
+
+		int m_upstream;
+		int m_tcpServ, m_udsServ; // -1 if not in use
+		const char *m_udsPath;
+
+		std::vector<Client> m_clients;
+
+		// Partially received timestamp
+		uint8_t m_recvBuffer[sizeof(double)];
+		size_t m_recvBufferLen;
+
+		bool m_tickOngoing;
+		size_t m_pendingAcks;
+};
+
+#endif // SYNCHUB_H
@@ -0,0 +1,18 @@
+#include "CommandLineParser.h"
+#include "SyncHub.h"
+
+#include <stdio.h>
+
+int main(int argc, char *argv[])
+{
+	CommandLineParser cl(argc, argv);
+
+	// Ensure output is not fully buffered, so that status updates can be
+	// received without delays
+	setlinebuf(stdout);
+
+	SyncHub hub(cl.upstreamTarget, cl.listenTcpPort, cl.listenUdsPath);
+	printf("GZUAVSYNCHUB:LISTENING\n");
+
+	hub.run();
+}
@@ -0,0 +1,225 @@
+#ifndef GZUAV_PROTOCOL_H
+#define GZUAV_PROTOCOL_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+/* Wire protocol between the simulator (GzUavVehiclePlugin, gzuavstub),
+ * gzuavchannel and the autopilot (ArduCopter).
+ *
+ * This header only depends on the C library, so that it can be used by all
+ * the programs that speak the protocol.
+ *
+ * Each UAV has its own SOCK_SEQPACKET connection to gzuavchannel. The first
+ * message on a connection is a HELLO from the peer, that gzuavchannel
+ * answers with a HELLO-ACK. Then, the simulator sends a BEGIN-TICK at the
+ * beginning of each step and waits for the autopilot's END-TICK, which
+ * gzuavchannel forwards back. Each message is a Header followed by a
+ * payload of Header::length bytes.
+ *
+ * Peers that predate this protocol (legacy peers) send their UAV name as a
+ * bare string instead of a HELLO, and then raw payloads without headers.
+ * gzuavchannel tells them apart by the magic number, whose bytes are not
+ * printable characters, and keeps talking the legacy protocol with them.
+ * Version 1 payloads have the same layout as legacy packets, unless a
+ * capability that changes them has been negotiated.
+ *
+ * All fields are little-endian and all structures have a fixed layout
+ * without implicit padding.
+ *
+ * The TCP hop between two gzuavchannel instances is different: it starts
+ * with a TcpHello in each direction (in network byte order) and carries
+ * payloads framed by gzuavchannel itself.
+ *
+ * Capabilities are negotiated independently on each connection and on each
+ * TCP hop. gzuavchannel converts payloads between the encodings used on its
+ * two sides, and always handles full BeginTick payloads internally.
+ */
+
+#if __BYTE_ORDER__ != __ORDER_LITTLE_ENDIAN__
+#error "GzUav protocol structures are only supported on little-endian hosts"
+#endif
+
+namespace GzUavProtocol
+{
+
+const uint16_t MAGIC = 0xd7a6; // sent as a6 d7
+const uint8_t VERSION = 1;
+
+const uint32_t TCP_MAGIC = 0x475a5543; // "GZUC"
+
+enum PacketType : uint8_t
+{
+	PKT_HELLO = 1,      // peer -> gzuavchannel
+	PKT_HELLO_ACK = 2,  // gzuavchannel -> peer
+	PKT_BEGIN_TICK = 3, // simulator -> autopilot
+	PKT_END_TICK = 4,   // autopilot -> simulator
+};
+
+enum PeerRole : uint8_t
+{
+	ROLE_SIMULATOR = 1, // sends BEGIN-TICK, receives END-TICK
+	ROLE_AUTOPILOT = 2, // sends END-TICK, receives BEGIN-TICK
+};
+
+// Optional protocol features, negotiated at connect time
+enum Capability : uint32_t
+{
+	// BEGIN-TICK payloads are CompactBeginTick instead of BeginTick
+	CAP_COMPACT_BEGIN_TICK = 1 << 0,
+};
+
+// Capabilities implemented by this version of the header's users
+const uint32_t SUPPORTED_CAPS = CAP_COMPACT_BEGIN_TICK;
+
+struct Header
+{
+	uint16_t magic;
+	uint8_t version;
+	uint8_t type;     // PacketType
+	uint16_t uavId;   // as assigned in HELLO-ACK, 0 in HELLO
+	uint16_t length;  // payload length, excluding this header
+};
+
+// HELLO payload, followed by the UAV name (without terminator)
+struct Hello
+{
+	uint32_t caps;    // capabilities supported by the peer
+	uint8_t role;     // PeerRole
+	uint8_t reserved[3];
+};
+
+// HELLO-ACK payload (Header::version is the version that will be used)
+struct HelloAck
+{
+	uint32_t caps;    // capabilities enabled on this connection
+	uint16_t uavId;
+	uint16_t reserved;
+};
+
+struct PoseSample
+{
+	double positionXYZ_world[3];        // Gazebo world frame
+	double imuAngularVelocityRPY[3];
+	double imuLinearAccelerationXYZ[3];
+	double imuOrientationQuat[4];
+	double velocityXYZ[3];              // NED
+	double positionXYZ[3];              // NED
+};
+
+#define GZUAV_MAX_MOTORS 16
+
+// BEGIN-TICK payload
+struct BeginTick
+{
+	double timestamp;                   // simulation time, in seconds
+	PoseSample vehiclePose;
+	double gimbalRPY[3];                // yaw=0 is north
+};
+
+// BEGIN-TICK payload if CAP_COMPACT_BEGIN_TICK is enabled: the same fields
+// as BeginTick, in the same order, in single precision. ArduPilot converts
+// them all to float anyway. The timestamp is kept in double precision, as
+// the autopilot computes time steps from it
+struct CompactBeginTick
+{
+	double timestamp;
+	float positionXYZ_world[3];
+	float imuAngularVelocityRPY[3];
+	float imuLinearAccelerationXYZ[3];
+	float imuOrientationQuat[4];
+	float velocityXYZ[3];
+	float positionXYZ[3];
+	float gimbalRPY[3];
+};
+
+// END-TICK payload
+struct EndTick
+{
+	float motorCommands[GZUAV_MAX_MOTORS];
+	float gimbalRPY[3];                 // setpoint, yaw=0 is north
+};
+
+// First message in each direction on the TCP hop
+struct TcpHello
+{
+	uint32_t magic;
+	uint16_t version;
+	uint16_t reserved;
+	uint32_t caps;
+};
+
+static_assert(sizeof(Header) == 8, "Unexpected Header size");
+static_assert(sizeof(Hello) == 8, "Unexpected Hello size");
+static_assert(sizeof(HelloAck) == 8, "Unexpected HelloAck size");
+static_assert(sizeof(PoseSample) == 152, "Unexpected PoseSample size");
+static_assert(sizeof(BeginTick) == 184, "Unexpected BeginTick size");
+static_assert(sizeof(CompactBeginTick) == 96, "Unexpected CompactBeginTick size");
+static_assert(sizeof(EndTick) == 76, "Unexpected EndTick size");
+static_assert(sizeof(TcpHello) == 12, "Unexpected TcpHello size");
+
+inline Header makeHeader(PacketType type, uint16_t uavId, size_t length)
+{
+	Header h;
+	h.magic = MAGIC;
+	h.version = VERSION;
+	h.type = type;
+	h.uavId = uavId;
+	h.length = (uint16_t)length;
+	return h;
+}
+
+// Whether a received message starts with a valid header, whose length
+// matches the message's
+inline bool isValidMessage(const void *data, size_t len)
+{
+	Header h;
+	if (len < sizeof(h))
+		return false;
+
+	memcpy(&h, data, sizeof(h));
+	return h.magic == MAGIC && h.version == VERSION
+		&& h.length == len - sizeof(h);
+}
+
+// Size of the BEGIN-TICK payload with the given capabilities enabled
+inline size_t beginTickSize(uint32_t caps)
+{
+	return (caps & CAP_COMPACT_BEGIN_TICK) ? sizeof(CompactBeginTick) : sizeof(BeginTick);
+}
+
+template<typename To, typename From, size_t N>
+inline void convertArray(To (&dst)[N], const From (&src)[N])
+{
+	for (size_t i = 0; i < N; i++)
+		dst[i] = (To)src[i];
+}
+
+inline void compactBeginTick(const BeginTick &src, CompactBeginTick *dst)
+{
+	dst->timestamp = src.timestamp;
+	convertArray(dst->positionXYZ_world, src.vehiclePose.positionXYZ_world);
+	convertArray(dst->imuAngularVelocityRPY, src.vehiclePose.imuAngularVelocityRPY);
+	convertArray(dst->imuLinearAccelerationXYZ, src.vehiclePose.imuLinearAccelerationXYZ);
+	convertArray(dst->imuOrientationQuat, src.vehiclePose.imuOrientationQuat);
+	convertArray(dst->velocityXYZ, src.vehiclePose.velocityXYZ);
+	convertArray(dst->positionXYZ, src.vehiclePose.positionXYZ);
+	convertArray(dst->gimbalRPY, src.gimbalRPY);
+}
+
+inline void expandBeginTick(const CompactBeginTick &src, BeginTick *dst)
+{
+	dst->timestamp = src.timestamp;
+	convertArray(dst->vehiclePose.positionXYZ_world, src.positionXYZ_world);
+	convertArray(dst->vehiclePose.imuAngularVelocityRPY, src.imuAngularVelocityRPY);
+	convertArray(dst->vehiclePose.imuLinearAccelerationXYZ, src.imuLinearAccelerationXYZ);
+	convertArray(dst->vehiclePose.imuOrientationQuat, src.imuOrientationQuat);
+	convertArray(dst->vehiclePose.velocityXYZ, src.velocityXYZ);
+	convertArray(dst->vehiclePose.positionXYZ, src.positionXYZ);
+	convertArray(dst->gimbalRPY, src.gimbalRPY);
+}
+
+}
+
+#endif // GZUAV_PROTOCOL_H
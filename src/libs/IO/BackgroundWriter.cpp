@@ -0,0 +1,158 @@
+#include "IO/BackgroundWriter.h"
+
+#include <err.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <algorithm>
+
+namespace IO
+{
+
+// How long the writer thread sleeps when the ring is empty. This also lets
+// data accumulate, so that write(2) calls are larger.
+#define IDLE_SLEEP_NS 1000000
+
+BackgroundWriter::BackgroundWriter(int fd, size_t ringSize)
+: m_fd(fd), m_head(0), m_tail(0), m_stop(false), m_error(0), m_errorReported(false)
+{
+	size_t size = 4096;
+	while (size < ringSize)
+		size *= 2;
+
+	m_ring.resize(size);
+	m_mask = size - 1;
+
+	m_thread = std::thread(&BackgroundWriter::threadMain, this);
+}
+
+BackgroundWriter::~BackgroundWriter()
+{
+	m_stop.store(true, std::memory_order_release);
+	m_thread.join();
+
+	// May run from an atexit handler: just warn
+	if (m_error.load(std::memory_order_acquire) != 0 && !m_errorReported)
+	{
+		errno = m_error.load(std::memory_order_relaxed);
+		warn("BackgroundWriter: write failed");
+	}
+
+	close(m_fd);
+}
+
+void BackgroundWriter::reportError()
+{
+	m_errorReported = true;
+	errno = m_error.load(std::memory_order_relaxed);
+	err(EXIT_FAILURE, "BackgroundWriter: write failed");
+}
+
+bool BackgroundWriter::write(const struct iovec *iov, int iovcnt)
+{
+	if (m_error.load(std::memory_order_acquire) != 0)
+		reportError();
+
+	size_t len = 0;
+	for (int i = 0; i < iovcnt; i++)
+		len += iov[i].iov_len;
+
+	uint64_t head = m_head.load(std::memory_order_relaxed);
+	uint64_t tail = m_tail.load(std::memory_order_acquire);
+
+	if (m_ring.size() - (head - tail) < len)
+		return false;
+
+	for (int i = 0; i < iovcnt; i++)
+	{
+		const uint8_t *src = (const uint8_t*)iov[i].iov_base;
+		size_t remaining = iov[i].iov_len;
+
+		while (remaining != 0)
+		{
+			size_t pos = head & m_mask;
+			size_t chunk = std::min(remaining, m_ring.size() - pos);
+
+			memcpy(&m_ring[pos], src, chunk);
+			src += chunk;
+			head += chunk;
+			remaining -= chunk;
+		}
+	}
+
+	m_head.store(head, std::memory_order_release);
+	return true;
+}
+
+bool BackgroundWriter::write(const void *data, size_t len)
+{
+	struct iovec iov = { const_cast<void*>(data), len };
+	return write(&iov, 1);
+}
+
+size_t BackgroundWriter::drain()
+{
+	uint64_t tail = m_tail.load(std::memory_order_relaxed);
+	uint64_t head = m_head.load(std::memory_order_acquire);
+
+	if (head == tail)
+		return 0;
+
+	// The pending data may wrap around the end of the ring
+	size_t pos = tail & m_mask;
+	size_t len = head - tail;
+	struct iovec iov[2];
+	int iovcnt = 1;
+
+	iov[0].iov_base = &m_ring[pos];
+	iov[0].iov_len = std::min(len, m_ring.size() - pos);
+	if (iov[0].iov_len != len)
+	{
+		iov[1].iov_base = &m_ring[0];
+		iov[1].iov_len = len - iov[0].iov_len;
+		iovcnt = 2;
+	}
+
+	ssize_t r;
+	do
+	{
+		r = writev(m_fd, iov, iovcnt);
+	}
+	while (r < 0 && errno == EINTR);
+
+	// Exiting from this thread would run the atexit handlers that destroy
+	// this object: leave it to the owner's thread
+	if (r < 0)
+	{
+		m_error.store(errno, std::memory_order_release);
+		return 0;
+	}
+
+	m_tail.store(tail + r, std::memory_order_release);
+	return r;
+}
+
+void BackgroundWriter::threadMain()
+{
+	while (true)
+	{
+		bool stopRequested = m_stop.load(std::memory_order_acquire);
+
+		if (drain() == 0)
+		{
+			// Exit only after we have seen the stop flag *and* the ring is
+			// empty, so that everything written before the destructor was
+			// called gets to the file
+			if (stopRequested || m_error.load(std::memory_order_relaxed) != 0)
+				break;
+
+			struct timespec ts = { 0, IDLE_SLEEP_NS };
+			nanosleep(&ts, nullptr);
+		}
+	}
+}
+
+}
@@ -0,0 +1,62 @@
+#ifndef IO_BACKGROUNDWRITER_H
+#define IO_BACKGROUNDWRITER_H
+
+#include <atomic>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/uio.h>
+#include <thread>
+#include <vector>
+
+namespace IO
+{
+
+/* Writes data to a file descriptor from a dedicated thread.
+ *
+ * Data is passed to the writer thread through a lock-free single-producer,
+ * single-consumer ring buffer, so that write() never blocks the caller. The
+ * writer thread drains the ring periodically, issuing as few and as large
+ * write(2) calls as possible.
+ *
+ * write() must always be called by the same thread. If write(2) fails, the
+ * writer thread stops and the error is reported by the next write() call (that
+ * terminates the process) or, failing that, by the destructor.
+ */
+class BackgroundWriter
+{
+	public:
+		// ringSize is rounded up to a power of two. The file descriptor is
+		// closed by the destructor, after all pending data has been written.
+		BackgroundWriter(int fd, size_t ringSize);
+		~BackgroundWriter();
+
+		// Enqueue the concatenation of all the given buffers. Either all or
+		// none of them are enqueued: if there is not enough free space in the
+		// ring, nothing is written and false is returned.
+		bool write(const struct iovec *iov, int iovcnt);
+		bool write(const void *data, size_t len);
+
+	private:
+		void threadMain();
+		size_t drain();
+		void reportError();
+
+		int m_fd;
+		std::vector<uint8_t> m_ring;
+		size_t m_mask;
+
+		// Total number of bytes ever written by the producer / consumed by
+		// the writer thread (the difference is the ring's fill level)
+		std::atomic<uint64_t> m_head, m_tail;
+
+		std::atomic<bool> m_stop;
+		std::thread m_thread;
+
+		// errno of the failed write(2) call, or 0
+		std::atomic<int> m_error;
+		bool m_errorReported;
+};
+
+}
+
+#endif // IO_BACKGROUNDWRITER_H
@@ -0,0 +1,33 @@
+#ifndef IO_JSONSTRING_H
+#define IO_JSONSTRING_H
+
+#include <stdio.h>
+#include <string>
+
+namespace IO
+{
+
+/* Writes a string as a quoted JSON string literal, escaping '"' and '\' and
+ * replacing control and non-ASCII bytes with \u escapes, like
+ * MAVLink::FormatWriter does for char arrays.
+ */
+inline void writeJsonString(FILE *fp, const std::string &s)
+{
+	fputc('"', fp);
+
+	for (unsigned char c : s)
+	{
+		if (c == '"' || c == '\\')
+			fprintf(fp, "\\%c", c);
+		else if (c < 0x20 || c >= 0x7f)
+			fprintf(fp, "\\u%04x", c);
+		else
+			fputc(c, fp);
+	}
+
+	fputc('"', fp);
+}
+
+}
+
+#endif // IO_JSONSTRING_H
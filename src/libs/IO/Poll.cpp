@@ -43,6 +43,8 @@ void PollGroup::remove(int fd)
 	if (m_handlers.erase(fd) != 1)
 		errx(EXIT_FAILURE, "PollGroup: remove called with a non-present fd");
 
+	m_writeHandlers.erase(fd);
+
 	epoll_event dummy;
 	epoll_ctl(m_fd, EPOLL_CTL_DEL, fd, &dummy);
 }
@@ -57,6 +59,31 @@ void PollGroup::remove(Pollable *object)
 	remove(object->fd());
 }
 
+void PollGroup::setWriteHandler(int fd, std::function<void()> handler)
+{
+	if (m_handlers.count(fd) == 0)
+		errx(EXIT_FAILURE, "PollGroup: setWriteHandler called with a non-present fd");
+
+	if (m_writeHandlers.emplace(fd, handler).second)
+		updateEvents(fd, true);
+	else
+		m_writeHandlers[fd] = handler;
+}
+
+void PollGroup::clearWriteHandler(int fd)
+{
+	if (m_writeHandlers.erase(fd) == 1)
+		updateEvents(fd, false);
+}
+
+void PollGroup::updateEvents(int fd, bool writable)
+{
+	epoll_event ev;
+	ev.events = writable ? (EPOLLIN | EPOLLOUT) : EPOLLIN;
+	ev.data.fd = fd;
+	epoll_ctl(m_fd, EPOLL_CTL_MOD, fd, &ev);
+}
+
 int PollGroup::fd() const
 {
 	return m_fd;
@@ -76,6 +103,21 @@ restart:
 	}
 
 	int fd = evt.data.fd;
+
+	if (evt.events & EPOLLOUT)
+	{
+		std::map<int, std::function<void()>>::const_iterator wit = m_writeHandlers.find(fd);
+		if (wit != m_writeHandlers.cend())
+		{
+			std::function<void()> handler = wit->second;
+			handler();
+		}
+
+		// the write handler might have removed the fd
+		if ((evt.events & ~EPOLLOUT) == 0 || m_handlers.count(fd) == 0)
+			return;
+	}
+
 	std::map<int, std::function<void()>>::const_iterator it = m_handlers.find(fd);
 
 	if (it != m_handlers.cend() && it->second)
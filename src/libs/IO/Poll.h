@@ -35,6 +35,10 @@ class Pollable
  *     must NEVER be called, but fd() can still be used to wait for activity on
  *     any registered file descriptor (see the following paragraph).
  *
+ * In addition, a write handler can be associated to any registered file
+ * descriptor: while it is set, runOnce() also calls it when the file
+ * descriptor is ready to be written.
+ *
  * If no registered objects or file descriptors are ready, runOnce() will block
  * until at least one becomes ready. It also possible to wait until at least one
  * file descriptor is ready by poll()ing/select()ing (or even adding to a
@@ -56,6 +60,10 @@ class PollGroup : public Pollable
 		void add(Pollable *object);
 		void remove(Pollable *object);
 
+		// start/stop watching an already-added fd for writability
+		void setWriteHandler(int fd, std::function<void()> handler);
+		void clearWriteHandler(int fd);
+
 		// this fd can be used to poll on any registered fd
 		int fd() const override;
 
@@ -63,7 +71,10 @@ class PollGroup : public Pollable
 		void runOnce() override;
 
 	private:
+		void updateEvents(int fd, bool writable);
+
 		std::map<int, std::function<void()>> m_handlers;
+		std::map<int, std::function<void()>> m_writeHandlers;
 		int m_fd; // epoll fd
 };
 
@@ -0,0 +1,225 @@
+#ifndef MAVLINK_FORMATWRITER_H
+#define MAVLINK_FORMATWRITER_H
+
+#include "MAVLink/MAVLink.h"
+
+#include <math.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+/* Support code for the formatters generated by generate_formatters.py */
+
+namespace MAVLink
+{
+
+// Reads a field from the payload (MAVLink is little-endian on the wire, just
+// like all the architectures we run on)
+template<typename T>
+inline T get(const uint8_t *p)
+{
+	T r;
+	memcpy(&r, p, sizeof(T));
+	return r;
+}
+
+/* Appends text to a caller-provided buffer, with snprintf()-like semantics:
+ * output that does not fit is discarded, but still counted in the value returned by finish() */
+template<FormatStyle S>
+class FormatWriter
+{
+	public:
+		FormatWriter(char *buf, size_t size)
+		: m_buf(buf), m_size(size), m_len(0), m_first(true)
+		{
+		}
+
+		// NUL-terminates the buffer and returns the length of the whole output
+		size_t finish()
+		{
+			if (m_size != 0)
+				m_buf[m_len < m_size ? m_len : m_size - 1] = '\0';
+			return m_len;
+		}
+
+		void begin(const char *name)
+		{
+			if (S == FORMAT_JSON)
+			{
+				put("{\"name\":\"");
+				put(name);
+				put("\"");
+			}
+			else
+			{
+				put(name);
+				put(" { ");
+			}
+		}
+
+		void end()
+		{
+			put(S == FORMAT_JSON ? "}" : " }");
+		}
+
+		void field(const char *name)
+		{
+			if (S == FORMAT_JSON)
+			{
+				put(",\"");
+				put(name);
+				put("\":");
+			}
+			else
+			{
+				if (!m_first)
+					put(" ");
+				put(name);
+				put(": ");
+			}
+			m_first = false;
+		}
+
+		void value(char v) { value((int64_t)v); }
+		void value(int8_t v) { value((int64_t)v); }
+		void value(uint8_t v) { value((uint64_t)v); }
+		void value(int16_t v) { value((int64_t)v); }
+		void value(uint16_t v) { value((uint64_t)v); }
+		void value(int32_t v) { value((int64_t)v); }
+		void value(uint32_t v) { value((uint64_t)v); }
+
+		void value(uint64_t v)
+		{
+			char tmp[20];
+			char *e = tmp + sizeof(tmp), *s = e;
+			do
+			{
+				*--s = '0' + v % 10;
+				v /= 10;
+			} while (v != 0);
+			put(s, e - s);
+		}
+
+		void value(int64_t v)
+		{
+			if (v < 0)
+			{
+				put("-");
+				value((uint64_t)0 - (uint64_t)v);
+			}
+			else
+			{
+				value((uint64_t)v);
+			}
+		}
+
+		// Enough significant digits to read back the same value, e.g. for
+		// lat/lon-style fields
+		void value(float v)
+		{
+			floatingPoint(v, "%.9g");
+		}
+
+		void value(double v)
+		{
+			floatingPoint(v, "%.17g");
+		}
+
+		// char arrays are strings, NUL-terminated unless they fill the whole field
+		void chars(const uint8_t *p, size_t maxlen)
+		{
+			size_t n = strnlen((const char*)p, maxlen);
+			put(S == FORMAT_JSON ? "\"" : "'");
+
+			if (S == FORMAT_JSON)
+			{
+				for (size_t i = 0; i < n; i++)
+				{
+					if (p[i] == '"' || p[i] == '\\')
+					{
+						char esc[2] = { '\\', (char)p[i] };
+						put(esc, 2);
+					}
+					else if (p[i] < 0x20 || p[i] >= 0x7f)
+					{
+						char esc[8];
+						put(esc, snprintf(esc, sizeof(esc), "\\u%04x", p[i]));
+					}
+					else
+					{
+						put((const char*)p + i, 1);
+					}
+				}
+			}
+			else
+			{
+				put((const char*)p, n);
+			}
+
+			put(S == FORMAT_JSON ? "\"" : "'");
+		}
+
+		template<typename T>
+		void array(const uint8_t *p, size_t count)
+		{
+			put(S == FORMAT_JSON ? "[" : "[ ");
+			for (size_t i = 0; i < count; i++)
+			{
+				if (i != 0)
+					put(", ");
+				value(get<T>(p + i * sizeof(T)));
+			}
+			put(S == FORMAT_JSON ? "]" : " ]");
+		}
+
+	private:
+		void floatingPoint(double v, const char *fmt)
+		{
+			// JSON has no representation for NaN and infinities
+			if (S == FORMAT_JSON && !isfinite(v))
+			{
+				put("null");
+				return;
+			}
+
+			char tmp[32];
+			int n = snprintf(tmp, sizeof(tmp), fmt, v);
+			put(tmp, n);
+		}
+
+		void put(const char *s)
+		{
+			put(s, strlen(s));
+		}
+
+		void put(const char *s, size_t n)
+		{
+			if (m_len < m_size)
+			{
+				size_t avail = m_size - m_len;
+				memcpy(m_buf + m_len, s, n < avail ? n : avail);
+			}
+			m_len += n;
+		}
+
+		char *m_buf;
+		size_t m_size, m_len;
+		bool m_first;
+};
+
+struct FormatterEntry
+{
+	uint32_t msgid;
+	uint8_t length; // full (i.e. non-truncated) payload length
+	void (*text)(FormatWriter<FORMAT_TEXT> &w, const uint8_t *payload);
+	void (*json)(FormatWriter<FORMAT_JSON> &w, const uint8_t *payload);
+};
+
+// Generated, sorted by msgid
+extern const FormatterEntry formatter_table[];
+extern const size_t formatter_table_size;
+
+}
+
+#endif // MAVLINK_FORMATWRITER_H
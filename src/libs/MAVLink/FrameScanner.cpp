@@ -0,0 +1,261 @@
+#include "MAVLink/FrameScanner.h"
+
+#include <string.h>
+
+#include <algorithm>
+
+namespace MAVLink
+{
+
+// Reflected CRC-16 with polynomial 0x1021. crcTable[k][b] is the CRC of byte
+// b followed by k zero bytes
+struct CrcTables
+{
+	uint16_t t[4][256];
+
+	CrcTables()
+	{
+		for (unsigned b = 0; b < 256; b++)
+		{
+			uint16_t crc = b;
+			for (int i = 0; i < 8; i++)
+				crc = (crc & 1) ? (crc >> 1) ^ 0x8408 : crc >> 1;
+			t[0][b] = crc;
+		}
+
+		for (unsigned b = 0; b < 256; b++)
+		{
+			for (int k = 1; k < 4; k++)
+				t[k][b] = (t[k - 1][b] >> 8) ^ t[0][t[k - 1][b] & 0xff];
+		}
+	}
+};
+
+static const CrcTables crcTables;
+
+uint16_t crc_calculate_fast(const uint8_t *data, size_t len, uint16_t crc)
+{
+	const uint16_t (*t)[256] = crcTables.t;
+
+	while (len >= 4)
+	{
+		uint16_t x = crc ^ (data[0] | (data[1] << 8));
+		crc = t[3][x & 0xff] ^ t[2][x >> 8] ^ t[1][data[2]] ^ t[0][data[3]];
+		data += 4;
+		len -= 4;
+	}
+
+	while (len-- != 0)
+		crc = (crc >> 8) ^ t[0][(crc ^ *data++) & 0xff];
+
+	return crc;
+}
+
+// Returns the total length of the frame starting at p (p[0] must be a STX
+// marker), or 0 if not enough bytes are available to know it yet
+static size_t expectedFrameLength(const uint8_t *p, size_t avail)
+{
+	if (p[0] == MAVLINK_STX_MAVLINK1)
+	{
+		if (avail < 2)
+			return 0;
+
+		return MAVLINK_CORE_HEADER_MAVLINK1_LEN + 1 + p[1] + MAVLINK_NUM_CHECKSUM_BYTES;
+	}
+	else
+	{
+		if (avail < 3)
+			return 0;
+
+		size_t len = MAVLINK_NUM_NON_PAYLOAD_BYTES + p[1];
+		if (p[2] & MAVLINK_IFLAG_SIGNED)
+			len += MAVLINK_SIGNATURE_BLOCK_LEN;
+
+		return len;
+	}
+}
+
+static inline bool isStx(uint8_t c)
+{
+	return c == MAVLINK_STX || c == MAVLINK_STX_MAVLINK1;
+}
+
+// Parse the header of a complete frame and verify its checksum. Returns false
+// if the data cannot possibly be a frame
+static bool parseFrame(const uint8_t *p, size_t len, Frame *f)
+{
+	size_t headerLen;
+
+	f->data = p;
+	f->len = len;
+	f->payloadLen = p[1];
+
+	if (p[0] == MAVLINK_STX_MAVLINK1)
+	{
+		headerLen = MAVLINK_CORE_HEADER_MAVLINK1_LEN + 1;
+		f->seq = p[2];
+		f->sysid = p[3];
+		f->compid = p[4];
+		f->msgid = p[5];
+	}
+	else
+	{
+		// reject unknown incompatibility flags
+		if (p[2] & ~MAVLINK_IFLAG_SIGNED)
+			return false;
+
+		headerLen = MAVLINK_NUM_HEADER_BYTES;
+		f->seq = p[4];
+		f->sysid = p[5];
+		f->compid = p[6];
+		f->msgid = p[7] | (p[8] << 8) | (p[9] << 16);
+	}
+
+	f->payload = p + headerLen;
+
+	const mavlink_msg_entry_t *e = mavlink_get_msg_entry(f->msgid);
+	if (e == nullptr)
+	{
+		f->status = FRAME_UNKNOWN_MSGID;
+		return true;
+	}
+
+	// checksum covers everything but STX, and then crc_extra
+	uint16_t crc = crc_calculate_fast(p + 1, headerLen - 1 + f->payloadLen);
+	crc = crc_calculate_fast(&e->crc_extra, 1, crc);
+
+	const uint8_t *ck = f->payload + f->payloadLen;
+	f->status = (crc == (ck[0] | (ck[1] << 8))) ? FRAME_OK : FRAME_BAD_CRC;
+
+	return true;
+}
+
+uint8_t Frame::targetSystem() const
+{
+	return target_system(msgid, payload, payloadLen);
+}
+
+void Frame::decode(mavlink_message_t *msg) const
+{
+	const uint8_t *ck = payload + payloadLen;
+
+	memset(msg, 0, sizeof(*msg));
+	msg->magic = data[0];
+	msg->len = payloadLen;
+	msg->seq = seq;
+	msg->sysid = sysid;
+	msg->compid = compid;
+	msg->msgid = msgid;
+	msg->checksum = ck[0] | (ck[1] << 8);
+	memcpy(_MAV_PAYLOAD_NON_CONST(msg), payload, payloadLen);
+
+	if (data[0] != MAVLINK_STX_MAVLINK1)
+	{
+		msg->incompat_flags = data[2];
+		msg->compat_flags = data[3];
+		if (msg->incompat_flags & MAVLINK_IFLAG_SIGNED)
+			memcpy(msg->signature, ck + MAVLINK_NUM_CHECKSUM_BYTES, MAVLINK_SIGNATURE_BLOCK_LEN);
+	}
+}
+
+FrameScanner::FrameScanner()
+: m_discardedBytes(0)
+{
+	m_carry.reserve(MAVLINK_MAX_PACKET_LEN);
+}
+
+void FrameScanner::reset()
+{
+	m_discardedBytes += m_carry.size();
+	m_carry.clear();
+}
+
+uint64_t FrameScanner::discardedBytes() const
+{
+	return m_discardedBytes;
+}
+
+size_t FrameScanner::completeCarry(const uint8_t *buf, size_t len, const std::function<void(const Frame &frame)> &cb)
+{
+	size_t pos = 0;
+
+	while (!m_carry.empty())
+	{
+		// The carry buffer always starts with a STX, but it may contain more
+		// than one frame after a resync
+		size_t total = expectedFrameLength(m_carry.data(), m_carry.size());
+		if (total == 0 || m_carry.size() < total)
+		{
+			if (pos == len)
+				break; // wait for more data
+
+			// Append the missing bytes, or as many as available (one at a
+			// time until the header is complete)
+			size_t want = (total != 0) ? total - m_carry.size() : 1;
+			size_t n = std::min(want, len - pos);
+
+			m_carry.insert(m_carry.end(), buf + pos, buf + pos + n);
+			pos += n;
+			continue;
+		}
+
+		Frame f;
+		if (parseFrame(m_carry.data(), total, &f))
+		{
+			cb(f);
+			m_carry.erase(m_carry.begin(), m_carry.begin() + total);
+		}
+		else
+		{
+			// Not a frame: resume from the next STX in the carry buffer
+			m_carry.erase(m_carry.begin());
+			m_discardedBytes++;
+		}
+
+		// Leftover bytes are scanned again before continuing with buf
+		std::vector<uint8_t>::iterator it = std::find_if(m_carry.begin(), m_carry.end(), isStx);
+		m_discardedBytes += it - m_carry.begin();
+		m_carry.erase(m_carry.begin(), it);
+	}
+
+	return pos;
+}
+
+void FrameScanner::scan(const uint8_t *buf, size_t len, const std::function<void(const Frame &frame)> &cb)
+{
+	size_t pos = completeCarry(buf, len, cb);
+
+	while (pos < len)
+	{
+		// Look for the next STX
+		size_t start = pos;
+		while (pos < len && !isStx(buf[pos]))
+			pos++;
+		m_discardedBytes += pos - start;
+
+		if (pos == len)
+			break;
+
+		size_t total = expectedFrameLength(buf + pos, len - pos);
+		if (total == 0 || pos + total > len)
+		{
+			// Incomplete frame at the end of the buffer
+			m_carry.assign(buf + pos, buf + len);
+			break;
+		}
+
+		Frame f;
+		if (parseFrame(buf + pos, total, &f))
+		{
+			cb(f);
+			pos += total;
+		}
+		else
+		{
+			m_discardedBytes++;
+			pos++;
+		}
+	}
+}
+
+}
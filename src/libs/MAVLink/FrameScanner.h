@@ -0,0 +1,82 @@
+#ifndef MAVLINK_FRAMESCANNER_H
+#define MAVLINK_FRAMESCANNER_H
+
+#include "MAVLink/MAVLink.h"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <functional>
+#include <vector>
+
+namespace MAVLink
+{
+
+/* CRC-16/MCRF4XX (the "X.25" checksum used by MAVLink), computed with
+ * slicing-by-4 lookup tables */
+uint16_t crc_calculate_fast(const uint8_t *data, size_t len, uint16_t crc = 0xffff);
+
+enum FrameStatus
+{
+	FRAME_OK,
+	FRAME_BAD_CRC,
+	FRAME_UNKNOWN_MSGID // CRC cannot be checked without the msgid's crc_extra
+};
+
+// A complete frame, pointing into the buffer passed to FrameScanner::scan()
+struct Frame
+{
+	const uint8_t *data; // raw frame, from STX to checksum/signature
+	size_t len;
+
+	const uint8_t *payload;
+	uint8_t payloadLen;
+
+	uint32_t msgid;
+	uint8_t sysid, compid, seq;
+	FrameStatus status;
+
+	// see MAVLink::target_system()
+	uint8_t targetSystem() const;
+
+	// Fill a mavlink_message_t, for use with the MAVLink C library
+	void decode(mavlink_message_t *msg) const;
+};
+
+/* Splits a byte stream into MAVLink (v1 and v2) frames.
+ *
+ * Unlike mavlink_frame_char_buffer(), which processes one byte per call,
+ * scan() looks for STX markers over whole buffers, and complete frames are
+ * reported without being copied. Only frames that span two scan() calls are
+ * copied into an internal buffer.
+ *
+ * Like mavlink_frame_char_buffer(), frames with a bad checksum are reported
+ * (with the appropriate status) and skipped as a whole.
+ */
+class FrameScanner
+{
+	public:
+		FrameScanner();
+
+		// Frame objects are only valid during the callback
+		void scan(const uint8_t *buf, size_t len, const std::function<void(const Frame &frame)> &cb);
+
+		// discards the partial frame left over by the previous scan(), e.g.
+		// at the end of a datagram (it counts as discarded bytes)
+		void reset();
+
+		// number of bytes that were skipped because they were not part of a frame
+		uint64_t discardedBytes() const;
+
+	private:
+		// returns the number of bytes consumed from buf
+		size_t completeCarry(const uint8_t *buf, size_t len, const std::function<void(const Frame &frame)> &cb);
+
+		// partial frame left over by the previous scan()
+		std::vector<uint8_t> m_carry;
+
+		uint64_t m_discardedBytes;
+};
+
+}
+
+#endif // MAVLINK_FRAMESCANNER_H
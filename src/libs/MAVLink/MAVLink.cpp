@@ -1,98 +1,98 @@
 #include "MAVLink/MAVLink.h"
+#include "MAVLink/FormatWriter.h"
 
+#include <algorithm>
 #include <stddef.h>
 #include <stdio.h>
+#include <string.h>
 
 namespace MAVLink
 {
 
-/* The following functions were borrowed from the mavlink project:
- *  mavlink/pymavlink/generator/C/test/posix/testmav.c
- */
+static const FormatterEntry *find_formatter(uint32_t msgid)
+{
+	const FormatterEntry *end = formatter_table + formatter_table_size;
+	const FormatterEntry *e = std::lower_bound(formatter_table, end, msgid,
+		[](const FormatterEntry &entry, uint32_t id) { return entry.msgid < id; });
+
+	return (e != end && e->msgid == msgid) ? e : nullptr;
+}
 
-static void print_one_field(const mavlink_message_t *msg, const mavlink_field_info_t *f, int idx)
+size_t format_message(uint32_t msgid, const uint8_t *payload, size_t payloadLen, char *buf, size_t size, FormatStyle style)
 {
-#define PRINT_FORMAT(f, def) (f->print_format?f->print_format:def)
-	switch (f->type) {
-	case MAVLINK_TYPE_CHAR:
-		printf(PRINT_FORMAT(f, "%c"), _MAV_RETURN_char(msg, f->wire_offset+idx*1));
-		break;
-	case MAVLINK_TYPE_UINT8_T:
-		printf(PRINT_FORMAT(f, "%u"), _MAV_RETURN_uint8_t(msg, f->wire_offset+idx*1));
-		break;
-	case MAVLINK_TYPE_INT8_T:
-		printf(PRINT_FORMAT(f, "%d"), _MAV_RETURN_int8_t(msg, f->wire_offset+idx*1));
-		break;
-	case MAVLINK_TYPE_UINT16_T:
-		printf(PRINT_FORMAT(f, "%u"), _MAV_RETURN_uint16_t(msg, f->wire_offset+idx*2));
-		break;
-	case MAVLINK_TYPE_INT16_T:
-		printf(PRINT_FORMAT(f, "%d"), _MAV_RETURN_int16_t(msg, f->wire_offset+idx*2));
-		break;
-	case MAVLINK_TYPE_UINT32_T:
-		printf(PRINT_FORMAT(f, "%lu"), (unsigned long)_MAV_RETURN_uint32_t(msg, f->wire_offset+idx*4));
-		break;
-	case MAVLINK_TYPE_INT32_T:
-		printf(PRINT_FORMAT(f, "%ld"), (long)_MAV_RETURN_int32_t(msg, f->wire_offset+idx*4));
-		break;
-	case MAVLINK_TYPE_UINT64_T:
-		printf(PRINT_FORMAT(f, "%llu"), (unsigned long long)_MAV_RETURN_uint64_t(msg, f->wire_offset+idx*8));
-		break;
-	case MAVLINK_TYPE_INT64_T:
-		printf(PRINT_FORMAT(f, "%lld"), (long long)_MAV_RETURN_int64_t(msg, f->wire_offset+idx*8));
-		break;
-	case MAVLINK_TYPE_FLOAT:
-		printf(PRINT_FORMAT(f, "%f"), (double)_MAV_RETURN_float(msg, f->wire_offset+idx*4));
-		break;
-	case MAVLINK_TYPE_DOUBLE:
-		printf(PRINT_FORMAT(f, "%f"), _MAV_RETURN_double(msg, f->wire_offset+idx*8));
-		break;
+	const FormatterEntry *e = find_formatter(msgid);
+	if (e == nullptr)
+		return 0;
+
+	// MAVLink 2 truncates trailing zero bytes from the payload: formatters
+	// always read the full length, so restore them
+	uint8_t padded[MAVLINK_MAX_PAYLOAD_LEN];
+	if (payloadLen < e->length)
+	{
+		memcpy(padded, payload, payloadLen);
+		memset(padded + payloadLen, 0, e->length - payloadLen);
+		payload = padded;
+	}
+
+	if (style == FORMAT_JSON)
+	{
+		FormatWriter<FORMAT_JSON> w(buf, size);
+		e->json(w, payload);
+		return w.finish();
+	}
+	else
+	{
+		FormatWriter<FORMAT_TEXT> w(buf, size);
+		e->text(w, payload);
+		return w.finish();
 	}
 }
 
-static void print_field(const mavlink_message_t *msg, const mavlink_field_info_t *f)
+size_t format_message(const mavlink_message_t *msg, char *buf, size_t size, FormatStyle style)
 {
-	printf("%s: ", f->name);
-	if (f->array_length == 0) {
-		print_one_field(msg, f, 0);
-		printf(" ");
-	} else {
-		unsigned i;
-		/* print an array */
-		if (f->type == MAVLINK_TYPE_CHAR) {
-			printf("'%.*s'", f->array_length,
-			       f->wire_offset+(const char *)_MAV_PAYLOAD(msg));
-			
-		} else {
-			printf("[ ");
-			for (i=0; i<f->array_length; i++) {
-				print_one_field(msg, f, i);
-				if (i < f->array_length) {
-					printf(", ");
-				}
-			}
-			printf("]");
-		}
-	}
-	printf(" ");
+	return format_message(msg->msgid, (const uint8_t*)_MAV_PAYLOAD(msg), msg->len, buf, size, style);
 }
 
 void print_message(const mavlink_message_t *msg)
 {
-	const mavlink_message_info_t *m = mavlink_get_message_info(msg);
-	if (m == NULL) {
+	char buf[4096];
+	if (format_message(msg, buf, sizeof(buf), FORMAT_TEXT) == 0)
+	{
 		printf("ERROR: no message info for %u\n", msg->msgid);
-		//error_count++;
 		return;
 	}
 
-	printf("%s { ", m->name);
+	puts(buf);
+}
 
-	const mavlink_field_info_t *f = m->fields;
-	for (unsigned i = 0; i < m->num_fields; i++) {
-		print_field(msg, &f[i]);
-	}
-	printf("}\n");
+size_t frame_length(const mavlink_message_t *msg)
+{
+	if (msg->magic == MAVLINK_STX_MAVLINK1)
+		return MAVLINK_CORE_HEADER_MAVLINK1_LEN + 1 + msg->len + MAVLINK_NUM_CHECKSUM_BYTES;
+
+	size_t len = MAVLINK_NUM_NON_PAYLOAD_BYTES + msg->len;
+	if (msg->incompat_flags & MAVLINK_IFLAG_SIGNED)
+		len += MAVLINK_SIGNATURE_BLOCK_LEN;
+
+	return len;
+}
+
+uint8_t target_system(uint32_t msgid, const uint8_t *payload, size_t payloadLen)
+{
+	const mavlink_msg_entry_t *e = mavlink_get_msg_entry(msgid);
+	if (e == NULL || (e->flags & MAVLINK_MSG_ENTRY_FLAG_HAVE_TARGET_SYSTEM) == 0)
+		return 0;
+
+	// MAVLink 2 truncates trailing zero bytes from the payload
+	if (e->target_system_ofs >= payloadLen)
+		return 0;
+
+	return payload[e->target_system_ofs];
+}
+
+uint8_t target_system(const mavlink_message_t *msg)
+{
+	return target_system(msg->msgid, (const uint8_t*)_MAV_PAYLOAD(msg), msg->len);
 }
 
 }
@@ -4,7 +4,6 @@
 #include <stddef.h>
 
 #define MAVLINK_ALIGNED_FIELDS 0
-#define MAVLINK_USE_MESSAGE_INFO
 #include "mavlink/v2.0/ardupilotmega/mavlink.h"
 
 namespace MAVLink
@@ -13,6 +12,29 @@ namespace MAVLink
 /* Dump message contents to stdout (for debug/tracing purposes) */
 void print_message(const mavlink_message_t *msg);
 
+enum FormatStyle
+{
+	FORMAT_TEXT, // NAME { field: value field: value }
+	FORMAT_JSON  // {"name":"NAME","field":value,"field":value}
+};
+
+/* Write message contents to buf, using the formatters generated from the
+ * MAVLink XML definitions at build time. Like snprintf(), the output is
+ * truncated to size-1 characters and NUL-terminated, and the return value is
+ * the length of the whole output. Returns 0, leaving buf untouched, if the
+ * msgid is unknown. */
+size_t format_message(uint32_t msgid, const uint8_t *payload, size_t payloadLen, char *buf, size_t size, FormatStyle style);
+size_t format_message(const mavlink_message_t *msg, char *buf, size_t size, FormatStyle style);
+
+/* Size of the message on the wire, i.e. header, payload, checksum and (if
+ * present) signature */
+size_t frame_length(const mavlink_message_t *msg);
+
+/* Value of the message's target_system field, or 0 (i.e. broadcast) if the
+ * message does not have such a field */
+uint8_t target_system(uint32_t msgid, const uint8_t *payload, size_t payloadLen);
+uint8_t target_system(const mavlink_message_t *msg);
+
 }
 
 #endif // MAVLINK_MAVLINK_H
@@ -0,0 +1,142 @@
+#!/usr/bin/env python3
+#
+# Generates the per-message formatters used by MAVLink::format_message().
+#
+# Usage: generate_formatters.py DIALECT.xml OUTPUT.cpp
+#
+# The dialect file is parsed together with all the files it includes. For each
+# message, a function that reads every field straight from its wire offset is
+# emitted, so that no field type has to be looked up at run time. Fields of
+# type char[N] are shown as NUL-terminated strings, other arrays as lists.
+
+import os
+import re
+import sys
+import xml.etree.ElementTree as ET
+
+# C type of each MAVLink wire type, and its size
+WIRE_TYPES = {
+    'char': ('char', 1),
+    'int8_t': ('int8_t', 1),
+    'uint8_t': ('uint8_t', 1),
+    'uint8_t_mavlink_version': ('uint8_t', 1),
+    'int16_t': ('int16_t', 2),
+    'uint16_t': ('uint16_t', 2),
+    'int32_t': ('int32_t', 4),
+    'uint32_t': ('uint32_t', 4),
+    'float': ('float', 4),
+    'int64_t': ('int64_t', 8),
+    'uint64_t': ('uint64_t', 8),
+    'double': ('double', 8),
+}
+
+class Field:
+    def __init__(self, elem, extension):
+        self.name = elem.get('name')
+        self.extension = extension
+
+        m = re.match(r'^\s*(\w+)\s*(?:\[\s*(\d+)\s*\])?\s*$', elem.get('type'))
+        if m is None or m.group(1) not in WIRE_TYPES:
+            raise ValueError('unknown type {} in field {}'.format(elem.get('type'), self.name))
+
+        wire_type = m.group(1)
+        self.array_length = int(m.group(2)) if m.group(2) is not None else 0
+        self.is_string = wire_type == 'char' and self.array_length != 0
+
+        self.ctype, self.type_size = WIRE_TYPES[wire_type]
+        self.offset = None
+
+    def wire_length(self):
+        return self.type_size * max(self.array_length, 1)
+
+class Message:
+    def __init__(self, elem):
+        self.msgid = int(elem.get('id'))
+        self.name = elem.get('name')
+
+        self.fields = []
+        extension = False
+        for child in elem:
+            if child.tag == 'extensions':
+                extension = True
+            elif child.tag == 'field':
+                self.fields.append(Field(child, extension))
+
+        # Wire order: base fields sorted by type size (largest first, the sort
+        # is stable), followed by extension fields in declaration order
+        base = [f for f in self.fields if not f.extension]
+        ext = [f for f in self.fields if f.extension]
+        self.wire_fields = sorted(base, key=lambda f: -f.type_size) + ext
+
+        offset = 0
+        for f in self.wire_fields:
+            f.offset = offset
+            offset += f.wire_length()
+        self.length = offset
+
+def load_messages(path, messages, visited):
+    path = os.path.abspath(path)
+    if path in visited:
+        return
+    visited.add(path)
+
+    root = ET.parse(path).getroot()
+
+    for inc in root.findall('include'):
+        load_messages(os.path.join(os.path.dirname(path), inc.text.strip()), messages, visited)
+
+    for elem in root.findall('messages/message'):
+        msg = Message(elem)
+        if msg.msgid not in messages:
+            messages[msg.msgid] = msg
+
+def emit_message(out, msg):
+    out.write('template<FormatStyle S>\n')
+    out.write('static void format_{}(FormatWriter<S> &w, const uint8_t *p)\n'.format(msg.name))
+    out.write('{\n')
+    out.write('\tw.begin("{}");\n'.format(msg.name))
+
+    # Fields are shown in declaration order, as in the XML
+    for f in msg.fields:
+        out.write('\tw.field("{}"); '.format(f.name))
+        if f.array_length == 0:
+            out.write('w.value(get<{}>(p + {}));\n'.format(f.ctype, f.offset))
+        elif f.is_string:
+            out.write('w.chars(p + {}, {});\n'.format(f.offset, f.array_length))
+        else:
+            out.write('w.template array<{}>(p + {}, {});\n'.format(f.ctype, f.offset, f.array_length))
+
+    out.write('\tw.end();\n')
+    out.write('}\n\n')
+
+def main():
+    if len(sys.argv) != 3:
+        sys.exit('Usage: {} DIALECT.xml OUTPUT.cpp'.format(sys.argv[0]))
+
+    messages = {}
+    load_messages(sys.argv[1], messages, set())
+    ordered = [messages[k] for k in sorted(messages)]
+
+    # Write to a temporary file first, so that an interrupted run does not
+    # leave a truncated output behind
+    tmp_path = sys.argv[2] + '.tmp'
+    with open(tmp_path, 'wt') as out:
+        out.write('// Generated by generate_formatters.py from {}: do not edit\n\n'.format(os.path.basename(sys.argv[1])))
+        out.write('#include "MAVLink/FormatWriter.h"\n\n')
+        out.write('namespace MAVLink\n{\n\n')
+
+        for msg in ordered:
+            emit_message(out, msg)
+
+        out.write('const FormatterEntry formatter_table[] =\n{\n')
+        for msg in ordered:
+            out.write('\t{{ {}, {}, format_{}<FORMAT_TEXT>, format_{}<FORMAT_JSON> }},\n'.format(
+                msg.msgid, msg.length, msg.name, msg.name))
+        out.write('};\n\n')
+        out.write('const size_t formatter_table_size = {};\n\n'.format(len(ordered)))
+        out.write('}\n')
+
+    os.replace(tmp_path, sys.argv[2])
+
+if __name__ == '__main__':
+    main()
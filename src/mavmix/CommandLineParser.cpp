@@ -0,0 +1,185 @@
+#include "CommandLineParser.h"
+
+#include <getopt.h>
+#include <err.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <string>
+
+enum
+{
+	OPT_RATE_LIMIT = 256,
+	OPT_GCS_PORT,
+	OPT_RECORD,
+	OPT_THREADS,
+	OPT_GCS_UDP_PORT,
+	OPT_UAV_UDP_PORT,
+	OPT_STATS_SOCKET,
+};
+
+static option long_options[] =
+{
+	{ "help", no_argument, nullptr, 'h' },
+	{ "rate-limit", required_argument, nullptr, OPT_RATE_LIMIT },
+	{ "gcs-port", required_argument, nullptr, OPT_GCS_PORT },
+	{ "record", required_argument, nullptr, OPT_RECORD },
+	{ "threads", required_argument, nullptr, OPT_THREADS },
+	{ "gcs-udp-port", required_argument, nullptr, OPT_GCS_UDP_PORT },
+	{ "uav-udp-port", required_argument, nullptr, OPT_UAV_UDP_PORT },
+	{ "stats-socket", required_argument, nullptr, OPT_STATS_SOCKET },
+	{ nullptr, 0, nullptr, 0 }
+};
+
+static void showHelp()
+{
+	fprintf(stderr, "Usage: %s [options] GCSport UAVport\n", program_invocation_name);
+	fprintf(stderr, "\n");
+	fprintf(stderr, "This program relays MAVLink messages between UAVs and any number of GCSs.\n");
+	fprintf(stderr, "\n");
+	fprintf(stderr, "Options:\n");
+	fprintf(stderr, " --rate-limit MSGID=HZ: Forward at most HZ messages per second with the given\n");
+	fprintf(stderr, "                        numeric message ID from each UAV to each GCS connected\n");
+	fprintf(stderr, "                        to GCSport. Can be specified multiple times.\n");
+	fprintf(stderr, " --gcs-port PORT[:MSGID=HZ,...]: Accept GCS connections on an additional port,\n");
+	fprintf(stderr, "                                 with its own rate limits (default: same as\n");
+	fprintf(stderr, "                                 GCSport). Can be specified multiple times.\n");
+	fprintf(stderr, " --gcs-udp-port PORT[:MSGID=HZ,...]: Like --gcs-port, but for GCSs that speak\n");
+	fprintf(stderr, "                                     UDP. GCSs are learnt from the first\n");
+	fprintf(stderr, "                                     datagram they send.\n");
+	fprintf(stderr, " --uav-udp-port PORT: Also accept UAVs that speak UDP on PORT.\n");
+	fprintf(stderr, " --record FILE: Record all messages received from UAVs and GCSs to FILE, in\n");
+	fprintf(stderr, "                .tlog format.\n");
+	fprintf(stderr, " --stats-socket PATH: Collect per-UAV and per-message-type statistics, and\n");
+	fprintf(stderr, "                      serve them as JSON to clients that connect to the\n");
+	fprintf(stderr, "                      UNIX socket at PATH.\n");
+	fprintf(stderr, " --threads N: Spread UAV connections across N worker threads (default: 1).\n");
+	fprintf(stderr, "\n");
+	fprintf(stderr, "Rate limits only apply to telemetry: commands, mission and parameter messages\n");
+	fprintf(stderr, "are always forwarded.\n");
+	fprintf(stderr, "\n");
+
+	exit(EXIT_FAILURE);
+}
+
+static int parsePort(const char *text)
+{
+	char *endp;
+	long port = strtol(text, &endp, 10);
+	if (*text == '\0' || *endp != '\0' || port < 1 || port > 65535)
+		errx(EXIT_FAILURE, "invalid port number: %s", text);
+	return port;
+}
+
+// Parse "MSGID=HZ" and store it into limits
+static void parseRateLimit(const char *text, RateLimits *limits, const char *optname)
+{
+	char *endp;
+	unsigned long msgid = strtoul(text, &endp, 10);
+	if (endp == text || *endp != '=' || msgid > 0xffffff)
+		errx(EXIT_FAILURE, "option '%s' has invalid format", optname);
+
+	const char *rate = endp + 1;
+	double hz = strtod(rate, &endp);
+	if (*rate == '\0' || *endp != '\0' || hz <= 0)
+		errx(EXIT_FAILURE, "option '%s' has invalid format", optname);
+
+	(*limits)[msgid] = hz;
+}
+
+CommandLineParser::CommandLineParser(int argc, char *argv[])
+{
+	RateLimits defaultRateLimits;
+	std::vector<std::pair<const char*, bool>> extraGcsPorts; // (spec, udp)
+	recordPath = nullptr;
+	statsSocketPath = nullptr;
+	threads = 0;
+	uavUdpPort = 0;
+
+	bool help_requested = false;
+
+	while (true)
+	{
+		int c, option_index = 0;
+		c = getopt_long(argc, argv, "h", long_options, &option_index);
+
+		if (c == -1) // end of options
+			break;
+
+		switch (c)
+		{
+			case '?':
+			case ':':
+				// getopt() has already printed an error message
+				exit(EXIT_FAILURE);
+			case 'h':
+				help_requested = true;
+				break;
+			case OPT_RATE_LIMIT:
+				parseRateLimit(optarg, &defaultRateLimits, long_options[option_index].name);
+				break;
+			case OPT_GCS_PORT:
+				// parsed after all --rate-limit options are known
+				extraGcsPorts.emplace_back(optarg, false);
+				break;
+			case OPT_GCS_UDP_PORT:
+				extraGcsPorts.emplace_back(optarg, true);
+				break;
+			case OPT_UAV_UDP_PORT:
+				if (uavUdpPort != 0)
+					errx(EXIT_FAILURE, "option '%s' cannot be specified more than once", long_options[option_index].name);
+				uavUdpPort = parsePort(optarg);
+				break;
+			case OPT_RECORD:
+				if (recordPath != nullptr)
+					errx(EXIT_FAILURE, "option '%s' cannot be specified more than once", long_options[option_index].name);
+				recordPath = optarg;
+				break;
+			case OPT_STATS_SOCKET:
+				if (statsSocketPath != nullptr)
+					errx(EXIT_FAILURE, "option '%s' cannot be specified more than once", long_options[option_index].name);
+				statsSocketPath = optarg;
+				break;
+			case OPT_THREADS:
+				if (threads != 0)
+					errx(EXIT_FAILURE, "option '%s' cannot be specified more than once", long_options[option_index].name);
+				threads = atoi(optarg);
+				if (threads < 1)
+					errx(EXIT_FAILURE, "option '%s' has invalid format", long_options[option_index].name);
+				break;
+		}
+	}
+
+	if (help_requested || argc - optind != 2)
+		showHelp();
+
+	if (threads == 0)
+		threads = 1;
+
+	gcsPorts.push_back({ parsePort(argv[optind]), false, defaultRateLimits });
+	uavPort = parsePort(argv[optind + 1]);
+
+	for (const std::pair<const char*, bool> &extra : extraGcsPorts)
+	{
+		const char *spec = extra.first;
+		const char *colon = strchr(spec, ':');
+		if (colon == nullptr)
+		{
+			gcsPorts.push_back({ parsePort(spec), extra.second, defaultRateLimits });
+			continue;
+		}
+
+		GCSPort p = { parsePort(std::string(spec, colon).c_str()), extra.second, RateLimits() };
+
+		std::string list(colon + 1);
+		char *saveptr, *item = strtok_r(&list[0], ",", &saveptr);
+		while (item != nullptr)
+		{
+			parseRateLimit(item, &p.rateLimits, extra.second ? "gcs-udp-port" : "gcs-port");
+			item = strtok_r(nullptr, ",", &saveptr);
+		}
+
+		gcsPorts.push_back(p);
+	}
+}
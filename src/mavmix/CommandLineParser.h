@@ -0,0 +1,33 @@
+#ifndef COMMANDLINEPARSER_H
+#define COMMANDLINEPARSER_H
+
+#include <stdint.h>
+#include <map>
+#include <vector>
+
+// msgid -> maximum rate (Hz) of each sysid's messages
+typedef std::map<uint32_t, double> RateLimits;
+
+struct CommandLineParser
+{
+	CommandLineParser(int argc, char *argv[]);
+
+	struct GCSPort
+	{
+		int port;
+		bool udp;
+		RateLimits rateLimits;
+	};
+
+	// The first element is the GCSport positional argument
+	std::vector<GCSPort> gcsPorts;
+	int uavPort;
+	int uavUdpPort; // 0 = none
+
+	int threads; // number of threads that handle UAV connections
+
+	const char *recordPath; // nullptr = do not record
+	const char *statsSocketPath; // nullptr = do not collect statistics
+};
+
+#endif // COMMANDLINEPARSER_H
@@ -0,0 +1,125 @@
+#include "FrameQueue.h"
+
+#include <err.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+FrameQueue::FrameQueue(size_t capacity)
+: m_enqueuePos(0), m_dequeuePos(0), m_signalled(false), m_dropped(0)
+{
+	size_t size = 1;
+	while (size < capacity)
+		size <<= 1;
+
+	m_slots.reset(new Slot[size]);
+	m_mask = size - 1;
+
+	for (size_t i = 0; i < size; i++)
+		m_slots[i].seq.store(i, std::memory_order_relaxed);
+
+	m_eventfd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	if (m_eventfd < 0)
+		err(EXIT_FAILURE, "FrameQueue: eventfd failed");
+}
+
+FrameQueue::~FrameQueue()
+{
+	close(m_eventfd);
+}
+
+void FrameQueue::setHandler(const std::function<void(const MAVLink::Frame &frame)> &cb)
+{
+	m_handler = cb;
+}
+
+bool FrameQueue::push(const MAVLink::Frame &frame)
+{
+	// Claim a slot
+	uint64_t pos = m_enqueuePos.load(std::memory_order_relaxed);
+	Slot *s;
+	while (true)
+	{
+		s = &m_slots[pos & m_mask];
+		int64_t diff = (int64_t)(s->seq.load(std::memory_order_acquire) - pos);
+
+		if (diff == 0)
+		{
+			if (m_enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+				break;
+		}
+		else if (diff < 0)
+		{
+			// the slot still holds a frame that has not been consumed yet
+			m_dropped.fetch_add(1, std::memory_order_relaxed);
+			return false;
+		}
+		else
+		{
+			// another producer claimed this position
+			pos = m_enqueuePos.load(std::memory_order_relaxed);
+		}
+	}
+
+	// Fill it, rebasing the frame's pointers onto our copy
+	memcpy(s->data, frame.data, frame.len);
+	s->frame = frame;
+	s->frame.data = s->data;
+	s->frame.payload = s->data + (frame.payload - frame.data);
+	s->seq.store(pos + 1, std::memory_order_release);
+
+	// Wake the consumer up, unless it has already been notified
+	if (!m_signalled.exchange(true))
+	{
+		uint64_t one = 1;
+		if (write(m_eventfd, &one, sizeof(one)) != sizeof(one))
+			err(EXIT_FAILURE, "FrameQueue: eventfd write failed");
+	}
+
+	return true;
+}
+
+uint64_t FrameQueue::droppedCount() const
+{
+	return m_dropped.load(std::memory_order_relaxed);
+}
+
+int FrameQueue::fd() const
+{
+	return m_eventfd;
+}
+
+void FrameQueue::runOnce()
+{
+	uint64_t count;
+	if (read(m_eventfd, &count, sizeof(count)) != sizeof(count))
+		return;
+
+	// Frames pushed from now on will notify us again
+	m_signalled.store(false);
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+
+	// Consume at most one queue's worth of frames, so that other fds in the
+	// consumer's PollGroup are not starved by busy producers
+	for (uint64_t n = 0; n <= m_mask; n++)
+	{
+		Slot &s = m_slots[m_dequeuePos & m_mask];
+		if (s.seq.load(std::memory_order_acquire) != m_dequeuePos + 1)
+			return; // empty
+
+		if (m_handler)
+			m_handler(s.frame);
+
+		s.seq.store(m_dequeuePos + m_mask + 1, std::memory_order_release);
+		m_dequeuePos++;
+	}
+
+	// More frames are pending: make sure that we will be called again
+	if (!m_signalled.exchange(true))
+	{
+		uint64_t one = 1;
+		if (write(m_eventfd, &one, sizeof(one)) != sizeof(one))
+			err(EXIT_FAILURE, "FrameQueue: eventfd write failed");
+	}
+}
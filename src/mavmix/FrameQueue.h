@@ -0,0 +1,69 @@
+#ifndef FRAMEQUEUE_H
+#define FRAMEQUEUE_H
+
+#include "IO/Poll.h"
+#include "MAVLink/FrameScanner.h"
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <stdint.h>
+
+/* Bounded lock-free queue of MAVLink frames, used to pass frames between
+ * threads.
+ *
+ * push() can be called concurrently by any number of threads. Frames are
+ * consumed by a single thread, by adding the queue to its PollGroup: the
+ * queue's fd() becomes readable when frames are pending, and runOnce() passes
+ * them to the handler.
+ *
+ * Each slot holds a copy of the raw frame. The consumer's wakeup eventfd is
+ * only written when the queue goes from idle to non-idle, so that a burst of
+ * frames costs a single system call.
+ */
+class FrameQueue : public IO::Pollable
+{
+	public:
+		// capacity is rounded up to a power of two
+		explicit FrameQueue(size_t capacity);
+		~FrameQueue() override;
+
+		// frame only points to the queue's own copy during the callback
+		void setHandler(const std::function<void(const MAVLink::Frame &frame)> &cb);
+
+		// Thread-safe. Returns false (and discards the frame) if the queue is
+		// full
+		bool push(const MAVLink::Frame &frame);
+
+		// number of frames discarded because the queue was full
+		uint64_t droppedCount() const;
+
+		int fd() const override;
+		void runOnce() override;
+
+	private:
+		struct Slot
+		{
+			// equals the position of the next push() that can use this
+			// slot, or that position + 1 once the slot is filled
+			std::atomic<uint64_t> seq;
+			MAVLink::Frame frame;
+			uint8_t data[MAVLINK_MAX_PACKET_LEN];
+		};
+
+		std::unique_ptr<Slot[]> m_slots;
+		uint64_t m_mask;
+
+		// producers and the consumer work on different cache lines
+		std::atomic<uint64_t> m_enqueuePos;
+		char m_padding[64 - sizeof(std::atomic<uint64_t>)];
+		uint64_t m_dequeuePos;
+
+		std::atomic<bool> m_signalled; // the eventfd has been written
+		std::atomic<uint64_t> m_dropped;
+		int m_eventfd;
+
+		std::function<void(const MAVLink::Frame &frame)> m_handler;
+};
+
+#endif // FRAMEQUEUE_H
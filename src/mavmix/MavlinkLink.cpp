@@ -0,0 +1,5 @@
+#include "MavlinkLink.h"
+
+MavlinkLink::~MavlinkLink()
+{
+}
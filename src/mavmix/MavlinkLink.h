@@ -0,0 +1,17 @@
+#ifndef MAVLINKLINK_H
+#define MAVLINKLINK_H
+
+#include "MAVLink/FrameScanner.h"
+
+// A peer (UAV or GCS) that MAVLink frames can be sent to
+class MavlinkLink
+{
+	public:
+		virtual ~MavlinkLink();
+
+		// Enqueue a message, that will be sent as soon as possible.
+		// Returns false if the message had to be dropped
+		virtual bool send(const MAVLink::Frame &frame) = 0;
+};
+
+#endif // MAVLINKLINK_H
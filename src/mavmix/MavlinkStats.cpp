@@ -0,0 +1,188 @@
+#include "MavlinkStats.h"
+
+#include <stdlib.h>
+#include <time.h>
+
+#include <map>
+#include <new>
+
+MavlinkStats::MavlinkStats()
+: m_startTime(now()), m_lastRateUpdate(m_startTime)
+{
+	for (UavCounters &u : m_uavs)
+	{
+		u.rxMessages = u.rxBytes = 0;
+		u.txMessages = u.txBytes = 0;
+		u.dropsToGCS = u.dropsToUAV = u.rateLimited = 0;
+		u.crcErrors = u.seqLost = 0;
+		u.lastSeen = 0;
+		u.prevRxMessages = 0;
+		u.rxRate = 0;
+	}
+
+	for (std::atomic<uint16_t> &s : m_nextSeq)
+		s.store(0, std::memory_order_relaxed);
+}
+
+void *MavlinkStats::operator new(size_t size)
+{
+	void *ptr;
+	if (posix_memalign(&ptr, alignof(MavlinkStats), size) != 0)
+		throw std::bad_alloc();
+
+	return ptr;
+}
+
+void MavlinkStats::operator delete(void *ptr)
+{
+	free(ptr);
+}
+
+uint64_t MavlinkStats::now()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static inline void increment(std::atomic<uint64_t> &counter, uint64_t amount = 1)
+{
+	counter.fetch_add(amount, std::memory_order_relaxed);
+}
+
+void MavlinkStats::recordFromUAV(const MAVLink::Frame &frame)
+{
+	UavCounters &u = m_uavs[frame.sysid];
+
+	increment(u.rxMessages);
+	increment(u.rxBytes, frame.len);
+	u.lastSeen.store(now(), std::memory_order_relaxed);
+
+	if (frame.status == MAVLink::FRAME_BAD_CRC)
+	{
+		increment(u.crcErrors);
+		return;
+	}
+
+	// Each component has its own sequence counter
+	std::atomic<uint16_t> &next = m_nextSeq[(frame.sysid << 8) | frame.compid];
+	uint16_t expected = next.load(std::memory_order_relaxed);
+	if (expected != 0)
+		increment(u.seqLost, (uint8_t)(frame.seq - (expected - 1)));
+	next.store((uint8_t)(frame.seq + 1) + 1, std::memory_order_relaxed);
+}
+
+void MavlinkStats::recordToUAV(uint8_t sysid, size_t len)
+{
+	UavCounters &u = m_uavs[sysid];
+	u.txMessages.fetch_add(1, std::memory_order_relaxed);
+	u.txBytes.fetch_add(len, std::memory_order_relaxed);
+}
+
+void MavlinkStats::recordDropToGCS(uint8_t sysid)
+{
+	m_uavs[sysid].dropsToGCS.fetch_add(1, std::memory_order_relaxed);
+}
+
+void MavlinkStats::recordDropToUAV(uint8_t sysid)
+{
+	m_uavs[sysid].dropsToUAV.fetch_add(1, std::memory_order_relaxed);
+}
+
+void MavlinkStats::recordRateLimited(uint8_t sysid)
+{
+	m_uavs[sysid].rateLimited.fetch_add(1, std::memory_order_relaxed);
+}
+
+void MavlinkStats::recordMessageType(uint32_t msgid, size_t len, bool fromUAV)
+{
+	TypeCounters &t = m_types[msgid]; // zero-initialized if new
+
+	if (fromUAV)
+		t.fromUAV++;
+	else
+		t.toUAV++;
+
+	t.bytes += len;
+}
+
+void MavlinkStats::updateRates()
+{
+	uint64_t t = now();
+	double elapsed = (t - m_lastRateUpdate) / 1e9;
+	m_lastRateUpdate = t;
+
+	if (elapsed <= 0)
+		return;
+
+	for (UavCounters &u : m_uavs)
+	{
+		uint64_t rx = u.rxMessages.load(std::memory_order_relaxed);
+		u.rxRate = (rx - u.prevRxMessages) / elapsed;
+		u.prevRxMessages = rx;
+	}
+
+	for (std::pair<const uint32_t, TypeCounters> &e : m_types)
+	{
+		e.second.rate = (e.second.fromUAV - e.second.prevFromUAV) / elapsed;
+		e.second.prevFromUAV = e.second.fromUAV;
+	}
+}
+
+void MavlinkStats::writeJson(FILE *fp)
+{
+	uint64_t t = now();
+
+	fprintf(fp, "{\n");
+	fprintf(fp, "  \"uptime_s\": %.3f,\n", (t - m_startTime) / 1e9);
+
+	fprintf(fp, "  \"uavs\": {");
+	bool first = true;
+	for (int sysid = 0; sysid < 256; sysid++)
+	{
+		const UavCounters &u = m_uavs[sysid];
+		uint64_t lastSeen = u.lastSeen.load(std::memory_order_relaxed);
+		uint64_t tx = u.txMessages.load(std::memory_order_relaxed);
+		if (lastSeen == 0 && tx == 0)
+			continue;
+
+		fprintf(fp, "%s\n    \"%d\": { ", first ? "" : ",", sysid);
+		fprintf(fp, "\"rx_messages\": %llu, \"rx_bytes\": %llu, \"rx_rate_hz\": %.1f, ",
+			(unsigned long long)u.rxMessages.load(std::memory_order_relaxed),
+			(unsigned long long)u.rxBytes.load(std::memory_order_relaxed), u.rxRate);
+		fprintf(fp, "\"tx_messages\": %llu, \"tx_bytes\": %llu, ",
+			(unsigned long long)tx,
+			(unsigned long long)u.txBytes.load(std::memory_order_relaxed));
+		fprintf(fp, "\"drops_to_gcs\": %llu, \"drops_to_uav\": %llu, \"rate_limited\": %llu, ",
+			(unsigned long long)u.dropsToGCS.load(std::memory_order_relaxed),
+			(unsigned long long)u.dropsToUAV.load(std::memory_order_relaxed),
+			(unsigned long long)u.rateLimited.load(std::memory_order_relaxed));
+		fprintf(fp, "\"crc_errors\": %llu, \"seq_lost\": %llu, ",
+			(unsigned long long)u.crcErrors.load(std::memory_order_relaxed),
+			(unsigned long long)u.seqLost.load(std::memory_order_relaxed));
+		if (lastSeen != 0)
+			fprintf(fp, "\"last_seen_s\": %.3f }", (t - lastSeen) / 1e9);
+		else
+			fprintf(fp, "\"last_seen_s\": null }");
+		first = false;
+	}
+	fprintf(fp, "\n  },\n");
+
+	// sorted by msgid
+	std::map<uint32_t, const TypeCounters*> types;
+	for (const std::pair<const uint32_t, TypeCounters> &e : m_types)
+		types.emplace(e.first, &e.second);
+
+	fprintf(fp, "  \"message_types\": {");
+	first = true;
+	for (const std::pair<const uint32_t, const TypeCounters*> &e : types)
+	{
+		fprintf(fp, "%s\n    \"%u\": { \"from_uav\": %llu, \"to_uav\": %llu, \"bytes\": %llu, \"rate_hz\": %.1f }",
+			first ? "" : ",", e.first,
+			(unsigned long long)e.second->fromUAV, (unsigned long long)e.second->toUAV,
+			(unsigned long long)e.second->bytes, e.second->rate);
+		first = false;
+	}
+	fprintf(fp, "\n  }\n");
+	fprintf(fp, "}\n");
+}
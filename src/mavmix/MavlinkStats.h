@@ -0,0 +1,79 @@
+#ifndef MAVLINKSTATS_H
+#define MAVLINKSTATS_H
+
+#include "MAVLink/FrameScanner.h"
+
+#include <atomic>
+#include <stdint.h>
+#include <stdio.h>
+#include <unordered_map>
+
+/* Traffic counters, per UAV (i.e. per sysid) and per message type.
+ *
+ * Per-sysid counters are updated with relaxed atomic operations, so that
+ * they can be updated by any thread (e.g. by two shards while a UAV moves
+ * from one to the other). Each UAV is normally handled by a single shard,
+ * and its counters are aligned to separate cache lines, so shards never
+ * contend on them.
+ *
+ * Per-msgid counters, rates and the JSON dump are only accessed by the GCS
+ * thread, which sees every frame on its way to or from the GCSs.
+ */
+class MavlinkStats
+{
+	public:
+		MavlinkStats();
+
+		// C++14's new does not honour the alignment of the counters
+		static void *operator new(size_t size);
+		static void operator delete(void *ptr);
+
+		// Thread-safe
+		void recordFromUAV(const MAVLink::Frame &frame); // also checks CRC and sequence numbers
+		void recordToUAV(uint8_t sysid, size_t len);
+		void recordDropToGCS(uint8_t sysid); // frame from this UAV not delivered
+		void recordDropToUAV(uint8_t sysid); // frame to this UAV not delivered
+		void recordRateLimited(uint8_t sysid);
+
+		// GCS thread only
+		void recordMessageType(uint32_t msgid, size_t len, bool fromUAV);
+		void updateRates(); // to be called periodically, e.g. once per second
+		void writeJson(FILE *fp);
+
+		// current time (CLOCK_MONOTONIC) in nanoseconds
+		static uint64_t now();
+
+	private:
+		struct alignas(64) UavCounters
+		{
+			std::atomic<uint64_t> rxMessages, rxBytes;
+			std::atomic<uint64_t> txMessages, txBytes;
+			std::atomic<uint64_t> dropsToGCS, dropsToUAV, rateLimited;
+			std::atomic<uint64_t> crcErrors, seqLost;
+			std::atomic<uint64_t> lastSeen; // ns, 0 = never
+
+			// GCS thread only
+			uint64_t prevRxMessages;
+			double rxRate;
+		};
+
+		struct TypeCounters
+		{
+			uint64_t fromUAV, toUAV, bytes;
+
+			uint64_t prevFromUAV;
+			double rate;
+		};
+
+		uint64_t m_startTime, m_lastRateUpdate;
+
+		UavCounters m_uavs[256];
+
+		// next expected sequence number + 1 of each (sysid, compid), 0 if
+		// nothing has been received yet
+		std::atomic<uint16_t> m_nextSeq[256 * 256];
+
+		std::unordered_map<uint32_t, TypeCounters> m_types;
+};
+
+#endif // MAVLINKSTATS_H
@@ -0,0 +1,189 @@
+// Throughput benchmark of MAVLink::FrameScanner, compared to the byte-by-byte
+// mavlink_frame_char_buffer() parser of the MAVLink C library. It also checks
+// that the scanner resynchronizes on corrupted streams without losing frames.
+
+#include "MAVLink/FrameScanner.h"
+#include "MAVLink/MAVLink.h"
+
+#include <err.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <algorithm>
+#include <vector>
+
+// same size as TCPMavlinkConnection's receive buffer
+#define CHUNK_SIZE 65536
+
+static double now()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// Append a MAVLink 2 frame with random payload
+static void appendFrame(std::vector<uint8_t> &stream, uint32_t msgid, uint8_t sysid, uint8_t seq)
+{
+	const mavlink_msg_entry_t *e = mavlink_get_msg_entry(msgid);
+	if (e == nullptr)
+		errx(EXIT_FAILURE, "unknown msgid %u", msgid);
+
+	uint8_t frame[MAVLINK_MAX_PACKET_LEN];
+	frame[0] = MAVLINK_STX;
+	frame[1] = e->max_msg_len;
+	frame[2] = 0; // incompat_flags
+	frame[3] = 0; // compat_flags
+	frame[4] = seq;
+	frame[5] = sysid;
+	frame[6] = 1; // compid
+	frame[7] = msgid & 0xff;
+	frame[8] = (msgid >> 8) & 0xff;
+	frame[9] = (msgid >> 16) & 0xff;
+
+	for (unsigned i = 0; i < e->max_msg_len; i++)
+		frame[MAVLINK_NUM_HEADER_BYTES + i] = rand();
+
+	uint16_t crc = crc_calculate(frame + 1, MAVLINK_NUM_HEADER_BYTES - 1 + e->max_msg_len);
+	crc_accumulate(e->crc_extra, &crc);
+
+	frame[MAVLINK_NUM_HEADER_BYTES + e->max_msg_len] = crc & 0xff;
+	frame[MAVLINK_NUM_HEADER_BYTES + e->max_msg_len + 1] = crc >> 8;
+
+	stream.insert(stream.end(), frame, frame + MAVLINK_NUM_NON_PAYLOAD_BYTES + e->max_msg_len);
+}
+
+// Check that garbage between frames never causes valid frames to be lost,
+// wherever the chunk boundaries fall
+static void checkCorruptedStream(const uint32_t *msgids, size_t msgidCount)
+{
+	// STX markers announcing frames with unknown incompatibility flags: they
+	// are only rejected once the announced length has been received
+	const uint8_t fakeLong[] = { MAVLINK_STX, 255, 0x80 };
+	const uint8_t fakeShort[] = { MAVLINK_STX, 20, 0x80 };
+	const uint8_t junk[] = { 0x55, 0x00, 0xaa };
+
+	const size_t frameCount = 1000;
+	std::vector<uint8_t> stream;
+	for (size_t i = 0; i < frameCount; i++)
+	{
+		switch (i % 4)
+		{
+			case 1:
+				stream.insert(stream.end(), junk, junk + sizeof(junk));
+				break;
+			case 2:
+				stream.insert(stream.end(), fakeLong, fakeLong + sizeof(fakeLong));
+				break;
+			case 3:
+				stream.insert(stream.end(), fakeLong, fakeLong + sizeof(fakeLong));
+				stream.insert(stream.end(), fakeShort, fakeShort + sizeof(fakeShort));
+				break;
+		}
+
+		appendFrame(stream, msgids[i % msgidCount], 1, i);
+	}
+
+	// The last fake markers are only rejected when enough bytes follow them
+	stream.resize(stream.size() + MAVLINK_MAX_PACKET_LEN, 0);
+
+	const size_t chunkSizes[] = { 1, 7, 100, 300, CHUNK_SIZE };
+	for (size_t chunkSize : chunkSizes)
+	{
+		MAVLink::FrameScanner scanner;
+		size_t count = 0;
+		for (size_t pos = 0; pos < stream.size(); pos += chunkSize)
+		{
+			size_t len = std::min(chunkSize, stream.size() - pos);
+			scanner.scan(stream.data() + pos, len, [&](const MAVLink::Frame &f)
+			{
+				// frames must also come out in order
+				if (f.status == MAVLink::FRAME_OK && f.seq == (uint8_t)count)
+					count++;
+			});
+		}
+
+		if (count != frameCount)
+			errx(EXIT_FAILURE, "parsed %zu frames from the corrupted stream with %zu-byte chunks, expected %zu", count, chunkSize, frameCount);
+	}
+}
+
+int main(int argc, char *argv[])
+{
+	size_t frameCount = (argc > 1) ? atol(argv[1]) : 1000000;
+	int repetitions = (argc > 2) ? atoi(argv[2]) : 5;
+
+	if (frameCount == 0 || repetitions <= 0)
+	{
+		fprintf(stderr, "Usage: %s [frame_count [repetitions]]\n", program_invocation_name);
+		return EXIT_FAILURE;
+	}
+
+	// Typical telemetry mix
+	const uint32_t msgids[] =
+	{
+		MAVLINK_MSG_ID_HEARTBEAT,
+		MAVLINK_MSG_ID_ATTITUDE,
+		MAVLINK_MSG_ID_GLOBAL_POSITION_INT,
+		MAVLINK_MSG_ID_COMMAND_LONG,
+	};
+
+	std::vector<uint8_t> stream;
+	srand(1);
+	for (size_t i = 0; i < frameCount; i++)
+		appendFrame(stream, msgids[i % (sizeof(msgids) / sizeof(msgids[0]))], 1 + i % 200, i);
+
+	// Check that the fast CRC matches the library's
+	for (size_t len = 0; len < 300; len++)
+	{
+		if (MAVLink::crc_calculate_fast(stream.data(), len) != crc_calculate(stream.data(), len))
+			errx(EXIT_FAILURE, "crc_calculate_fast mismatch with length %zu", len);
+	}
+
+	checkCorruptedStream(msgids, sizeof(msgids) / sizeof(msgids[0]));
+
+	printf("%zu frames, %.1f MiB\n", frameCount, stream.size() / 1048576.0);
+
+	for (int rep = 0; rep < repetitions; rep++)
+	{
+		// Byte-by-byte state machine
+		mavlink_message_t rxmsg, msg;
+		mavlink_status_t status, msgStatus;
+		memset(&rxmsg, 0, sizeof(rxmsg));
+		memset(&status, 0, sizeof(status));
+
+		size_t countLib = 0;
+		double t0 = now();
+		for (size_t i = 0; i < stream.size(); i++)
+		{
+			if (mavlink_frame_char_buffer(&rxmsg, &status, stream[i], &msg, &msgStatus) == MAVLINK_FRAMING_OK)
+				countLib++;
+		}
+		double t1 = now();
+
+		// Bulk scanner, fed in CHUNK_SIZE pieces
+		MAVLink::FrameScanner scanner;
+		size_t countScanner = 0;
+		double t2 = now();
+		for (size_t pos = 0; pos < stream.size(); pos += CHUNK_SIZE)
+		{
+			size_t len = std::min((size_t)CHUNK_SIZE, stream.size() - pos);
+			scanner.scan(stream.data() + pos, len, [&](const MAVLink::Frame &f)
+			{
+				if (f.status == MAVLink::FRAME_OK)
+					countScanner++;
+			});
+		}
+		double t3 = now();
+
+		if (countLib != frameCount || countScanner != frameCount)
+			errx(EXIT_FAILURE, "parsed %zu (library) and %zu (scanner) frames, expected %zu", countLib, countScanner, frameCount);
+
+		printf("mavlink_frame_char_buffer: %8.2f Mmsgs/s   FrameScanner: %8.2f Mmsgs/s   speedup: %.1fx\n",
+			frameCount / (t1 - t0) / 1e6, frameCount / (t3 - t2) / 1e6, (t1 - t0) / (t3 - t2));
+	}
+
+	return EXIT_SUCCESS;
+}
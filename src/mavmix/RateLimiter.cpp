@@ -0,0 +1,47 @@
+#include "RateLimiter.h"
+#include "SendQueue.h"
+
+#include <time.h>
+
+RateLimiter::RateLimiter(const RateLimits &limits)
+{
+	for (const std::pair<const uint32_t, double> &it : limits)
+		m_minInterval[it.first] = 1e9 / it.second;
+}
+
+uint64_t RateLimiter::now()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+bool RateLimiter::allow(const MAVLink::Frame &frame, uint64_t now)
+{
+	std::unordered_map<uint32_t, uint64_t>::const_iterator lim = m_minInterval.find(frame.msgid);
+	if (lim == m_minInterval.end())
+		return true;
+
+	// Never hold back commands, missions and parameters
+	if (SendQueue::classify(frame.msgid) == SendQueue::CRITICAL)
+		return true;
+
+	uint32_t key = ((uint32_t)frame.sysid << 24) | frame.msgid;
+	std::pair<std::unordered_map<uint32_t, uint64_t>::iterator, bool> ins = m_lastAllowed.emplace(key, now);
+
+	if (ins.second)
+		return true; // first message
+
+	uint64_t &last = ins.first->second;
+	if (now - last < lim->second)
+		return false;
+
+	// Advance by one interval rather than to now, so that a stream arriving
+	// at exactly the allowed rate is not halved by jitter, but never fall
+	// more than one interval behind (i.e. no bursts after a pause)
+	last += lim->second;
+	if (now - last > lim->second)
+		last = now - lim->second;
+
+	return true;
+}
@@ -0,0 +1,37 @@
+#ifndef RATELIMITER_H
+#define RATELIMITER_H
+
+#include "CommandLineParser.h"
+
+#include "MAVLink/FrameScanner.h"
+
+#include <stdint.h>
+#include <unordered_map>
+
+/* Downsamples the messages sent to one GCS.
+ *
+ * For each (sysid, msgid) pair whose msgid has a configured limit, messages
+ * are let through at most once per 1/HZ seconds slot. Slots are scheduled
+ * from the previous one rather than from the arrival time of the last
+ * message, so that arrival jitter does not lower the rate.
+ */
+class RateLimiter
+{
+	public:
+		explicit RateLimiter(const RateLimits &limits);
+
+		// now is in nanoseconds
+		bool allow(const MAVLink::Frame &frame, uint64_t now);
+
+		// current time (CLOCK_MONOTONIC) in nanoseconds
+		static uint64_t now();
+
+	private:
+		// msgid -> minimum interval between messages (ns)
+		std::unordered_map<uint32_t, uint64_t> m_minInterval;
+
+		// (sysid << 24) | msgid -> start of the last slot that was used
+		std::unordered_map<uint32_t, uint64_t> m_lastAllowed;
+};
+
+#endif // RATELIMITER_H
@@ -0,0 +1,262 @@
+#include "SendQueue.h"
+
+#include <errno.h>
+#include <limits.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+
+// maximum number of slots sent by each flush()
+#define MAX_IOV 64
+
+// fraction of the capacity above which stale TELEMETRY frames are merged
+#define MERGE_WATERMARK_FRACTION 0.5
+
+SendQueue::SendQueue(size_t capacity)
+: m_head(0), m_tail(0), m_headOffset(0), m_dropped(0)
+{
+	// round up to a power of two
+	size_t n = 1;
+	while (n < capacity)
+		n *= 2;
+
+	m_slots.resize(n);
+	m_mask = n - 1;
+	m_mergeWatermark = (uint64_t)(n * MERGE_WATERMARK_FRACTION);
+}
+
+SendQueue::Class SendQueue::classify(uint32_t msgid)
+{
+	switch (msgid)
+	{
+		case MAVLINK_MSG_ID_SET_MODE:
+		case MAVLINK_MSG_ID_PARAM_REQUEST_READ:
+		case MAVLINK_MSG_ID_PARAM_REQUEST_LIST:
+		case MAVLINK_MSG_ID_PARAM_VALUE:
+		case MAVLINK_MSG_ID_PARAM_SET:
+		case MAVLINK_MSG_ID_MISSION_ITEM:
+		case MAVLINK_MSG_ID_MISSION_REQUEST:
+		case MAVLINK_MSG_ID_MISSION_SET_CURRENT:
+		case MAVLINK_MSG_ID_MISSION_REQUEST_LIST:
+		case MAVLINK_MSG_ID_MISSION_COUNT:
+		case MAVLINK_MSG_ID_MISSION_CLEAR_ALL:
+		case MAVLINK_MSG_ID_MISSION_ACK:
+		case MAVLINK_MSG_ID_MISSION_REQUEST_INT:
+		case MAVLINK_MSG_ID_MISSION_ITEM_INT:
+		case MAVLINK_MSG_ID_COMMAND_INT:
+		case MAVLINK_MSG_ID_COMMAND_LONG:
+		case MAVLINK_MSG_ID_COMMAND_ACK:
+		case MAVLINK_MSG_ID_STATUSTEXT:
+			return CRITICAL;
+		default:
+			return TELEMETRY;
+	}
+}
+
+bool SendQueue::isMergeable(uint32_t msgid)
+{
+	switch (msgid)
+	{
+		case MAVLINK_MSG_ID_FILE_TRANSFER_PROTOCOL:
+		case MAVLINK_MSG_ID_LOG_ENTRY:
+		case MAVLINK_MSG_ID_LOG_DATA:
+		case MAVLINK_MSG_ID_GPS_INJECT_DATA:
+		case MAVLINK_MSG_ID_SERIAL_CONTROL:
+		case MAVLINK_MSG_ID_DATA_TRANSMISSION_HANDSHAKE:
+		case MAVLINK_MSG_ID_ENCAPSULATED_DATA:
+		case MAVLINK_MSG_ID_GPS_RTCM_DATA:
+			return false;
+		default:
+			return true;
+	}
+}
+
+SendQueue::Slot &SendQueue::slot(uint64_t idx)
+{
+	return m_slots[idx & m_mask];
+}
+
+bool SendQueue::empty() const
+{
+	return m_head == m_tail;
+}
+
+uint64_t SendQueue::droppedCount() const
+{
+	return m_dropped;
+}
+
+void SendQueue::setDropHandler(const std::function<void(uint8_t sysid)> &cb)
+{
+	m_dropHandler = cb;
+}
+
+void SendQueue::recordDrop(uint64_t key)
+{
+	m_dropped++;
+
+	if (m_dropHandler)
+		m_dropHandler(key >> 40);
+}
+
+bool SendQueue::push(const MAVLink::Frame &frame)
+{
+	Class cls = classify(frame.msgid);
+	uint64_t key = ((uint64_t)frame.sysid << 40) | ((uint64_t)frame.compid << 32) | frame.msgid;
+	bool mergeable = cls == TELEMETRY && isMergeable(frame.msgid);
+
+	if (mergeable && m_tail - m_head >= m_mergeWatermark)
+	{
+		// The peer is falling behind: a queued frame with the same key
+		// is now stale
+		std::unordered_map<uint64_t, uint64_t>::iterator it = m_latest.find(key);
+		if (it != m_latest.end() && (it->second != m_head || m_headOffset == 0))
+		{
+			discard(it->second);
+			recordDrop(key);
+		}
+	}
+
+	if (m_tail - m_head == m_slots.size())
+	{
+		compact();
+
+		if (m_tail - m_head == m_slots.size() && !evictOldestTelemetry())
+		{
+			if (cls == CRITICAL)
+				return false;
+
+			recordDrop(key);
+			return true;
+		}
+	}
+
+	uint64_t idx = m_tail++;
+	Slot &s = slot(idx);
+	s.live = true;
+	s.cls = cls;
+	s.len = frame.len;
+	s.key = key;
+	memcpy(s.data, frame.data, frame.len);
+
+	if (mergeable)
+		m_latest[key] = idx;
+
+	return true;
+}
+
+void SendQueue::discard(uint64_t idx)
+{
+	Slot &s = slot(idx);
+	s.live = false;
+
+	if (s.cls == TELEMETRY)
+	{
+		std::unordered_map<uint64_t, uint64_t>::iterator it = m_latest.find(s.key);
+		if (it != m_latest.end() && it->second == idx)
+			m_latest.erase(it);
+	}
+
+	popDeadHead();
+}
+
+void SendQueue::popDeadHead()
+{
+	while (m_head != m_tail && !slot(m_head).live)
+	{
+		m_head++;
+		m_headOffset = 0;
+	}
+}
+
+// Remove discarded slots from the middle of the queue, preserving order
+void SendQueue::compact()
+{
+	uint64_t w = m_head;
+	for (uint64_t r = m_head; r != m_tail; r++)
+	{
+		if (!slot(r).live)
+			continue;
+
+		if (w != r)
+		{
+			Slot &s = slot(w);
+			s = slot(r);
+			std::unordered_map<uint64_t, uint64_t>::iterator it = m_latest.find(s.key);
+			if (it != m_latest.end() && it->second == r)
+				it->second = w;
+		}
+
+		w++;
+	}
+
+	m_tail = w;
+}
+
+// Discard the oldest TELEMETRY frame that has not been partially sent yet,
+// and compact the queue
+bool SendQueue::evictOldestTelemetry()
+{
+	for (uint64_t i = m_head; i != m_tail; i++)
+	{
+		const Slot &s = slot(i);
+		if (s.cls == TELEMETRY && (i != m_head || m_headOffset == 0))
+		{
+			discard(i);
+			recordDrop(s.key);
+			compact();
+			return true;
+		}
+	}
+
+	return false;
+}
+
+bool SendQueue::flush(int fd)
+{
+	iovec iov[MAX_IOV];
+	int iovcnt = 0;
+
+	for (uint64_t i = m_head; i != m_tail && iovcnt < MAX_IOV; i++)
+	{
+		Slot &s = slot(i);
+		if (!s.live)
+			continue;
+
+		size_t offset = (i == m_head) ? m_headOffset : 0;
+		iov[iovcnt].iov_base = s.data + offset;
+		iov[iovcnt].iov_len = s.len - offset;
+		iovcnt++;
+	}
+
+	if (iovcnt == 0)
+		return true;
+
+	msghdr mh;
+	memset(&mh, 0, sizeof(mh));
+	mh.msg_iov = iov;
+	mh.msg_iovlen = iovcnt;
+
+	ssize_t r = sendmsg(fd, &mh, MSG_NOSIGNAL | MSG_DONTWAIT);
+	if (r < 0)
+		return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+
+	// Release the slots that have been completely sent
+	size_t sent = r;
+	while (sent != 0)
+	{
+		Slot &s = slot(m_head);
+		size_t remaining = s.len - m_headOffset;
+
+		if (sent < remaining)
+		{
+			m_headOffset += sent;
+			break;
+		}
+
+		sent -= remaining;
+		discard(m_head);
+	}
+
+	return true;
+}
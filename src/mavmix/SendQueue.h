@@ -0,0 +1,96 @@
+#ifndef SENDQUEUE_H
+#define SENDQUEUE_H
+
+#include "MAVLink/FrameScanner.h"
+
+#include <functional>
+#include <stdint.h>
+#include <unordered_map>
+#include <vector>
+
+/* Bounded queue of outgoing MAVLink frames.
+ *
+ * Frames are stored in a ring of fixed-size slots and are sent in batches,
+ * with a single sendmsg() call per flush(). Partial sends are resumed by the
+ * next flush().
+ *
+ * Each frame is either CRITICAL (commands, missions, parameters) or
+ * TELEMETRY. Frames are only dropped when the peer is not keeping up:
+ *  - above the merge watermark, a TELEMETRY frame makes any queued (and not
+ *    yet partially sent) frame with the same sysid, compid and msgid stale,
+ *    and the stale frame is discarded. Stream messages (logs, file transfers,
+ *    GPS corrections) are never merged, as each frame carries different data;
+ *  - when the queue is full, the oldest TELEMETRY frames are discarded to
+ *    make room. CRITICAL frames are never discarded.
+ */
+class SendQueue
+{
+	public:
+		enum Class
+		{
+			TELEMETRY,
+			CRITICAL
+		};
+
+		// capacity is the maximum number of queued frames
+		explicit SendQueue(size_t capacity);
+
+		static Class classify(uint32_t msgid);
+
+		// whether a newer TELEMETRY frame supersedes a queued one
+		static bool isMergeable(uint32_t msgid);
+
+		// returns false if the frame is CRITICAL and the queue is full of
+		// other CRITICAL frames
+		bool push(const MAVLink::Frame &frame);
+
+		bool empty() const;
+
+		// send as much as possible with one sendmsg() call on a non-blocking
+		// socket. Returns false if the socket failed
+		bool flush(int fd);
+
+		// number of TELEMETRY frames that have been discarded so far
+		uint64_t droppedCount() const;
+
+		// called with the sysid of each discarded TELEMETRY frame, which may
+		// be older than the frame being pushed
+		void setDropHandler(const std::function<void(uint8_t sysid)> &cb);
+
+	private:
+		struct Slot
+		{
+			bool live;
+			uint8_t cls;
+			uint16_t len;
+			uint64_t key; // (sysid << 40) | (compid << 32) | msgid
+			uint8_t data[MAVLINK_MAX_PACKET_LEN];
+		};
+
+		Slot &slot(uint64_t idx);
+
+		void discard(uint64_t idx);
+		void recordDrop(uint64_t key);
+		void popDeadHead();
+		void compact();
+		bool evictOldestTelemetry();
+
+		std::vector<Slot> m_slots;
+		uint64_t m_mask;
+
+		// m_head and m_tail grow monotonically, slots in [m_head, m_tail)
+		// are in use. m_headOffset bytes of the head slot have been sent
+		uint64_t m_head, m_tail;
+		size_t m_headOffset;
+
+		// merging starts when this many slots are in use
+		uint64_t m_mergeWatermark;
+
+		// newest queued mergeable frame for each key
+		std::unordered_map<uint64_t, uint64_t> m_latest;
+
+		uint64_t m_dropped;
+		std::function<void(uint8_t sysid)> m_dropHandler;
+};
+
+#endif // SENDQUEUE_H
@@ -0,0 +1,185 @@
+#include "Shard.h"
+
+#include <sys/socket.h>
+
+// Maximum number of frames waiting to be dispatched by each shard
+#define INBOX_CAPACITY 4096
+
+// index + 1 of the shard that each sysid is connected to, 0 if unknown
+std::atomic<int> Shard::s_sysidShard[256];
+std::vector<Shard*> Shard::s_shards;
+
+Shard::Shard(int index, int listenFd, int udpFd, FrameQueue *toGCS, MavlinkStats *stats)
+: m_index(index), m_listenFd(listenFd), m_toGCS(toGCS), m_stats(stats),
+  m_inbox(INBOX_CAPACITY), m_broadcastInbox(INBOX_CAPACITY), m_udp(nullptr)
+{
+	s_shards.push_back(this);
+
+	m_inbox.setHandler([this](const MAVLink::Frame &frame)
+	{
+		uint8_t target = frame.targetSystem();
+		if (m_sysid2uav.count(target) != 0)
+		{
+			deliver(frame);
+			return;
+		}
+
+		// The UAV has reconnected elsewhere since the GCS thread looked it
+		// up: follow it, or give every shard a chance if it is unknown.
+		// Broadcast frames are never rerouted, so frames cannot multiply
+		int owner = shardOf(target);
+		if (owner != -1 && owner != m_index)
+		{
+			if (!s_shards[owner]->send(frame) && m_stats != nullptr)
+				m_stats->recordDropToUAV(target);
+		}
+		else
+		{
+			for (Shard *s : s_shards)
+				s->broadcast(frame);
+		}
+	});
+
+	m_broadcastInbox.setHandler(std::bind(&Shard::deliver, this, std::placeholders::_1));
+
+	m_pg.add(&m_inbox);
+	m_pg.add(&m_broadcastInbox);
+	m_pg.add(m_listenFd, [this]() { newConnection(accept(m_listenFd, nullptr, nullptr)); });
+
+	if (udpFd != -1)
+	{
+		m_udp = new UDPMavlinkEndpoint(udpFd, &m_pg);
+		m_udp->setMessageHandler(std::bind(&Shard::handleFrame, this, std::placeholders::_1, std::placeholders::_2));
+		m_udp->setNewPeerHandler([this](UDPMavlinkEndpoint::Peer *peer) { m_uavs.insert(peer); });
+		m_udp->setPeerLostHandler(std::bind(&Shard::linkLost, this, std::placeholders::_1));
+	}
+
+	m_thread = std::thread(&Shard::threadMain, this);
+}
+
+bool Shard::send(const MAVLink::Frame &frame)
+{
+	return m_inbox.push(frame);
+}
+
+bool Shard::broadcast(const MAVLink::Frame &frame)
+{
+	return m_broadcastInbox.push(frame);
+}
+
+int Shard::shardOf(uint8_t sysid)
+{
+	return s_sysidShard[sysid].load(std::memory_order_relaxed) - 1;
+}
+
+void Shard::threadMain()
+{
+	while (true)
+		m_pg.runOnce();
+}
+
+void Shard::newConnection(int fd)
+{
+	if (fd < 0)
+		return;
+
+	TCPMavlinkConnection *uav = new TCPMavlinkConnection(fd, &m_pg);
+
+	uav->setMessageHandler([this, uav](const MAVLink::Frame &frame)
+	{
+		handleFrame(uav, frame);
+	});
+
+	// Frames queued for a UAV come from the GCSs: account them to the UAV
+	uav->setDropHandler([this, uav](uint8_t)
+	{
+		std::map<MavlinkLink*, uint8_t>::const_iterator s = m_uav2sysid.find(uav);
+		if (m_stats != nullptr && s != m_uav2sysid.end())
+			m_stats->recordDropToUAV(s->second);
+	});
+
+	uav->setConnectionLostHandler([this, uav]()
+	{
+		linkLost(uav);
+		delete uav;
+	});
+
+	m_uavs.insert(uav);
+}
+
+void Shard::deliver(const MAVLink::Frame &frame)
+{
+	// send to the target UAV only, if known
+	uint8_t target = frame.targetSystem();
+	std::map<uint8_t, MavlinkLink*>::const_iterator it = m_sysid2uav.find(target);
+
+	if (target != 0 && it != m_sysid2uav.end())
+	{
+		sendToUAV(it->second, target, frame);
+	}
+	else
+	{
+		// send to all UAVs
+		for (MavlinkLink *uav : m_uavs)
+		{
+			std::map<MavlinkLink*, uint8_t>::const_iterator s = m_uav2sysid.find(uav);
+			sendToUAV(uav, (s != m_uav2sysid.end()) ? s->second : 0, frame);
+		}
+	}
+}
+
+void Shard::handleFrame(MavlinkLink *uav, const MAVLink::Frame &frame)
+{
+	// learn which link leads to this sysid (a corrupted header must not
+	// steal the route of another UAV)
+	if (frame.msgid == MAVLINK_MSG_ID_HEARTBEAT && frame.status == MAVLink::FRAME_OK)
+	{
+		m_sysid2uav[frame.sysid] = uav;
+		m_uav2sysid[uav] = frame.sysid;
+		s_sysidShard[frame.sysid].store(m_index + 1, std::memory_order_relaxed);
+	}
+
+	if (m_stats != nullptr)
+		m_stats->recordFromUAV(frame);
+
+	if (!m_toGCS->push(frame) && m_stats != nullptr)
+		m_stats->recordDropToGCS(frame.sysid);
+}
+
+// sysid is 0 if unknown
+void Shard::sendToUAV(MavlinkLink *uav, uint8_t sysid, const MAVLink::Frame &frame)
+{
+	bool sent = uav->send(frame);
+
+	if (m_stats == nullptr || sysid == 0)
+		return;
+
+	if (sent)
+		m_stats->recordToUAV(sysid, frame.len);
+	else
+		m_stats->recordDropToUAV(sysid);
+}
+
+// Forget a link that is about to be deleted
+void Shard::linkLost(MavlinkLink *uav)
+{
+	m_uavs.erase(uav);
+	m_uav2sysid.erase(uav);
+
+	std::map<uint8_t, MavlinkLink*>::iterator it = m_sysid2uav.begin();
+	while (it != m_sysid2uav.end())
+	{
+		if (it->second == uav)
+		{
+			// unless the sysid has moved to another shard in the meantime
+			int expected = m_index + 1;
+			s_sysidShard[it->first].compare_exchange_strong(expected, 0);
+
+			it = m_sysid2uav.erase(it);
+		}
+		else
+		{
+			++it;
+		}
+	}
+}
@@ -0,0 +1,77 @@
+#ifndef SHARD_H
+#define SHARD_H
+
+#include "FrameQueue.h"
+#include "MavlinkStats.h"
+#include "MavlinkLink.h"
+#include "TCPMavlinkConnection.h"
+#include "UDPMavlinkEndpoint.h"
+
+#include "IO/Poll.h"
+#include "MAVLink/FrameScanner.h"
+
+#include <atomic>
+#include <map>
+#include <set>
+#include <thread>
+#include <vector>
+
+/* A worker thread that owns a subset of the UAV connections.
+ *
+ * Each shard accepts UAV connections on its own listening socket (all shards
+ * listen on the same port with SO_REUSEPORT, so that the kernel spreads new
+ * connections across them) and runs its own PollGroup. Frames received from
+ * UAVs are pushed to the GCS thread's queue; frames from GCSs are pushed to
+ * the shard's inboxes by the GCS thread.
+ *
+ * A shard can also serve UAVs that connect through a UDP endpoint.
+ */
+class Shard
+{
+	public:
+		// udpFd is a bound UDP socket, or -1. stats can be nullptr. Shards
+		// must be created in index order, before any frame is sent to them
+		Shard(int index, int listenFd, int udpFd, FrameQueue *toGCS, MavlinkStats *stats);
+
+		// Deliver a frame from a GCS to the UAV it targets, which shardOf()
+		// says is connected to this shard. If the UAV has moved in the
+		// meantime, the frame follows it or, if it is not connected
+		// anywhere, it is broadcast to all shards
+		bool send(const MAVLink::Frame &frame);
+
+		// Deliver a frame from a GCS that is sent to every shard to the UAV
+		// it targets, if it is connected to this shard, or to all of this
+		// shard's UAVs
+		bool broadcast(const MAVLink::Frame &frame);
+
+		// Index of the shard that the given sysid is connected to, or -1
+		static int shardOf(uint8_t sysid);
+
+	private:
+		void threadMain();
+		void newConnection(int fd);
+		void deliver(const MAVLink::Frame &frame);
+		void handleFrame(MavlinkLink *uav, const MAVLink::Frame &frame);
+		void linkLost(MavlinkLink *uav);
+		void sendToUAV(MavlinkLink *uav, uint8_t sysid, const MAVLink::Frame &frame);
+
+		int m_index;
+		int m_listenFd;
+		FrameQueue *m_toGCS;
+		MavlinkStats *m_stats;
+		FrameQueue m_inbox, m_broadcastInbox;
+
+		// only accessed by the shard's own thread
+		IO::PollGroup m_pg;
+		UDPMavlinkEndpoint *m_udp;
+		std::set<MavlinkLink*> m_uavs;
+		std::map<uint8_t, MavlinkLink*> m_sysid2uav; // learnt from HEARTBEATs
+		std::map<MavlinkLink*, uint8_t> m_uav2sysid; // the opposite
+
+		std::thread m_thread;
+
+		static std::atomic<int> s_sysidShard[256];
+		static std::vector<Shard*> s_shards; // by index
+};
+
+#endif // SHARD_H
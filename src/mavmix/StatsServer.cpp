@@ -0,0 +1,146 @@
+#include "StatsServer.h"
+
+#include <err.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/timerfd.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+// How long a client has to receive its dump
+#define CLIENT_TIMEOUT_NS 5000000000ULL
+
+StatsServer::StatsServer(const char *socketPath, MavlinkStats *stats, IO::PollGroup *pg)
+: m_socketPath(socketPath), m_stats(stats), m_pg(pg)
+{
+	struct sockaddr_un addr;
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	if (m_socketPath.length() >= sizeof(addr.sun_path))
+		errx(EXIT_FAILURE, "StatsServer: socket path is too long: %s", socketPath);
+	strcpy(addr.sun_path, socketPath);
+
+	m_listenFd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+	if (m_listenFd < 0)
+		err(EXIT_FAILURE, "StatsServer: socket failed");
+
+	// remove stale socket left by a previous run
+	unlink(socketPath);
+
+	if (bind(m_listenFd, (struct sockaddr*)&addr, sizeof(addr)) < 0)
+		err(EXIT_FAILURE, "StatsServer: bind(%s) failed", socketPath);
+
+	listen(m_listenFd, 16);
+
+	m_timerFd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+	if (m_timerFd < 0)
+		err(EXIT_FAILURE, "StatsServer: timerfd_create failed");
+
+	struct itimerspec its;
+	its.it_interval.tv_sec = its.it_value.tv_sec = 1;
+	its.it_interval.tv_nsec = its.it_value.tv_nsec = 0;
+	timerfd_settime(m_timerFd, 0, &its, nullptr);
+
+	m_pg->add(m_listenFd, std::bind(&StatsServer::serveClient, this));
+	m_pg->add(m_timerFd, std::bind(&StatsServer::tick, this));
+}
+
+StatsServer::~StatsServer()
+{
+	while (!m_clients.empty())
+		closeClient(m_clients.begin()->first);
+
+	m_pg->remove(m_listenFd);
+	m_pg->remove(m_timerFd);
+	close(m_listenFd);
+	close(m_timerFd);
+	unlink(m_socketPath.c_str());
+}
+
+void StatsServer::serveClient()
+{
+	int fd = accept4(m_listenFd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+	if (fd < 0)
+		return;
+
+	char *text;
+	size_t len;
+	FILE *fp = open_memstream(&text, &len);
+	m_stats->writeJson(fp);
+	fclose(fp);
+
+	Client &c = m_clients[fd];
+	c.text.assign(text, len);
+	c.sent = 0;
+	c.deadline = MavlinkStats::now() + CLIENT_TIMEOUT_NS;
+	free(text);
+
+	// Anything the client sends is ignored, but end-of-stream means that it
+	// has gone away
+	m_pg->add(fd, [this, fd]()
+	{
+		char buf[256];
+		ssize_t r = recv(fd, buf, sizeof(buf), 0);
+		if (r == 0 || (r < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR))
+			closeClient(fd);
+	});
+
+	sendToClient(fd);
+}
+
+void StatsServer::sendToClient(int fd)
+{
+	Client &c = m_clients[fd];
+
+	while (c.sent < c.text.length())
+	{
+		ssize_t r = send(fd, c.text.data() + c.sent, c.text.length() - c.sent, MSG_NOSIGNAL);
+		if (r < 0 && errno == EINTR)
+			continue;
+
+		if (r < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+		{
+			// resume when the client has read some data
+			m_pg->setWriteHandler(fd, std::bind(&StatsServer::sendToClient, this, fd));
+			return;
+		}
+
+		if (r <= 0)
+			break;
+
+		c.sent += r;
+	}
+
+	closeClient(fd);
+}
+
+void StatsServer::closeClient(int fd)
+{
+	m_pg->remove(fd);
+	m_clients.erase(fd);
+	close(fd);
+}
+
+void StatsServer::tick()
+{
+	uint64_t expirations;
+	if (read(m_timerFd, &expirations, sizeof(expirations)) != sizeof(expirations))
+		return;
+
+	m_stats->updateRates();
+
+	// Disconnect clients that are not reading
+	uint64_t now = MavlinkStats::now();
+	std::map<int, Client>::iterator it = m_clients.begin();
+	while (it != m_clients.end())
+	{
+		int fd = it->first;
+		bool expired = it->second.deadline <= now;
+		++it; // closeClient() invalidates the iterator
+
+		if (expired)
+			closeClient(fd);
+	}
+}
@@ -0,0 +1,51 @@
+#ifndef STATSSERVER_H
+#define STATSSERVER_H
+
+#include "MavlinkStats.h"
+
+#include "IO/Poll.h"
+
+#include <map>
+#include <stdint.h>
+#include <string>
+
+/* Serves MavlinkStats over a UNIX stream socket: each client that connects
+ * receives a JSON dump, after which the connection is closed. E.g.:
+ *
+ *   socat - UNIX-CONNECT:/path/to/socket
+ *
+ * Dumps are sent through the poll group without blocking, so that a slow
+ * client never stalls the GCS thread. Clients that have not received the
+ * whole dump within a few seconds are disconnected.
+ *
+ * Rates are updated once per second by a timer.
+ */
+class StatsServer
+{
+	public:
+		// The server adds its file descriptors to pg
+		StatsServer(const char *socketPath, MavlinkStats *stats, IO::PollGroup *pg);
+		~StatsServer();
+
+	private:
+		struct Client
+		{
+			std::string text;
+			size_t sent;
+			uint64_t deadline; // MavlinkStats::now() timebase
+		};
+
+		void serveClient();
+		void sendToClient(int fd);
+		void closeClient(int fd);
+		void tick();
+
+		std::string m_socketPath;
+		MavlinkStats *m_stats;
+		IO::PollGroup *m_pg;
+		int m_listenFd, m_timerFd;
+
+		std::map<int, Client> m_clients; // fd -> pending output
+};
+
+#endif // STATSSERVER_H
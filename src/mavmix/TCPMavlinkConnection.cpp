@@ -0,0 +1,124 @@
+#include "TCPMavlinkConnection.h"
+
+#include <err.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+// Maximum number of frames waiting to be sent on each connection
+#define SEND_QUEUE_CAPACITY 1024
+
+TCPMavlinkConnection::TCPMavlinkConnection(int fd, IO::PollGroup *pg)
+: m_fd(fd), m_pg(pg), m_sendQueue(SEND_QUEUE_CAPACITY), m_waitingWritable(false), m_overflow(false)
+{
+	// Writes must never block
+	int flags = fcntl(m_fd, F_GETFL, 0);
+	fcntl(m_fd, F_SETFL, flags | O_NONBLOCK);
+
+	m_pg->add(this);
+}
+
+TCPMavlinkConnection::~TCPMavlinkConnection()
+{
+	m_pg->remove(this);
+	close(m_fd);
+}
+
+void TCPMavlinkConnection::setMessageHandler(const std::function<void(const MAVLink::Frame &frame)> &cb)
+{
+	m_recvMsg = cb;
+}
+
+void TCPMavlinkConnection::setConnectionLostHandler(const std::function<void()> &cb)
+{
+	m_connLost = cb;
+}
+
+void TCPMavlinkConnection::setDropHandler(const std::function<void(uint8_t sysid)> &cb)
+{
+	m_sendQueue.setDropHandler(cb);
+}
+
+int TCPMavlinkConnection::fd() const
+{
+	return m_fd;
+}
+
+void TCPMavlinkConnection::runOnce()
+{
+	uint8_t data[65536];
+	int r = recv(m_fd, data, sizeof(data), 0);
+
+	if (r < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR))
+		return;
+
+	if (r <= 0)
+	{
+		connectionLost();
+		return;
+	}
+
+	if (m_recvMsg)
+		m_scanner.scan(data, r, m_recvMsg);
+}
+
+bool TCPMavlinkConnection::send(const MAVLink::Frame &frame)
+{
+	if (m_overflow)
+		return false;
+
+	if (!m_sendQueue.push(frame))
+	{
+		// The peer has stopped reading, and we cannot drop the message.
+		// Closing the connection here would invalidate the caller's
+		// iterators: shut the socket down instead, so that runOnce() sees
+		// end-of-stream at the next poll, even if the peer never makes the
+		// socket writable again
+		warnx("Send queue of connection on socket %d is full, disconnecting", m_fd);
+		m_overflow = true;
+		shutdown(m_fd, SHUT_RDWR);
+	}
+
+	// If nothing was already waiting, try to send right away. Otherwise,
+	// or if the socket's buffer is full, wait until the socket is writable,
+	// so that all the messages enqueued in the meantime are sent together.
+	// Socket errors are reported by flush(), for the same reason as above
+	if (!m_waitingWritable && !m_overflow
+		&& (!m_sendQueue.flush(m_fd) || !m_sendQueue.empty()))
+	{
+		m_pg->setWriteHandler(m_fd, std::bind(&TCPMavlinkConnection::flush, this));
+		m_waitingWritable = true;
+	}
+
+	return !m_overflow;
+}
+
+void TCPMavlinkConnection::flush()
+{
+	if (m_overflow || !m_sendQueue.flush(m_fd))
+	{
+		connectionLost();
+		return;
+	}
+
+	if (m_sendQueue.empty())
+	{
+		m_pg->clearWriteHandler(m_fd);
+		m_waitingWritable = false;
+	}
+}
+
+void TCPMavlinkConnection::connectionLost()
+{
+	// Stop watching for writability, as the handler may delete this object
+	if (m_waitingWritable)
+	{
+		m_pg->clearWriteHandler(m_fd);
+		m_waitingWritable = false;
+	}
+
+	if (m_connLost)
+		m_connLost();
+}
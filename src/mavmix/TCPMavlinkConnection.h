@@ -0,0 +1,53 @@
+#ifndef TCPMAVLINKCONNECTION_H
+#define TCPMAVLINKCONNECTION_H
+
+#include "MavlinkLink.h"
+#include "SendQueue.h"
+
+#include "IO/Poll.h"
+#include "MAVLink/FrameScanner.h"
+
+#include <functional>
+
+class TCPMavlinkConnection : public IO::Pollable, public MavlinkLink
+{
+	public:
+		// The connection adds itself to pg
+		TCPMavlinkConnection(int fd, IO::PollGroup *pg);
+		~TCPMavlinkConnection() override;
+
+		// frame points to the raw bytes of the message, as received
+		void setMessageHandler(const std::function<void(const MAVLink::Frame &frame)> &cb);
+		void setConnectionLostHandler(const std::function<void()> &cb);
+
+		// called with the sysid of each queued or incoming TELEMETRY frame
+		// that the send queue discards because the peer is not keeping up
+		void setDropHandler(const std::function<void(uint8_t sysid)> &cb);
+
+		int fd() const override;
+		void runOnce() override;
+
+		// Send a message, or enqueue it if the socket is not writable.
+		// Returns false if the connection is being closed because the queue
+		// is full; frames discarded by the queue are reported to the drop
+		// handler instead
+		bool send(const MAVLink::Frame &frame) override;
+
+	private:
+		void flush();
+		void connectionLost();
+
+		int m_fd;
+		IO::PollGroup *m_pg;
+
+		MAVLink::FrameScanner m_scanner;
+
+		SendQueue m_sendQueue;
+		bool m_waitingWritable;
+		bool m_overflow; // a message could not be enqueued
+
+		std::function<void(const MAVLink::Frame &frame)> m_recvMsg;
+		std::function<void()> m_connLost;
+};
+
+#endif // TCPMAVLINKCONNECTION_H
@@ -0,0 +1,48 @@
+#include "TlogRecorder.h"
+
+#include <err.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <time.h>
+
+// Size of the ring buffer between the main loop and the writer thread
+#define RING_SIZE (32 * 1024 * 1024)
+
+TlogRecorder::TlogRecorder(const char *path)
+: m_dropped(0)
+{
+	int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+	if (fd < 0)
+		err(EXIT_FAILURE, "TlogRecorder: cannot create %s", path);
+
+	m_writer = new IO::BackgroundWriter(fd, RING_SIZE);
+}
+
+TlogRecorder::~TlogRecorder()
+{
+	// flushes all pending data
+	delete m_writer;
+
+	if (m_dropped != 0)
+		warnx("TlogRecorder: %llu frames were dropped", (unsigned long long)m_dropped);
+}
+
+void TlogRecorder::record(const MAVLink::Frame &frame)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_REALTIME, &ts);
+	uint64_t usec = (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+
+	uint8_t timestamp[8];
+	for (int i = 0; i < 8; i++)
+		timestamp[i] = usec >> (56 - 8 * i);
+
+	struct iovec iov[2] =
+	{
+		{ timestamp, sizeof(timestamp) },
+		{ const_cast<uint8_t*>(frame.data), frame.len }
+	};
+
+	if (!m_writer->write(iov, 2))
+		m_dropped++;
+}
@@ -0,0 +1,28 @@
+#ifndef TLOGRECORDER_H
+#define TLOGRECORDER_H
+
+#include "IO/BackgroundWriter.h"
+#include "MAVLink/FrameScanner.h"
+
+#include <stdint.h>
+
+/* Records MAVLink frames to a .tlog file, i.e. each frame is preceded by its
+ * reception time (microseconds since the Unix epoch, 64-bit big endian).
+ *
+ * Frames are handed to a background writer thread: if it cannot keep up,
+ * frames are dropped (and counted) instead of delaying the caller.
+ */
+class TlogRecorder
+{
+	public:
+		explicit TlogRecorder(const char *path);
+		~TlogRecorder();
+
+		void record(const MAVLink::Frame &frame);
+
+	private:
+		IO::BackgroundWriter *m_writer;
+		uint64_t m_dropped;
+};
+
+#endif // TLOGRECORDER_H
@@ -0,0 +1,261 @@
+#include "UDPMavlinkEndpoint.h"
+#include "RateLimiter.h"
+
+#include <err.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+
+// Size of the receive buffer of each datagram in a recvmmsg() batch
+#define MAX_DATAGRAM_SIZE 4096
+
+// Peers are forgotten after this many nanoseconds of silence (GCSs and
+// autopilots send a HEARTBEAT every second)
+#define PEER_TIMEOUT 30000000000ULL
+
+static uint64_t peerKey(const struct sockaddr_in &addr)
+{
+	return ((uint64_t)ntohl(addr.sin_addr.s_addr) << 16) | ntohs(addr.sin_port);
+}
+
+UDPMavlinkEndpoint::Peer::Peer(UDPMavlinkEndpoint *endpoint, const struct sockaddr_in &addr)
+: m_endpoint(endpoint), m_addr(addr), m_lastSeen(0)
+{
+}
+
+bool UDPMavlinkEndpoint::Peer::send(const MAVLink::Frame &frame)
+{
+	return m_endpoint->enqueue(m_addr, frame);
+}
+
+const struct sockaddr_in &UDPMavlinkEndpoint::Peer::address() const
+{
+	return m_addr;
+}
+
+UDPMavlinkEndpoint::UDPMavlinkEndpoint(int fd, IO::PollGroup *pg)
+: m_fd(fd), m_pg(pg), m_lastExpiry(0), m_recvBuffer(BATCH_SIZE * MAX_DATAGRAM_SIZE),
+  m_outgoing(BATCH_SIZE), m_outgoingCount(0), m_waitingWritable(false), m_dropped(0)
+{
+	// Writes must never block
+	int flags = fcntl(m_fd, F_GETFL, 0);
+	fcntl(m_fd, F_SETFL, flags | O_NONBLOCK);
+
+	m_pg->add(this);
+}
+
+UDPMavlinkEndpoint::~UDPMavlinkEndpoint()
+{
+	if (m_waitingWritable)
+		m_pg->clearWriteHandler(m_fd);
+
+	m_pg->remove(this);
+	close(m_fd);
+
+	for (std::pair<const uint64_t, Peer*> &p : m_peers)
+		delete p.second;
+}
+
+void UDPMavlinkEndpoint::setMessageHandler(const std::function<void(Peer *peer, const MAVLink::Frame &frame)> &cb)
+{
+	m_recvMsg = cb;
+}
+
+void UDPMavlinkEndpoint::setNewPeerHandler(const std::function<void(Peer *peer)> &cb)
+{
+	m_newPeer = cb;
+}
+
+void UDPMavlinkEndpoint::setPeerLostHandler(const std::function<void(Peer *peer)> &cb)
+{
+	m_peerLost = cb;
+}
+
+int UDPMavlinkEndpoint::fd() const
+{
+	return m_fd;
+}
+
+void UDPMavlinkEndpoint::runOnce()
+{
+	struct mmsghdr msgs[BATCH_SIZE];
+	struct iovec iovs[BATCH_SIZE];
+	struct sockaddr_in addrs[BATCH_SIZE];
+
+	memset(msgs, 0, sizeof(msgs));
+	for (int i = 0; i < BATCH_SIZE; i++)
+	{
+		iovs[i].iov_base = &m_recvBuffer[i * MAX_DATAGRAM_SIZE];
+		iovs[i].iov_len = MAX_DATAGRAM_SIZE;
+		msgs[i].msg_hdr.msg_name = &addrs[i];
+		msgs[i].msg_hdr.msg_namelen = sizeof(addrs[i]);
+		msgs[i].msg_hdr.msg_iov = &iovs[i];
+		msgs[i].msg_hdr.msg_iovlen = 1;
+	}
+
+	int n = recvmmsg(m_fd, msgs, BATCH_SIZE, MSG_DONTWAIT, nullptr);
+	if (n < 0)
+	{
+		if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+			warn("UDP endpoint on socket %d: recvmmsg failed", m_fd);
+		return;
+	}
+
+	uint64_t now = RateLimiter::now();
+
+	for (int i = 0; i < n; i++)
+	{
+		if (msgs[i].msg_hdr.msg_namelen != sizeof(struct sockaddr_in))
+			continue;
+
+		uint64_t key = peerKey(addrs[i]);
+		std::map<uint64_t, Peer*>::iterator it = m_peers.find(key);
+
+		Peer *peer;
+		if (it != m_peers.end())
+		{
+			peer = it->second;
+		}
+		else
+		{
+			peer = new Peer(this, addrs[i]);
+			m_peers.emplace(key, peer);
+
+			if (m_newPeer)
+				m_newPeer(peer);
+		}
+
+		peer->m_lastSeen = now;
+
+		// Truncated datagrams are still scanned: the partial frame at their
+		// end is discarded, frames never span datagrams
+		if (m_recvMsg)
+		{
+			peer->m_scanner.scan((const uint8_t*)iovs[i].iov_base, msgs[i].msg_len,
+				[&](const MAVLink::Frame &frame) { m_recvMsg(peer, frame); });
+			peer->m_scanner.reset();
+		}
+	}
+
+	expirePeers(now);
+}
+
+bool UDPMavlinkEndpoint::enqueue(const struct sockaddr_in &addr, const MAVLink::Frame &frame)
+{
+	// The batch is full: send it now
+	if (m_outgoingCount == m_outgoing.size())
+		flush();
+
+	// The socket's send buffer is full: UDP has no backpressure, so just
+	// drop the message
+	if (m_outgoingCount == m_outgoing.size())
+	{
+		m_dropped++;
+		return false;
+	}
+
+	Datagram &d = m_outgoing[m_outgoingCount++];
+	d.addr = addr;
+	d.len = frame.len;
+	memcpy(d.data, frame.data, frame.len);
+
+	// Wait until all the messages of this poll iteration have been enqueued
+	if (!m_waitingWritable)
+	{
+		m_pg->setWriteHandler(m_fd, std::bind(&UDPMavlinkEndpoint::onWritable, this));
+		m_waitingWritable = true;
+	}
+
+	return true;
+}
+
+void UDPMavlinkEndpoint::flush()
+{
+	struct mmsghdr msgs[BATCH_SIZE];
+	struct iovec iovs[BATCH_SIZE];
+
+	memset(msgs, 0, sizeof(msgs));
+	for (size_t i = 0; i < m_outgoingCount; i++)
+	{
+		iovs[i].iov_base = m_outgoing[i].data;
+		iovs[i].iov_len = m_outgoing[i].len;
+		msgs[i].msg_hdr.msg_name = &m_outgoing[i].addr;
+		msgs[i].msg_hdr.msg_namelen = sizeof(m_outgoing[i].addr);
+		msgs[i].msg_hdr.msg_iov = &iovs[i];
+		msgs[i].msg_hdr.msg_iovlen = 1;
+	}
+
+	size_t sent = 0;
+	while (sent < m_outgoingCount)
+	{
+		int n = sendmmsg(m_fd, msgs + sent, m_outgoingCount - sent, MSG_DONTWAIT);
+		if (n < 0)
+		{
+			if (errno == EINTR)
+				continue;
+
+			if (errno == EAGAIN || errno == EWOULDBLOCK)
+				break; // retry when the socket becomes writable again
+
+			// The datagram at the head of the batch cannot be sent (e.g. the
+			// destination is unreachable): skip it
+			m_dropped++;
+			sent++;
+			continue;
+		}
+
+		sent += n;
+	}
+
+	// Keep unsent datagrams at the beginning of the batch
+	if (sent != 0)
+	{
+		m_outgoingCount -= sent;
+		for (size_t i = 0; i < m_outgoingCount; i++)
+			m_outgoing[i] = m_outgoing[sent + i];
+	}
+
+	if (m_outgoingCount == 0 && m_waitingWritable)
+	{
+		m_pg->clearWriteHandler(m_fd);
+		m_waitingWritable = false;
+	}
+}
+
+void UDPMavlinkEndpoint::onWritable()
+{
+	flush();
+
+	// Peers that stay silent do not make the socket readable: check them
+	// here too, as long as we are sending to them. Not done in flush(), as
+	// it can be called by send(), i.e. while the caller is iterating over
+	// its peers
+	expirePeers(RateLimiter::now());
+}
+
+void UDPMavlinkEndpoint::expirePeers(uint64_t now)
+{
+	// Check at most once per second
+	if (now - m_lastExpiry < 1000000000ULL)
+		return;
+	m_lastExpiry = now;
+
+	std::map<uint64_t, Peer*>::iterator it = m_peers.begin();
+	while (it != m_peers.end())
+	{
+		Peer *peer = it->second;
+		if (now - peer->m_lastSeen < PEER_TIMEOUT)
+		{
+			++it;
+			continue;
+		}
+
+		it = m_peers.erase(it);
+
+		if (m_peerLost)
+			m_peerLost(peer);
+
+		delete peer;
+	}
+}
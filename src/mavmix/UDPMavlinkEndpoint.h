@@ -0,0 +1,95 @@
+#ifndef UDPMAVLINKENDPOINT_H
+#define UDPMAVLINKENDPOINT_H
+
+#include "MavlinkLink.h"
+
+#include "IO/Poll.h"
+#include "MAVLink/FrameScanner.h"
+
+#include <functional>
+#include <map>
+#include <netinet/in.h>
+#include <stdint.h>
+#include <sys/socket.h>
+#include <vector>
+
+/* A UDP socket that exchanges MAVLink frames with any number of peers.
+ *
+ * Peers are learnt from the source address of the datagrams they send, and
+ * forgotten if they stay silent for a while. Incoming datagrams are read in
+ * batches with recvmmsg(). Outgoing frames (one per datagram) are collected
+ * until the socket is reported writable by the PollGroup, i.e. until the
+ * handler that produced them has returned, and are then sent with a single
+ * sendmmsg() call.
+ */
+class UDPMavlinkEndpoint : public IO::Pollable
+{
+	public:
+		class Peer : public MavlinkLink
+		{
+			public:
+				bool send(const MAVLink::Frame &frame) override;
+
+				const struct sockaddr_in &address() const;
+
+			private:
+				friend class UDPMavlinkEndpoint;
+				Peer(UDPMavlinkEndpoint *endpoint, const struct sockaddr_in &addr);
+
+				UDPMavlinkEndpoint *m_endpoint;
+				struct sockaddr_in m_addr;
+				MAVLink::FrameScanner m_scanner;
+				uint64_t m_lastSeen;
+		};
+
+		// The endpoint adds itself to pg
+		UDPMavlinkEndpoint(int fd, IO::PollGroup *pg);
+		~UDPMavlinkEndpoint() override;
+
+		// frame points to the raw bytes of the message, as received
+		void setMessageHandler(const std::function<void(Peer *peer, const MAVLink::Frame &frame)> &cb);
+
+		// Called when a new peer is learnt, and right before a peer that has
+		// timed out is deleted
+		void setNewPeerHandler(const std::function<void(Peer *peer)> &cb);
+		void setPeerLostHandler(const std::function<void(Peer *peer)> &cb);
+
+		int fd() const override;
+		void runOnce() override;
+
+	private:
+		// Maximum number of datagrams per recvmmsg()/sendmmsg() call
+		static const int BATCH_SIZE = 64;
+
+		struct Datagram
+		{
+			struct sockaddr_in addr;
+			uint16_t len;
+			uint8_t data[MAVLINK_MAX_PACKET_LEN];
+		};
+
+		bool enqueue(const struct sockaddr_in &addr, const MAVLink::Frame &frame);
+		void flush();
+		void onWritable();
+		void expirePeers(uint64_t now);
+
+		int m_fd;
+		IO::PollGroup *m_pg;
+
+		// (IPv4 address << 16) | port -> peer
+		std::map<uint64_t, Peer*> m_peers;
+		uint64_t m_lastExpiry;
+
+		std::vector<uint8_t> m_recvBuffer;
+
+		std::vector<Datagram> m_outgoing;
+		size_t m_outgoingCount;
+		bool m_waitingWritable;
+		uint64_t m_dropped;
+
+		std::function<void(Peer *peer, const MAVLink::Frame &frame)> m_recvMsg;
+		std::function<void(Peer *peer)> m_newPeer;
+		std::function<void(Peer *peer)> m_peerLost;
+};
+
+#endif // UDPMAVLINKENDPOINT_H
@@ -1,170 +1,166 @@
+#include "CommandLineParser.h"
+#include "FrameQueue.h"
+#include "MavlinkStats.h"
+#include "RateLimiter.h"
+#include "Shard.h"
+#include "StatsServer.h"
+#include "TCPMavlinkConnection.h"
+#include "TlogRecorder.h"
+#include "UDPMavlinkEndpoint.h"
+
 #include "IO/Poll.h"
+#include "MAVLink/FrameScanner.h"
 #include "MAVLink/MAVLink.h"
 
 #include <arpa/inet.h>
 #include <err.h>
-#include <linux/sockios.h>
 #include <netinet/in.h>
+#include <signal.h>
 #include <stdio.h>
 #include <stdlib.h>
-#include <sys/ioctl.h>
+#include <sys/signalfd.h>
 #include <sys/socket.h>
 #include <string.h>
 #include <unistd.h>
 
-#include <set>
+#include <map>
+#include <vector>
 
 #define PRINT_MESSAGES false
 
-class TCPMavlinkConnection : public IO::Pollable
-{
-	public:
-		TCPMavlinkConnection(int fd)
-		: m_fd(fd)
-		{
-			memset(&m_rxmsg, 0, sizeof(m_rxmsg));
-			memset(&m_status, 0, sizeof(m_status));
-		}
+// Maximum number of frames from UAVs waiting to be forwarded to the GCSs
+#define TO_GCS_QUEUE_CAPACITY 16384
 
-		~TCPMavlinkConnection() override
-		{
-			close(m_fd);
-		}
-
-		void setMessageHandler(const std::function<void(const mavlink_message_t *msg)> &cb)
-		{
-			m_recvMsg = cb;
-		}
-
-		void setConnectionLostHandler(const std::function<void()> &cb)
-		{
-			m_connLost = cb;
-		}
-
-		int fd() const override
-		{
-			return m_fd;
-		}
-
-		void runOnce()
-		{
-			uint8_t data[65536];
-			int r = recv(m_fd, data, sizeof(data), 0);
-
-			if (r <= 0)
-			{
-				if (m_connLost)
-					m_connLost();
-				return;
-			}
-
-			for (int i = 0; i < r; i++)
-			{
-				mavlink_status_t mavlink_status;
-				bool msg_available = mavlink_frame_char_buffer(&m_rxmsg, &m_status, data[i], &m_nextMessage, &mavlink_status);
-
-				if (msg_available)
-				{
-					if (m_recvMsg)
-						m_recvMsg(&m_nextMessage);
-				}
-			}
-		}
-
-		bool safeSend(const mavlink_message_t *msg)
-		{
-			uint8_t buffer[MAVLINK_MAX_PACKET_LEN];
-			int length = mavlink_msg_to_send_buffer(buffer, msg);
+static IO::PollGroup pg;
+static std::map<MavlinkLink*, RateLimiter> gcss;
+static std::vector<Shard*> shards;
+static FrameQueue *toGCS; // never destroyed, as shards keep running until exit
+static TlogRecorder *recorder;
+static MavlinkStats *stats;
+
+// Make sure that the recording is completely written to disk on exit
+static void flushRecording()
+{
+	delete recorder;
+	recorder = nullptr;
+}
 
-			int value;
-			ioctl(m_fd, SIOCOUTQ, &value);
+static void printMessage(const char *direction, const MAVLink::Frame &frame)
+{
+	char buf[4096];
+	if (MAVLink::format_message(frame.msgid, frame.payload, frame.payloadLen, buf, sizeof(buf), MAVLink::FORMAT_TEXT) == 0)
+		snprintf(buf, sizeof(buf), "unknown msgid %u", frame.msgid);
 
-			// send only if there are less than 4K bytes already enqueued
-			if (value < 4096)
-				send(m_fd, buffer, length, 0);
-		}
+	printf("%s %u:%u:%u %s\n", direction, frame.sysid, frame.compid, frame.seq, buf);
+}
 
-	private:
-		int m_fd;
+// Called for each frame received from any GCS
+static void handleFrameFromGCS(const MAVLink::Frame &frame)
+{
+	if (PRINT_MESSAGES)
+		printMessage("ToUAV", frame);
 
-		mavlink_message_t m_rxmsg, m_nextMessage;
-		mavlink_status_t m_status;
+	if (recorder != nullptr)
+		recorder->record(frame);
 
-		std::function<void(const mavlink_message_t *msg)> m_recvMsg;
-		std::function<void()> m_connLost;
-};
+	if (stats != nullptr)
+		stats->recordMessageType(frame.msgid, frame.len, false);
 
-static IO::PollGroup pg;
-static TCPMavlinkConnection *gcs;
-static std::set<TCPMavlinkConnection*> uavs;
+	// send to the shard that handles the target UAV only, if known
+	uint8_t target = frame.targetSystem();
+	int shard = (target != 0) ? Shard::shardOf(target) : -1;
 
-static void newConnectionGCS(int new_sk)
-{
-	if (gcs != nullptr)
+	if (shard != -1)
 	{
-		pg.remove(gcs);
-		delete gcs;
+		shards[shard]->send(frame);
+	}
+	else
+	{
+		// send to all shards
+		for (Shard *s : shards)
+			s->broadcast(frame);
 	}
+}
 
-	gcs = new TCPMavlinkConnection(new_sk);
+static void newConnectionGCS(int new_sk, const RateLimits &rateLimits)
+{
+	TCPMavlinkConnection *gcs = new TCPMavlinkConnection(new_sk, &pg);
 
-	gcs->setMessageHandler([](const mavlink_message_t *msg)
-	{
-		if (PRINT_MESSAGES)
-		{
-			printf("ToUAV %u:%u:%u ", msg->sysid, msg->compid, msg->seq);
-			MAVLink::print_message(msg);
-		}
+	gcs->setMessageHandler(handleFrameFromGCS);
 
-		// send to all UAVs
-		for (TCPMavlinkConnection *uav : uavs)
-			uav->safeSend(msg);
+	// Frames merged or evicted from the send queue may come from any UAV
+	gcs->setDropHandler([](uint8_t sysid)
+	{
+		if (stats != nullptr)
+			stats->recordDropToGCS(sysid);
 	});
 
-	gcs->setConnectionLostHandler([]()
+	gcs->setConnectionLostHandler([gcs]()
 	{
-		pg.remove(gcs);
+		gcss.erase(gcs);
 		delete gcs;
-		gcs = nullptr;
 	});
 
-	pg.add(gcs);
+	gcss.emplace(gcs, RateLimiter(rateLimits));
 }
 
-static void newConnectionUAV(int new_sk)
+static void newEndpointGCS(int fd, const RateLimits &rateLimits)
 {
-	TCPMavlinkConnection *uav = new TCPMavlinkConnection(new_sk);
+	UDPMavlinkEndpoint *endpoint = new UDPMavlinkEndpoint(fd, &pg);
 
-	uav->setMessageHandler([](const mavlink_message_t *msg)
+	endpoint->setMessageHandler([](UDPMavlinkEndpoint::Peer*, const MAVLink::Frame &frame)
 	{
-		if (PRINT_MESSAGES)
-		{
-			printf("ToGCS %u:%u:%u ", msg->sysid, msg->compid, msg->seq);
-			MAVLink::print_message(msg);
-		}
+		handleFrameFromGCS(frame);
+	});
 
-		// send to GCS
-		if (gcs)
-			gcs->safeSend(msg);
+	endpoint->setNewPeerHandler([rateLimits](UDPMavlinkEndpoint::Peer *peer)
+	{
+		gcss.emplace(peer, RateLimiter(rateLimits));
 	});
 
-	uav->setConnectionLostHandler([uav]()
+	endpoint->setPeerLostHandler([](UDPMavlinkEndpoint::Peer *peer)
 	{
-		pg.remove(uav);
-		uavs.erase(uav);
-		delete uav;
+		gcss.erase(peer);
 	});
+}
+
+// Called for each frame that shards have received from UAVs
+static void handleFrameFromUAV(const MAVLink::Frame &frame)
+{
+	if (PRINT_MESSAGES)
+		printMessage("ToGCS", frame);
+
+	if (recorder != nullptr)
+		recorder->record(frame);
 
-	pg.add(uav);
-	uavs.insert(uav);
+	if (stats != nullptr)
+		stats->recordMessageType(frame.msgid, frame.len, true);
+
+	// send to all GCSs, subject to their rate limits
+	uint64_t now = RateLimiter::now();
+	for (std::pair<MavlinkLink* const, RateLimiter> &gcs : gcss)
+	{
+		if (!gcs.second.allow(frame, now))
+		{
+			if (stats != nullptr)
+				stats->recordRateLimited(frame.sysid);
+		}
+		else if (!gcs.first->send(frame) && stats != nullptr)
+		{
+			stats->recordDropToGCS(frame.sysid);
+		}
+	}
 }
 
-static int makeServer(int port)
+// If reusePort is true, other sockets can be bound to the same port
+static int makeServer(int port, bool reusePort = false)
 {
 	int fd = socket(AF_INET, SOCK_STREAM, 0);
 
 	int optval = 1;
 	setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &optval, sizeof(optval));
+	if (reusePort)
+		setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &optval, sizeof(optval));
 
 	struct sockaddr_in addr;
 	memset(&addr, 0, sizeof(addr));
@@ -179,22 +175,81 @@ static int makeServer(int port)
 	return fd;
 }
 
-int main(int argc, const char *argv[])
+static int makeUDPSocket(int port)
+{
+	int fd = socket(AF_INET, SOCK_DGRAM, 0);
+
+	int optval = 1;
+	setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &optval, sizeof(optval));
+
+	struct sockaddr_in addr;
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(INADDR_ANY);
+	addr.sin_port = htons(port);
+	if (bind(fd, (struct sockaddr*)&addr, sizeof(addr)) < 0)
+		err(EXIT_FAILURE, "bind(%d) failed", port);
+
+	return fd;
+}
+
+int main(int argc, char *argv[])
 {
-	if (argc != 3)
+	CommandLineParser cl(argc, argv);
+
+	if (cl.recordPath != nullptr)
+	{
+		// Terminate through exit() on SIGINT/SIGTERM, so that the recording
+		// is flushed. Signals must be blocked before the writer thread is
+		// started, so that it inherits the mask
+		sigset_t mask;
+		sigemptyset(&mask);
+		sigaddset(&mask, SIGINT);
+		sigaddset(&mask, SIGTERM);
+		sigprocmask(SIG_BLOCK, &mask, nullptr);
+
+		int sfd = signalfd(-1, &mask, SFD_CLOEXEC);
+		if (sfd < 0)
+			err(EXIT_FAILURE, "signalfd failed");
+
+		pg.add(sfd, []() { exit(EXIT_SUCCESS); });
+
+		recorder = new TlogRecorder(cl.recordPath);
+		atexit(flushRecording);
+	}
+
+	for (const CommandLineParser::GCSPort &p : cl.gcsPorts)
 	{
-		fprintf(stderr, "Usage: %s GCSport UAVport\n", argv[0]);
-		return EXIT_FAILURE;
+		RateLimits rateLimits = p.rateLimits;
+
+		if (p.udp)
+		{
+			newEndpointGCS(makeUDPSocket(p.port), rateLimits);
+			continue;
+		}
+
+		int serv_gcs = makeServer(p.port);
+		pg.add(serv_gcs, [=]() { newConnectionGCS(accept(serv_gcs, nullptr, nullptr), rateLimits); });
 	}
 
-	int portGCS = atoi(argv[1]);
-	int portUAV = atoi(argv[2]);
+	if (cl.statsSocketPath != nullptr)
+	{
+		stats = new MavlinkStats();
+		new StatsServer(cl.statsSocketPath, stats, &pg);
+	}
 
-	int serv_gcs = makeServer(portGCS);
-	int serv_uav = makeServer(portUAV);
+	// UAV connections are handled by the shards, which pass frames for the
+	// GCSs to this thread through toGCS
+	toGCS = new FrameQueue(TO_GCS_QUEUE_CAPACITY);
+	toGCS->setHandler(handleFrameFromUAV);
+	pg.add(toGCS);
 
-	pg.add(serv_gcs, [=]() { newConnectionGCS(accept(serv_gcs, nullptr, nullptr)); });
-	pg.add(serv_uav, [=]() { newConnectionUAV(accept(serv_uav, nullptr, nullptr)); });
+	// UDP UAVs, if any, are served by the first shard
+	for (int i = 0; i < cl.threads; i++)
+	{
+		int udpFd = (i == 0 && cl.uavUdpPort != 0) ? makeUDPSocket(cl.uavUdpPort) : -1;
+		shards.push_back(new Shard(i, makeServer(cl.uavPort, true), udpFd, toGCS, stats));
+	}
 
 	while (true)
 		pg.runOnce();
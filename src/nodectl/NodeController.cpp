@@ -0,0 +1,241 @@
+#include "NodeController.h"
+
+#include <arpa/inet.h>
+#include <err.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+
+NodeController *NodeController::connect(const char *ns3Ip, int ns3Port, uint32_t localId)
+{
+	struct sockaddr_in addr;
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_port = htons(ns3Port);
+	if (inet_pton(AF_INET, ns3Ip, &addr.sin_addr) != 1)
+	{
+		warnx("NodeController: invalid ns-3 address %s", ns3Ip);
+		return nullptr;
+	}
+
+	// ns-3 only starts listening once it has connected to the simulation
+	// controller: retry until it is ready
+	int fd;
+	while (true)
+	{
+		fd = socket(AF_INET, SOCK_STREAM, 0);
+		if (fd == -1)
+		{
+			warn("NodeController: socket failed");
+			return nullptr;
+		}
+
+		if (::connect(fd, (struct sockaddr*)&addr, sizeof(addr)) == 0)
+			break;
+
+		warn("NodeController: still waiting for ns-3");
+		close(fd);
+		sleep(2);
+	}
+
+	NodeController *nc = new NodeController(fd, localId);
+	if (!nc->flush())
+	{
+		warnx("NodeController: registration failed");
+		delete nc;
+		return nullptr;
+	}
+
+	return nc;
+}
+
+NodeController::NodeController(int fd, uint32_t localId)
+: m_fd(fd), m_localId(localId), m_sendOffset(0), m_pendingAcks(0), m_failed(false)
+{
+	int optval = 1;
+	setsockopt(m_fd, IPPROTO_TCP, TCP_NODELAY, &optval, sizeof(optval));
+
+	int flags = fcntl(m_fd, F_GETFL, 0);
+	fcntl(m_fd, F_SETFL, flags | O_NONBLOCK);
+
+	// Register (sent by the first flush)
+	queueSend(&localId, sizeof(localId));
+}
+
+NodeController::~NodeController()
+{
+	close(m_fd);
+}
+
+int NodeController::fd() const
+{
+	return m_fd;
+}
+
+uint32_t NodeController::localId() const
+{
+	return m_localId;
+}
+
+bool NodeController::wantsWrite() const
+{
+	return m_sendOffset != m_sendBuffer.size();
+}
+
+bool NodeController::handleEvents()
+{
+	return readAvailable() && writeAvailable();
+}
+
+bool NodeController::flush()
+{
+	while (!m_failed && (wantsWrite() || m_pendingAcks != 0))
+	{
+		pollfd pfd = { m_fd, (short)(POLLIN | (wantsWrite() ? POLLOUT : 0)), 0 };
+		if (poll(&pfd, 1, -1) == -1 && errno != EINTR)
+		{
+			warn("NodeController: poll failed");
+			m_failed = true;
+			break;
+		}
+
+		handleEvents();
+	}
+
+	return !m_failed;
+}
+
+bool NodeController::sendTo(const void *message, size_t len, int32_t destId)
+{
+	uint32_t length = sizeof(destId) + len;
+	queueSend(&length, sizeof(length));
+	queueSend(&destId, sizeof(destId));
+	queueSend(message, len);
+	m_pendingAcks++;
+
+	return writeAvailable();
+}
+
+bool NodeController::messageAvailable() const
+{
+	return !m_incoming.empty();
+}
+
+void NodeController::recvFrom(std::vector<uint8_t> *message, uint32_t *senderId)
+{
+	*senderId = m_incoming.front().senderId;
+	message->swap(m_incoming.front().payload);
+	m_incoming.pop_front();
+}
+
+size_t NodeController::nextMessageLength() const
+{
+	return m_incoming.front().payload.size();
+}
+
+void NodeController::queueSend(const void *data, size_t len)
+{
+	// Discard what has already been sent before growing the buffer
+	if (m_sendOffset == m_sendBuffer.size())
+	{
+		m_sendBuffer.clear();
+		m_sendOffset = 0;
+	}
+
+	m_sendBuffer.insert(m_sendBuffer.end(), (const uint8_t*)data, (const uint8_t*)data + len);
+}
+
+bool NodeController::readAvailable()
+{
+	while (!m_failed)
+	{
+		uint8_t buffer[4096];
+		int r = recv(m_fd, buffer, sizeof(buffer), 0);
+		if (r < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+			break;
+		else if (r <= 0)
+		{
+			warnx("NodeController: connection to ns-3 closed");
+			m_failed = true;
+			break;
+		}
+
+		size_t i = 0;
+		while (i < (size_t)r && !m_failed)
+		{
+			// Outgoing messages are acknowledged before ns-3 can send us
+			// anything else
+			if (m_pendingAcks != 0 && m_recvBuffer.empty())
+			{
+				if (buffer[i++] != '!')
+				{
+					warnx("NodeController: invalid ACK from ns-3");
+					m_failed = true;
+				}
+				m_pendingAcks--;
+				continue;
+			}
+
+			// Size of the whole message, or of its length field until
+			// that has been received
+			uint32_t length;
+			size_t wanted = sizeof(length);
+			if (m_recvBuffer.size() >= sizeof(length))
+			{
+				memcpy(&length, m_recvBuffer.data(), sizeof(length));
+				if (length < sizeof(uint32_t))
+				{
+					warnx("NodeController: invalid message from ns-3");
+					m_failed = true;
+					break;
+				}
+				wanted += length;
+			}
+
+			size_t n = std::min(wanted - m_recvBuffer.size(), r - i);
+			m_recvBuffer.insert(m_recvBuffer.end(), buffer + i, buffer + i + n);
+			i += n;
+
+			if (wanted != sizeof(length) && m_recvBuffer.size() == wanted)
+			{
+				Message msg;
+				memcpy(&msg.senderId, m_recvBuffer.data() + sizeof(length), sizeof(msg.senderId));
+				msg.payload.assign(m_recvBuffer.begin() + 2 * sizeof(uint32_t), m_recvBuffer.end());
+				m_incoming.push_back(std::move(msg));
+				m_recvBuffer.clear();
+
+				queueSend("!", 1);
+			}
+		}
+	}
+
+	return !m_failed;
+}
+
+bool NodeController::writeAvailable()
+{
+	while (!m_failed && wantsWrite())
+	{
+		int r = send(m_fd, m_sendBuffer.data() + m_sendOffset,
+			m_sendBuffer.size() - m_sendOffset, MSG_NOSIGNAL);
+		if (r < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+			break;
+		else if (r <= 0)
+		{
+			warn("NodeController: send to ns-3 failed");
+			m_failed = true;
+			break;
+		}
+
+		m_sendOffset += r;
+	}
+
+	return !m_failed;
+}
@@ -0,0 +1,86 @@
+#ifndef NODECONTROLLER_H
+#define NODECONTROLLER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <deque>
+#include <vector>
+
+/* Client side of the ns-3 external-sync node protocol (see
+ * ns-3/external-sync/model/external-sync-manager.cc).
+ *
+ * The controller registers by sending its node ID as an uint32_t. Then both
+ * peers exchange messages made of an uint32_t length followed by the payload,
+ * and each message is acknowledged with a '!' byte. Messages to ns-3 start
+ * with the destination ID (int32_t), messages from ns-3 with the sender ID.
+ *
+ * Messages can only be sent during phase 0, and ns-3 only sends during
+ * phase 1: while ACKs are pending, incoming bytes are ACKs.
+ *
+ * The socket is non-blocking and can be driven by an external poll() loop
+ * through fd(), wantsWrite() and handleEvents(). Sends are queued and not
+ * waited for individually: flush() must be called before phase 0 ends
+ * (SimTimeClient::signalEndTick does it). */
+class NodeController
+{
+	public:
+		static const int32_t BROADCAST = -1;
+
+		// Connects and registers, retrying until ns-3 accepts the
+		// connection. Returns nullptr on failure
+		static NodeController *connect(const char *ns3Ip, int ns3Port, uint32_t localId);
+		~NodeController();
+
+		int fd() const;
+		uint32_t localId() const;
+
+		// Whether poll() should wait for POLLOUT too
+		bool wantsWrite() const;
+
+		// Performs all the I/O that can be done without blocking. Returns
+		// false if the connection has failed
+		bool handleEvents();
+
+		// Blocks until all queued messages have been sent and acknowledged.
+		// Returns false if the connection has failed
+		bool flush();
+
+		// Queues a message. Must only be called during phase 0
+		bool sendTo(const void *message, size_t len, int32_t destId);
+
+		bool messageAvailable() const;
+
+		// Pops the oldest received message. Must only be called if
+		// messageAvailable() returned true
+		void recvFrom(std::vector<uint8_t> *message, uint32_t *senderId);
+
+		// Length of the message that recvFrom() would return
+		size_t nextMessageLength() const;
+
+	private:
+		NodeController(int fd, uint32_t localId);
+
+		struct Message
+		{
+			uint32_t senderId;
+			std::vector<uint8_t> payload;
+		};
+
+		bool readAvailable();
+		bool writeAvailable();
+		void queueSend(const void *data, size_t len);
+
+		int m_fd;
+		uint32_t m_localId;
+
+		std::vector<uint8_t> m_sendBuffer;
+		size_t m_sendOffset;
+		size_t m_pendingAcks;
+
+		std::vector<uint8_t> m_recvBuffer; // partially received message
+		std::deque<Message> m_incoming;
+		bool m_failed;
+};
+
+#endif // NODECONTROLLER_H
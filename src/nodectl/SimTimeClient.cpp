@@ -0,0 +1,162 @@
+#include "SimTimeClient.h"
+
+#include <arpa/inet.h>
+#include <err.h>
+#include <errno.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <algorithm>
+
+SimTimeClient *SimTimeClient::connect(int port)
+{
+	int fd;
+	const char *udsPath = getenv("GZUAV_SYNC_UDS");
+	if (udsPath != nullptr)
+	{
+		struct sockaddr_un addr;
+		memset(&addr, 0, sizeof(addr));
+		addr.sun_family = AF_UNIX;
+		if (strlen(udsPath) >= sizeof(addr.sun_path))
+		{
+			warnx("SimTimeClient: socket path is too long");
+			return nullptr;
+		}
+		strcpy(addr.sun_path, udsPath);
+
+		fd = socket(AF_UNIX, SOCK_STREAM, 0);
+		if (fd == -1 || ::connect(fd, (struct sockaddr*)&addr, sizeof(addr)) < 0)
+		{
+			warn("SimTimeClient: connect(%s) failed", udsPath);
+			if (fd != -1)
+				close(fd);
+			return nullptr;
+		}
+	}
+	else
+	{
+		struct sockaddr_in addr;
+		memset(&addr, 0, sizeof(addr));
+		addr.sin_family = AF_INET;
+		addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+		addr.sin_port = htons(port);
+
+		fd = socket(AF_INET, SOCK_STREAM, 0);
+		if (fd == -1 || ::connect(fd, (struct sockaddr*)&addr, sizeof(addr)) < 0)
+		{
+			warn("SimTimeClient: connect(%d) failed", port);
+			if (fd != -1)
+				close(fd);
+			return nullptr;
+		}
+
+		int optval = 1;
+		setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &optval, sizeof(optval));
+	}
+
+	// Subscribe to the first phase
+	if (send(fd, "", 1, MSG_NOSIGNAL) != 1)
+	{
+		warn("SimTimeClient: subscription failed");
+		close(fd);
+		return nullptr;
+	}
+
+	return new SimTimeClient(fd);
+}
+
+SimTimeClient::SimTimeClient(int fd)
+: m_fd(fd), m_phase0Ongoing(false), m_currentTimestamp(0)
+{
+}
+
+SimTimeClient::~SimTimeClient()
+{
+	close(m_fd);
+}
+
+void SimTimeClient::attach(NodeController *nc)
+{
+	m_nodeControllers.push_back(nc);
+}
+
+void SimTimeClient::detach(NodeController *nc)
+{
+	m_nodeControllers.erase(std::remove(m_nodeControllers.begin(), m_nodeControllers.end(), nc),
+		m_nodeControllers.end());
+}
+
+bool SimTimeClient::waitForBeginTick(double *timestamp)
+{
+	m_phase0Ongoing = false;
+
+	std::vector<pollfd> pfds;
+	size_t received = 0;
+	while (received != sizeof(double))
+	{
+		pfds.clear();
+		pfds.push_back({ m_fd, POLLIN, 0 });
+		for (NodeController *nc : m_nodeControllers)
+			pfds.push_back({ nc->fd(), (short)(POLLIN | (nc->wantsWrite() ? POLLOUT : 0)), 0 });
+
+		if (poll(pfds.data(), pfds.size(), -1) == -1)
+		{
+			if (errno == EINTR)
+				continue;
+			warn("SimTimeClient: poll failed");
+			return false;
+		}
+
+		// Receive messages and send their ACKs
+		for (size_t i = 0; i < m_nodeControllers.size(); i++)
+		{
+			if (pfds[1 + i].revents != 0 && !m_nodeControllers[i]->handleEvents())
+				return false;
+		}
+
+		if (pfds[0].revents != 0)
+		{
+			int r = recv(m_fd, received + (char*)&m_currentTimestamp, sizeof(double) - received, 0);
+			if (r <= 0)
+			{
+				warnx("SimTimeClient: connection closed");
+				return false;
+			}
+			received += r;
+		}
+	}
+
+	m_phase0Ongoing = true;
+	*timestamp = m_currentTimestamp;
+	return true;
+}
+
+bool SimTimeClient::signalEndTick()
+{
+	// All the messages sent in this tick must have been processed by ns-3
+	// before the tick ends
+	for (NodeController *nc : m_nodeControllers)
+	{
+		if (!nc->flush())
+			return false;
+	}
+
+	m_phase0Ongoing = false;
+	return send(m_fd, "!", 1, MSG_NOSIGNAL) == 1;
+}
+
+bool SimTimeClient::phase0Ongoing() const
+{
+	return m_phase0Ongoing;
+}
+
+double SimTimeClient::currentTimestamp() const
+{
+	return m_currentTimestamp;
+}
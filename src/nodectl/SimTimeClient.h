@@ -0,0 +1,45 @@
+#ifndef SIMTIMECLIENT_H
+#define SIMTIMECLIENT_H
+
+#include "NodeController.h"
+
+#include <vector>
+
+/* Phase 0 subscription to gzuavchannel's external synchronization server
+ * (or to a gzuavsynchub).
+ *
+ * While waiting for the next BEGIN-TICK (i.e. during phase 1, when ns-3
+ * delivers messages), the node controllers that have been attached are
+ * serviced on the same thread. Before END-TICK is signalled, their queued
+ * messages are flushed. */
+class SimTimeClient
+{
+	public:
+		// Connects to 127.0.0.1:port, or to $GZUAV_SYNC_UDS if it is set.
+		// Returns nullptr on failure
+		static SimTimeClient *connect(int port);
+		~SimTimeClient();
+
+		void attach(NodeController *nc);
+		void detach(NodeController *nc);
+
+		// Blocks until the next BEGIN-TICK and returns its timestamp.
+		// Returns false if a connection has failed
+		bool waitForBeginTick(double *timestamp);
+
+		bool signalEndTick();
+
+		bool phase0Ongoing() const;
+		double currentTimestamp() const;
+
+	private:
+		SimTimeClient(int fd);
+
+		int m_fd;
+		std::vector<NodeController*> m_nodeControllers;
+
+		bool m_phase0Ongoing;
+		double m_currentTimestamp;
+};
+
+#endif // SIMTIMECLIENT_H
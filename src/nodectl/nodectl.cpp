@@ -0,0 +1,109 @@
+#include "nodectl.h"
+
+#include "NodeController.h"
+#include "SimTimeClient.h"
+
+#include <err.h>
+#include <string.h>
+
+struct gzuav_simtime
+{
+	SimTimeClient *client;
+};
+
+struct gzuav_nodectl
+{
+	NodeController *controller;
+	gzuav_simtime *st;
+};
+
+gzuav_simtime *gzuav_simtime_connect(int port)
+{
+	SimTimeClient *client = SimTimeClient::connect(port);
+	if (client == nullptr)
+		return nullptr;
+
+	return new gzuav_simtime{ client };
+}
+
+void gzuav_simtime_close(gzuav_simtime *st)
+{
+	delete st->client;
+	delete st;
+}
+
+int gzuav_simtime_wait_for_begintick(gzuav_simtime *st, double *timestamp)
+{
+	return st->client->waitForBeginTick(timestamp) ? 0 : -1;
+}
+
+int gzuav_simtime_signal_endtick(gzuav_simtime *st)
+{
+	return st->client->signalEndTick() ? 0 : -1;
+}
+
+int gzuav_simtime_phase0_ongoing(const gzuav_simtime *st)
+{
+	return st->client->phase0Ongoing();
+}
+
+double gzuav_simtime_current_timestamp(const gzuav_simtime *st)
+{
+	return st->client->currentTimestamp();
+}
+
+gzuav_nodectl *gzuav_nodectl_connect(gzuav_simtime *st, const char *ns3_ip, int ns3_port, uint32_t local_id)
+{
+	NodeController *controller = NodeController::connect(ns3_ip, ns3_port, local_id);
+	if (controller == nullptr)
+		return nullptr;
+
+	st->client->attach(controller);
+	return new gzuav_nodectl{ controller, st };
+}
+
+void gzuav_nodectl_close(gzuav_nodectl *nc)
+{
+	nc->st->client->detach(nc->controller);
+	delete nc->controller;
+	delete nc;
+}
+
+int gzuav_nodectl_sendto(gzuav_nodectl *nc, const void *message, size_t len, int32_t dest_id)
+{
+	if (!nc->st->client->phase0Ongoing())
+		return -1; // messages can only be sent during phase 0
+
+	return nc->controller->sendTo(message, len, dest_id) ? 0 : -1;
+}
+
+int gzuav_nodectl_message_available(const gzuav_nodectl *nc)
+{
+	return nc->controller->messageAvailable();
+}
+
+long gzuav_nodectl_next_message_length(const gzuav_nodectl *nc)
+{
+	if (!nc->controller->messageAvailable())
+		return -1;
+
+	return (long)nc->controller->nextMessageLength();
+}
+
+int gzuav_nodectl_recvfrom(gzuav_nodectl *nc, void *buffer, size_t buflen, uint32_t *sender_id)
+{
+	if (!nc->controller->messageAvailable())
+		return -1;
+
+	if (nc->controller->nextMessageLength() > buflen)
+	{
+		warnx("gzuav_nodectl_recvfrom: buffer too small for %zu-byte message",
+			nc->controller->nextMessageLength());
+		return -1; // the message stays queued
+	}
+
+	std::vector<uint8_t> message;
+	nc->controller->recvFrom(&message, sender_id);
+	memcpy(buffer, message.data(), message.size());
+	return 0;
+}
@@ -0,0 +1,44 @@
+#ifndef GZUAV_NODECTL_H
+#define GZUAV_NODECTL_H
+
+/* C interface to SimTimeClient and NodeController, for bindings in other
+ * languages (see nodectl.py). The library never terminates the process:
+ * functions returning int return 0 on success and -1 on failure, and the
+ * connect functions return NULL on failure. Errors are printed on stderr. */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct gzuav_simtime gzuav_simtime;
+typedef struct gzuav_nodectl gzuav_nodectl;
+
+gzuav_simtime *gzuav_simtime_connect(int port);
+void gzuav_simtime_close(gzuav_simtime *st);
+int gzuav_simtime_wait_for_begintick(gzuav_simtime *st, double *timestamp);
+int gzuav_simtime_signal_endtick(gzuav_simtime *st);
+int gzuav_simtime_phase0_ongoing(const gzuav_simtime *st);
+double gzuav_simtime_current_timestamp(const gzuav_simtime *st);
+
+// The node controller is serviced by st's wait_for_begintick and flushed by
+// its signal_endtick. It must be closed before st
+gzuav_nodectl *gzuav_nodectl_connect(gzuav_simtime *st, const char *ns3_ip, int ns3_port, uint32_t local_id);
+void gzuav_nodectl_close(gzuav_nodectl *nc);
+int gzuav_nodectl_sendto(gzuav_nodectl *nc, const void *message, size_t len, int32_t dest_id);
+int gzuav_nodectl_message_available(const gzuav_nodectl *nc);
+
+// Length of the next message, -1 if none is available
+long gzuav_nodectl_next_message_length(const gzuav_nodectl *nc);
+
+// Pops the next message into buffer. Fails, leaving the message queued, if
+// it is longer than buflen
+int gzuav_nodectl_recvfrom(gzuav_nodectl *nc, void *buffer, size_t buflen, uint32_t *sender_id);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // GZUAV_NODECTL_H
@@ -1,5 +1,6 @@
 import math
 import monotonic
+import os
 import socket
 import struct
 import sys
@@ -60,8 +61,14 @@ def new_time():
 def connect(port):
     global simtime_socket
 
-    simtime_socket = socket.socket(socket.AF_INET, socket.SOCK_STREAM)
-    simtime_socket.connect(("127.0.0.1", port))
+    # gzuavcluster --sync-hub makes a local Unix socket available too
+    uds_path = os.environ.get('GZUAV_SYNC_UDS')
+    if uds_path is not None:
+        simtime_socket = socket.socket(socket.AF_UNIX, socket.SOCK_STREAM)
+        simtime_socket.connect(uds_path)
+    else:
+        simtime_socket = socket.socket(socket.AF_INET, socket.SOCK_STREAM)
+        simtime_socket.connect(("127.0.0.1", port))
 
     simtime_socket.send(b'\0') # Subscribe to the first phase
 